@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+
+/*
+	Activation function of a layer's neurons
+	Kernels are instantiated once per activation, so a layer picks its kernel once instead of branching per neuron
+	Derivatives are taken in terms of the activation's output, which is what backpropagation has stored
+*/
+
+enum class Activation
+{
+	SIGMOID = 0,
+	RELU = 1,
+	LEAKY_RELU = 2,		//z for z > 0, otherwise LEAKY_RELU_SLOPE * z
+	TANH = 3
+};
+
+constexpr size_t ACTIVATION_COUNT = 4;
+
+constexpr double LEAKY_RELU_SLOPE = 0.01;
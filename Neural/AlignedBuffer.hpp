@@ -0,0 +1,113 @@
+#pragma once
+#include <cstring>
+#include <new>
+
+/*
+	Flat heap array whose storage starts on a cache line boundary
+
+	Intended for plain numeric data only (no constructors/destructors are run)
+	New elements are zeroed, existing elements are kept when resized
+*/
+
+template <typename T, size_t ALIGNMENT = 64>
+class AlignedBuffer
+{
+	T* _data;
+	size_t _size;
+
+	static T* _Allocate(size_t size)
+	{
+		if (size == 0) return nullptr;
+
+		//round up so the allocation is always a whole number of lines
+		const size_t bytes = ((size * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+		T* data = (T*)::operator new(bytes, std::align_val_t(ALIGNMENT));
+		std::memset(data, 0, bytes);
+		return data;
+	}
+
+	static void _Free(T* data)
+	{
+		if (data) ::operator delete(data, std::align_val_t(ALIGNMENT));
+	}
+
+public:
+	AlignedBuffer() : _data(nullptr), _size(0) {}
+	AlignedBuffer(size_t size) : _data(_Allocate(size)), _size(size) {}
+
+	AlignedBuffer(const AlignedBuffer& other) : _data(_Allocate(other._size)), _size(other._size)
+	{
+		if (_size) std::memcpy(_data, other._data, _size * sizeof(T));
+	}
+
+	AlignedBuffer(AlignedBuffer&& other) noexcept : _data(other._data), _size(other._size)
+	{
+		other._data = nullptr;
+		other._size = 0;
+	}
+
+	~AlignedBuffer() { _Free(_data); }
+
+	AlignedBuffer& operator=(const AlignedBuffer& other)
+	{
+		if (this != &other)
+		{
+			T* data = _Allocate(other._size);
+			if (other._size) std::memcpy(data, other._data, other._size * sizeof(T));
+
+			_Free(_data);
+			_data = data;
+			_size = other._size;
+		}
+
+		return *this;
+	}
+
+	AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+	{
+		T* data = _data;
+		size_t size = _size;
+		_data = other._data;
+		_size = other._size;
+		other._data = data;
+		other._size = size;
+		return *this;
+	}
+
+	size_t GetSize() const { return _size; }
+
+	T* Data() { return _data; }
+	const T* Data() const { return _data; }
+
+	T& operator[](size_t index) { return _data[index]; }
+	const T& operator[](size_t index) const { return _data[index]; }
+
+	T* begin() { return _data; }
+	T* end() { return _data + _size; }
+	const T* begin() const { return _data; }
+	const T* end() const { return _data + _size; }
+
+	void SetSize(size_t size)
+	{
+		if (size == _size) return;
+
+		T* data = _Allocate(size);
+		if (_size && size) std::memcpy(data, _data, (size < _size ? size : _size) * sizeof(T));
+
+		_Free(_data);
+		_data = data;
+		_size = size;
+	}
+
+	void Clear()
+	{
+		_Free(_data);
+		_data = nullptr;
+		_size = 0;
+	}
+
+	void Zero()
+	{
+		if (_size) std::memset(_data, 0, _size * sizeof(T));
+	}
+};
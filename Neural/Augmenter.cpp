@@ -0,0 +1,195 @@
+#include "Augmenter.hpp"
+#include "TaskScheduler.hpp"
+#include <ELMaths/Maths.hpp>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr float PI = 3.14159265358979f;
+
+	//Bilinear sample of image at (x, y), 0 outside it
+	float _Sample(const byte* image, uint32 width, uint32 height, float x, float y)
+	{
+		const float fx = std::floor(x);
+		const float fy = std::floor(y);
+		const int x0 = (int)fx;
+		const int y0 = (int)fy;
+		const float tx = x - fx;
+		const float ty = y - fy;
+
+		auto pixel = [&](int px, int py) -> float
+		{
+			return px >= 0 && py >= 0 && px < (int)width && py < (int)height ? (float)image[py * width + px] : 0.f;
+		};
+
+		const float top = pixel(x0, y0) + (pixel(x0 + 1, y0) - pixel(x0, y0)) * tx;
+		const float bottom = pixel(x0, y0 + 1) + (pixel(x0 + 1, y0 + 1) - pixel(x0, y0 + 1)) * tx;
+		return top + (bottom - top) * ty;
+	}
+}
+
+Augmenter::Augmenter(TaskScheduler& scheduler, uint32 seed) : _scheduler(scheduler), _seed(seed)
+{
+	SetSettings(Settings());
+}
+
+void Augmenter::SetSettings(const Settings& settings)
+{
+	_settings = settings;
+
+	//3 sigma either side holds all but ~0.3% of the Gaussian
+	const float sigma = Maths::Max(_settings.smoothness, 0.1f);
+	const int radius = Maths::Max(1, (int)std::ceil(sigma * 3.f));
+
+	_kernel.SetSize(radius * 2 + 1);
+
+	float sum = 0.f;
+	for (int i = -radius; i <= radius; ++i)
+		sum += _kernel[i + radius] = std::exp(-(float)(i * i) / (2.f * sigma * sigma));
+
+	for (int i = 0; i < _kernel.GetSize(); ++i)
+		_kernel[i] /= sum;
+}
+
+void Augmenter::Seed(uint32 seed)
+{
+	_seed = seed;
+	_streams.clear();
+}
+
+void Augmenter::Apply(const byte* const* sources, byte* destinations, size_t count, uint32 width, uint32 height)
+{
+	const size_t imageSize = (size_t)width * height;
+
+	if (!_settings.IsEnabled())
+	{
+		for (size_t i = 0; i < count; ++i)
+			std::memcpy(destinations + i * imageSize, sources[i], imageSize);
+
+		return;
+	}
+
+	//Streams only ever grow, so a stream keeps its sequence for as long as the thread count stays the same
+	while (_streams.size() < (size_t)_scheduler.GetThreadCount())
+		_streams.emplace_back(_seed + (uint32)_streams.size() * 0x9E3779B9u);
+
+	for (Stream& stream : _streams)
+	{
+		if (stream.dx.GetSize() < imageSize)
+		{
+			stream.dx.SetSize(imageSize);
+			stream.dy.SetSize(imageSize);
+			stream.smoothing.SetSize(imageSize);
+		}
+	}
+
+	//stream s always takes the same share of the batch, whichever thread runs it
+	const size_t streams = Maths::Min(_streams.size(), count);
+
+	auto distort = [this, sources, destinations, count, width, height, imageSize, streams](size_t s)
+	{
+		for (size_t i = count * s / streams; i < count * (s + 1) / streams; ++i)
+			_Distort(_streams[s], sources[i], destinations + i * imageSize, width, height);
+	};
+
+	TaskGroup group(_scheduler);
+	for (size_t s = 1; s < streams; ++s)
+		group.Run([&distort, s]() { distort(s); });
+
+	if (streams) distort(0);
+	group.Wait();
+}
+
+void Augmenter::_Distort(Stream& stream, const byte* source, byte* destination, uint32 width, uint32 height) const
+{
+	Random& random = stream.random;
+	auto uniform = [&random](float range) { return (float)(random.NextDouble() * 2.0 - 1.0) * range; };
+
+	//destination -> source is the inverse transform: unshift, unrotate, unscale
+	const float angle = uniform(_settings.rotation) * (PI / 180.f);
+	const float scale = 1.f + uniform(_settings.scale);
+	const float shiftX = uniform(_settings.shift);
+	const float shiftY = uniform(_settings.shift);
+
+	const float cosine = std::cos(angle) / scale;
+	const float sine = std::sin(angle) / scale;
+	const float centreX = (width - 1) * 0.5f;
+	const float centreY = (height - 1) * 0.5f;
+
+	const size_t size = (size_t)width * height;
+	const bool elastic = _settings.elastic > 0.f;
+
+	if (elastic)
+	{
+		float* dx = stream.dx.Data();
+		float* dy = stream.dy.Data();
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			dx[i] = uniform(1.f);
+			dy[i] = uniform(1.f);
+		}
+
+		_Smooth(stream, dx, width, height);
+		_Smooth(stream, dy, width, height);
+	}
+
+	const float noise = _settings.noise * 255.f;
+
+	for (uint32 y = 0; y < height; ++y)
+	{
+		for (uint32 x = 0; x < width; ++x)
+		{
+			const size_t i = (size_t)y * width + x;
+
+			float px = (float)x - centreX - shiftX;
+			float py = (float)y - centreY - shiftY;
+
+			if (elastic)
+			{
+				px += stream.dx[i] * _settings.elastic;
+				py += stream.dy[i] * _settings.elastic;
+			}
+
+			float value = _Sample(source, width, height, cosine * px + sine * py + centreX, cosine * py - sine * px + centreY);
+
+			if (noise > 0.f)
+				value += uniform(noise);
+
+			destination[i] = (byte)Maths::Min(Maths::Max(value + 0.5f, 0.f), 255.f);
+		}
+	}
+}
+
+void Augmenter::_Smooth(Stream& stream, float* field, uint32 width, uint32 height) const
+{
+	const int radius = (int)_kernel.GetSize() / 2;
+	const float* kernel = _kernel.Data() + radius;
+	float* smoothing = stream.smoothing.Data();
+
+	//separable: rows into smoothing, then its columns back into field
+	for (int y = 0; y < (int)height; ++y)
+	{
+		for (int x = 0; x < (int)width; ++x)
+		{
+			float sum = 0.f;
+			for (int k = Maths::Max(-radius, -x); k <= Maths::Min(radius, (int)width - 1 - x); ++k)
+				sum += field[y * width + x + k] * kernel[k];
+
+			smoothing[y * width + x] = sum;
+		}
+	}
+
+	for (int y = 0; y < (int)height; ++y)
+	{
+		for (int x = 0; x < (int)width; ++x)
+		{
+			float sum = 0.f;
+			for (int k = Maths::Max(-radius, -y); k <= Maths::Min(radius, (int)height - 1 - y); ++k)
+				sum += smoothing[(y + k) * width + x] * kernel[k];
+
+			field[y * width + x] = sum;
+		}
+	}
+}
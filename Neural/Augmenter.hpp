@@ -0,0 +1,78 @@
+#pragma once
+#include "AlignedBuffer.hpp"
+#include <ELCore/Buffer.hpp>
+#include <ELMaths/Random.hpp>
+#include <vector>
+
+class TaskScheduler;
+
+/*
+	Random distortions of 8 bit images, so every epoch trains on slightly different samples without any being stored
+
+	Each output pixel is sampled (bilinearly) from where it lands in the source after a random affine transform (shift, rotation
+	and scale about the centre) and a random elastic displacement field (uniform noise smoothed by a Gaussian, as in Simard et al.),
+	then has uniform noise added. Pixels taken from outside the source are 0, the background of IDX digits
+
+	Apply splits a batch over one stream per scheduler thread, each with its own Random and scratch, so the threads share
+	no state and the images only depend on the seed and the thread count
+*/
+
+class Augmenter
+{
+public:
+	struct Settings
+	{
+		float shift;		//pixels each way
+		float rotation;		//degrees each way
+		float scale;		//relative, each way
+		float elastic;		//alpha, scales the smoothed field (34 with smoothness 4, as Simard et al. use for MNIST, moves pixels ~1.5), 0 for none
+		float smoothness;	//sigma of the Gaussian smoothing the elastic field, in pixels
+		float noise;		//each way, as a fraction of full brightness
+
+		Settings(float shift = 0.f, float rotation = 0.f, float scale = 0.f, float elastic = 0.f, float smoothness = 4.f, float noise = 0.f) :
+			shift(shift), rotation(rotation), scale(scale), elastic(elastic), smoothness(smoothness), noise(noise) {}
+
+		bool IsEnabled() const { return shift > 0.f || rotation > 0.f || scale > 0.f || elastic > 0.f || noise > 0.f; }
+	};
+
+private:
+	struct Stream
+	{
+		Random random;
+
+		//[width x height] displacement field and the half smoothed field
+		AlignedBuffer<float> dx;
+		AlignedBuffer<float> dy;
+		AlignedBuffer<float> smoothing;
+
+		Stream(uint32 seed) : random(seed) {}
+	};
+
+	TaskScheduler& _scheduler;
+	Settings _settings;
+
+	std::vector<Stream> _streams;
+	uint32 _seed;
+
+	//Normalised Gaussian weights [-radius, radius] for the elastic field
+	Buffer<float> _kernel;
+
+	void _Distort(Stream&, const byte* source, byte* destination, uint32 width, uint32 height) const;
+
+	//Gaussian blur of field, zero outside it
+	void _Smooth(Stream&, float* field, uint32 width, uint32 height) const;
+
+public:
+	Augmenter(TaskScheduler& scheduler, uint32 seed = 0);
+
+	const Settings& GetSettings() const { return _settings; }
+	void SetSettings(const Settings&);
+
+	//Restarts every stream's sequence
+	void Seed(uint32 seed);
+
+	//destinations receives a distorted copy of each of the count [width x height] images pointed to by sources, one after the other
+	//Uses every scheduler thread, and must not be called by two threads at once
+	//May be called from outside the pool (a loader thread) while other threads use the scheduler, the caller then only runs this batch's tasks
+	void Apply(const byte* const* sources, byte* destinations, size_t count, uint32 width, uint32 height);
+};
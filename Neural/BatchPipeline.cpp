@@ -0,0 +1,106 @@
+#include "BatchPipeline.hpp"
+
+template <typename S>
+void BatchPipeline<S>::Start(size_t sampleSize, size_t batchSize, size_t depth, Producer producer)
+{
+	Stop();
+
+	if (depth == 0) depth = 1;
+
+	_slots.SetSize(depth);
+	for (size_t i = 0; i < depth; ++i)
+	{
+		if (_slots[i].samples.GetSize() < batchSize * sampleSize)
+			_slots[i].samples.SetSize(batchSize * sampleSize);
+
+		if (_slots[i].labels.GetSize() < batchSize)
+			_slots[i].labels.SetSize(batchSize);
+	}
+
+	_batchSize = batchSize;
+	_producer = std::move(producer);
+
+	_filled = 0;
+	_released = 0;
+	_stopping = false;
+
+	_loader = std::thread(&BatchPipeline::_LoaderMain, this);
+}
+
+template <typename S>
+void BatchPipeline<S>::Stop()
+{
+	if (!_loader.joinable())
+		return;
+
+	//Moving _released wakes the loader if it is waiting for a free slot
+	_stopping = true;
+	_released.fetch_add(1);
+	_released.notify_one();
+
+	_loader.join();
+	_producer = nullptr;
+}
+
+template <typename S>
+void BatchPipeline<S>::_LoaderMain()
+{
+	const size_t depth = _slots.GetSize();
+
+	for (size_t filled = 0;; ++filled)
+	{
+		//wait for the consumer to release the slot's previous batch
+		size_t released = _released.load(std::memory_order_acquire);
+		while (filled - released >= depth && !_stopping)
+		{
+			_released.wait(released, std::memory_order_acquire);
+			released = _released.load(std::memory_order_acquire);
+		}
+
+		if (_stopping)
+			return;
+
+		Slot& slot = _slots[filled % depth];
+		slot.count = _producer(slot.samples.Data(), slot.labels.Data(), _batchSize);
+
+		_filled.store(filled + 1, std::memory_order_release);
+		_filled.notify_one();
+
+		//an empty batch tells the consumer there are no more
+		if (slot.count == 0)
+			return;
+	}
+}
+
+template <typename S>
+bool BatchPipeline<S>::Next(Batch& batch)
+{
+	if (_slots.GetSize() == 0)
+		return false;
+
+	//only the consumer moves _released
+	const size_t next = _released.load(std::memory_order_relaxed);
+
+	size_t filled = _filled.load(std::memory_order_acquire);
+	while (filled == next)
+	{
+		_filled.wait(filled, std::memory_order_acquire);
+		filled = _filled.load(std::memory_order_acquire);
+	}
+
+	const Slot& slot = _slots[next % _slots.GetSize()];
+	batch.samples = slot.samples.Data();
+	batch.labels = slot.labels.Data();
+	batch.count = slot.count;
+	return slot.count > 0;
+}
+
+template <typename S>
+void BatchPipeline<S>::Release()
+{
+	_released.fetch_add(1, std::memory_order_release);
+	_released.notify_one();
+}
+
+template class BatchPipeline<byte>;
+template class BatchPipeline<float>;
@@ -0,0 +1,80 @@
+#pragma once
+#include "AlignedBuffer.hpp"
+#include <ELCore/Buffer.hpp>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/*
+	Producer/consumer stage that assembles training batches on a loader thread of its own while the trainer works on earlier ones
+
+	The loader calls the producer to fill a ring of staging slots (cache line aligned, allocated and touched once in Start),
+	running up to depth batches ahead. The ring is single producer single consumer and lock free: each side only ever advances
+	its own counter, and waits by blocking on the other's (atomic wait/notify) rather than on a mutex
+
+	Only one thread may call Next and Release. The loader is outside the TaskScheduler, and a producer may hand heavier work
+	to the scheduler with a TaskGroup: the loader's waits only run that group's tasks and the trainer's only its own, so the
+	two never take over each other's work, they just share the pool
+
+	S is the sample type (instantiated in BatchPipeline.cpp), as in Dataset
+*/
+
+template <typename S>
+class BatchPipeline
+{
+public:
+	//Fills up to capacity [count x sample size] samples and their labels, returns count, 0 once there is nothing left to load
+	//Called on the loader thread only
+	using Producer = std::function<size_t(S* samples, uint32* labels, size_t capacity)>;
+
+	struct Batch
+	{
+		const S* samples;
+		const uint32* labels;
+		size_t count;
+	};
+
+private:
+	struct Slot
+	{
+		AlignedBuffer<S> samples;
+		AlignedBuffer<uint32> labels;
+		size_t count;
+
+		Slot() : count(0) {}
+	};
+
+	Buffer<Slot> _slots;
+	size_t _batchSize;
+
+	Producer _producer;
+	std::thread _loader;
+
+	//Batches filled by the loader and released by the consumer so far, batch n lives in slot n % depth
+	//Each counter is only written by its own side
+	std::atomic<size_t> _filled;
+	std::atomic<size_t> _released;
+	std::atomic<bool> _stopping;
+
+	void _LoaderMain();
+
+public:
+	BatchPipeline() : _batchSize(0), _filled(0), _released(0), _stopping(false) {}
+	~BatchPipeline() { Stop(); }
+
+	BatchPipeline(const BatchPipeline&) = delete;
+	BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+	//Stops any previous run, then starts loading batches of up to batchSize samples, at most depth of them ahead
+	void Start(size_t sampleSize, size_t batchSize, size_t depth, Producer producer);
+
+	//Stops the loader once its current batch is done, any batches still in the ring are dropped
+	void Stop();
+
+	//Waits for the next batch, which stays valid until Release
+	//Returns false once the producer has run out
+	bool Next(Batch& batch);
+
+	//Hands the batch from the last Next back to the loader
+	void Release();
+};
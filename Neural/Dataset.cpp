@@ -0,0 +1,111 @@
+#include "Dataset.hpp"
+#include "ImagesIDX3.hpp"
+#include "LabelsIDX1.hpp"
+#include "TaskScheduler.hpp"
+#include <ELMaths/Maths.hpp>
+#include <ELMaths/Random.hpp>
+#include <algorithm>
+#include <cstring>
+
+template <typename S>
+bool Dataset<S>::Assign(const ImagesIDX3& images, const LabelsIDX1& labels, TaskScheduler* scheduler)
+{
+	if (images.GetCount() != labels.GetCount())
+		return false;
+
+	_count = images.GetCount();
+	_sampleSize = (size_t)images.GetWidth() * images.GetHeight();
+
+	_view = nullptr;
+	_samples.Clear();
+	_samples.SetSize(_count * _sampleSize);
+	_labels.Clear();
+	_labels.SetSize(_count);
+
+	auto copy = [this, &images, &labels](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const byte* image = images.GetImage((uint32)i);
+			S* sample = _samples.Data() + i * _sampleSize;
+
+			if constexpr (sizeof(S) == 1)
+				std::memcpy(sample, image, _sampleSize);
+			else
+				for (size_t p = 0; p < _sampleSize; ++p)
+					sample[p] = (S)(image[p] / 255.0);
+
+			_labels[i] = labels.GetLabel((uint32)i);
+		}
+	};
+
+	//rows are independent, a few hundred per task keeps the overhead negligible
+	if (scheduler)
+		scheduler->ParallelFor(0, _count, 256, copy);
+	else
+		copy(0, _count);
+
+	return true;
+}
+
+template <typename S>
+bool Dataset<S>::View(const ImagesIDX3& images, const LabelsIDX1& labels, TaskScheduler* scheduler)
+{
+	const size_t count = images.GetCount();
+	const size_t sampleSize = (size_t)images.GetWidth() * images.GetHeight();
+
+	if constexpr (sizeof(S) == 1)
+	{
+		//the last image straight after the first count - 1 means none came from AddImage
+		if (count > 0 && count == labels.GetCount() && images.GetImage((uint32)(count - 1)) == images.GetImage(0) + (count - 1) * sampleSize)
+		{
+			_count = count;
+			_sampleSize = sampleSize;
+
+			_samples.Clear();
+			_view = (const S*)images.GetImage(0);
+
+			_labels.Clear();
+			_labels.SetSize(_count);
+
+			auto copy = [this, &labels](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					_labels[i] = labels.GetLabel((uint32)i);
+			};
+
+			if (scheduler)
+				scheduler->ParallelFor(0, _count, 4096, copy);
+			else
+				copy(0, _count);
+
+			return true;
+		}
+	}
+
+	return Assign(images, labels, scheduler);
+}
+
+template <typename S>
+void Dataset<S>::Shuffle(Random& random)
+{
+	if (_view)
+	{
+		_samples.SetSize(_count * _sampleSize);
+		std::memcpy(_samples.Data(), _view, _count * _sampleSize * sizeof(S));
+		_view = nullptr;
+	}
+
+	//Fisher-Yates, each row swaps with a random one at or after it
+	for (size_t i = 0; i + 1 < _count; ++i)
+	{
+		const size_t j = Maths::Min(i + (size_t)(random.NextDouble() * (double)(_count - i)), _count - 1);
+		if (j == i) continue;
+
+		std::swap_ranges(_samples.Data() + i * _sampleSize, _samples.Data() + (i + 1) * _sampleSize, _samples.Data() + j * _sampleSize);
+		std::swap(_labels[i], _labels[j]);
+	}
+}
+
+template class Dataset<byte>;
+template class Dataset<float>;
@@ -0,0 +1,59 @@
+#pragma once
+#include "AlignedBuffer.hpp"
+#include <ELCore/Buffer.hpp>
+
+class ImagesIDX3;
+class LabelsIDX1;
+class Random;
+class TaskScheduler;
+
+/*
+	Labelled samples held as one contiguous [count x sample size] matrix, cache line aligned when the dataset has its own copy
+
+	S is the stored type (instantiated in Dataset.cpp): byte keeps images as they are in the IDX file, a quarter of the size of float,
+	and the network scales them by GetInputScale as it reads them (see the inputScale overloads of LayeredNetwork::EvaluateBatch)
+	float holds them already scaled
+
+	Shuffle moves the rows themselves, so any run of consecutive samples is a minibatch that is passed to the network in place
+
+	View uses the rows of a mapped IDX file where they are, nothing is copied and only the pages read are ever loaded
+	The images must stay mapped as long as the dataset is used
+*/
+
+template <typename S>
+class Dataset
+{
+	AlignedBuffer<S> _samples;
+	const S* _view;					//Rows of an IDX file used as they are, _samples is empty then
+	AlignedBuffer<uint32> _labels;
+
+	size_t _count;
+	size_t _sampleSize;
+
+public:
+	Dataset() : _view(nullptr), _count(0), _sampleSize(0) {}
+
+	//Replaces the samples with copies of images, 0-255 pixels become [0, 1] once scaled by GetInputScale
+	//Rows are split over scheduler if set. Returns false if there is not one label per image
+	bool Assign(const ImagesIDX3& images, const LabelsIDX1& labels, TaskScheduler* scheduler = nullptr);
+
+	//Points the samples at images' pixels instead of copying them, only the labels are copied
+	//Assigns instead if the samples are not bytes or the images are not one block (images added with AddImage)
+	bool View(const ImagesIDX3& images, const LabelsIDX1& labels, TaskScheduler* scheduler = nullptr);
+
+	bool IsView() const { return _view != nullptr; }
+
+	//Random order, rows and labels are swapped in place
+	//A view's rows belong to the file, they are copied out first (shuffle an index or pointer order instead to avoid that)
+	void Shuffle(Random&);
+
+	size_t GetCount() const { return _count; }
+	size_t GetSampleSize() const { return _sampleSize; }
+
+	//Network input = stored value * GetInputScale()
+	static constexpr float GetInputScale() { return sizeof(S) == 1 ? 1.f / 255.f : 1.f; }
+
+	//[count - first x sample size] rows starting at sample first
+	const S* GetSamples(size_t first = 0) const { return (_view ? _view : _samples.Data()) + first * _sampleSize; }
+	const uint32* GetLabels(size_t first = 0) const { return _labels.Data() + first; }
+};
@@ -1,6 +1,15 @@
 #include "Digits.hpp"
+#include "BatchPipeline.hpp"
+#include "Dataset.hpp"
+#include "FrozenNetwork.hpp"
+#include "IDXStream.hpp"
 #include "ImagesIDX3.hpp"
+#include "Kernels.hpp"
 #include "LabelsIDX1.hpp"
+#include "ParallelTrainer.hpp"
+#include "QuantizedNetwork.hpp"
+#include "SelfTest.hpp"
+#include "StaticNetwork.hpp"
 #include <ELCore/ByteReader.hpp>
 #include <ELCore/ByteWriter.hpp>
 #include <ELGraphics/RenderEntry.hpp>
@@ -8,9 +17,11 @@
 #include <ELSys/Debug.hpp>
 #include <ELSys/IO.hpp>
 #include <ELSys/Time.hpp>
+#include <ELSys/Timer.hpp>
 #include <ELMaths/Random.hpp>
 
-bool _ReadNetStateFromFile(LayeredNetwork& network)
+template <typename T>
+bool _ReadNetStateFromFile(LayeredNetworkT<T>& network)
 {
 	if (!IO::FileExists("Data/net-state.bin"))
 	{
@@ -25,7 +36,7 @@ bool _ReadNetStateFromFile(LayeredNetwork& network)
 		try
 		{
 			ByteReader reader(netStateData);
-			network = LayeredNetwork(reader);
+			network = LayeredNetworkT<T>(reader);
 		}
 		catch (int errorCode)
 		{
@@ -154,55 +165,160 @@ DrawingUpdate _HandleDrawingWindow(Window& window, Texture& tex, Buffer<byte>& i
 	return result;
 }
 
-const double desiredStates[10][10] = {
-	{1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-	{0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
-	{0, 0, 1, 0, 0, 0, 0, 0, 0, 0},
-	{0, 0, 0, 1, 0, 0, 0, 0, 0, 0},
-	{0, 0, 0, 0, 1, 0, 0, 0, 0, 0},
-	{0, 0, 0, 0, 0, 1, 0, 0, 0, 0},
-	{0, 0, 0, 0, 0, 0, 1, 0, 0, 0},
-	{0, 0, 0, 0, 0, 0, 0, 1, 0, 0},
-	{0, 0, 0, 0, 0, 0, 0, 0, 1, 0},
-	{0, 0, 0, 0, 0, 0, 0, 0, 0, 1}
-};
+const char* Digits::_GetOptimizerName(Network::Optimizer::Type type)
+{
+	switch (type)
+	{
+	case Network::Optimizer::Type::SGD: return "sgd";
+	case Network::Optimizer::Type::MOMENTUM: return "momentum";
+	case Network::Optimizer::Type::NESTEROV: return "nesterov";
+	case Network::Optimizer::Type::RMSPROP: return "rmsprop";
+	case Network::Optimizer::Type::ADAM: return "adam";
+	}
+
+	return "?";
+}
 
-void Digits::Train(int iterations, int batchSize, int layerSize, double learningRate, bool debug)
+const char* Digits::_GetActivationName(Activation activation)
 {
-	std::cout << "Begin training for " << iterations << " iterations\nbatch size = " << batchSize << 
-		"\nlayer size = " << layerSize << "\nlearning rate = " << learningRate << "\n\n";
+	switch (activation)
+	{
+	case Activation::SIGMOID: return "sigmoid";
+	case Activation::RELU: return "relu";
+	case Activation::LEAKY_RELU: return "leaky";
+	case Activation::TANH: return "tanh";
+	}
 
-	Buffer<byte> trainImageData = IO::ReadFile("Data/train-images.idx3-ubyte");
-	Buffer<byte> trainLabelData = IO::ReadFile("Data/train-labels.idx1-ubyte");
-	Buffer<byte> testImageData = IO::ReadFile("Data/test-images.idx3-ubyte");
-	Buffer<byte> testLabelData = IO::ReadFile("Data/test-labels.idx1-ubyte");
+	return "?";
+}
 
-	if (trainImageData.GetSize() <= 0 || trainLabelData.GetSize() <= 0 || testImageData.GetSize() <= 0 || testLabelData.GetSize() <= 0)
-		return;
+bool Digits::_GenerateLayer(Network::Layer& layer, const String& spec)
+{
+	Buffer<String> parts = spec.ToLower().Split(":");
+	if (parts.GetSize() == 0) return false;
+
+	if (parts[0] == "conv")
+	{
+		if (parts.GetSize() < 3) return false;
+
+		const int channels = parts[1].ToInt();
+		const int kernel = parts[2].ToInt();
+		const int stride = parts.GetSize() > 3 ? parts[3].ToInt() : 1;
+		const int padding = parts.GetSize() > 4 ? parts[4].ToInt() : 0;
+		if (channels <= 0 || kernel <= 0 || stride <= 0 || padding < 0) return false;
+
+		return layer.SetInputWindow(Network::LinkingType::CONV, Network::Window(kernel, stride, padding, channels));
+	}
+
+	if (parts[0] == "max" || parts[0] == "avg")
+	{
+		if (parts.GetSize() < 2) return false;
+
+		//windows do not overlap by default
+		const int size = parts[1].ToInt();
+		const int stride = parts.GetSize() > 2 ? parts[2].ToInt() : size;
+		if (size <= 0 || stride <= 0) return false;
+
+		return layer.SetInputWindow(parts[0] == "max" ? Network::LinkingType::MAX_POOL : Network::LinkingType::AVG_POOL, Network::Window(size, stride));
+	}
+
+	const int size = parts[0].ToInt();
+	if (size <= 0) return false;
+
+	layer.Generate(size);
+	layer.SetInputLinkType(Network::LinkingType::ALL);
+	return true;
+}
+
+void Digits::Train(int iterations, int batchSize, const Buffer<String>& layers, double learningRate, bool debug)
+{
+	ParallelTrainer<Scalar> trainer(_scheduler);
+
+	std::cout << "Begin training for " << iterations << " iterations\nbatch size = " << batchSize << "\nlayers =";
+
+	for (const String& layer : layers)
+		std::cout << ' ' << layer.GetData();
+
+	std::cout << (layers.GetSize() ? "" : " (from file)") <<
+		"\nkernels = " << Kernels::GetInstructionSetName(Kernels::GetInstructionSet()) << 
+		"\nprecision = " << (sizeof(Scalar) == sizeof(float) ? "float" : "double") <<
+		"\nthreads = " << trainer.GetThreadCount() <<
+		"\nmode = " << (_hogwild ? "hogwild (batch size ignored)" : "minibatch") <<
+		"\naugmentation = " << (!_augmentation.IsEnabled() ? "none" : _hogwild ? "none (minibatch mode only)" : "on") << "\n\n";
 
 	Random rand(Time::GetRandSeed());
 
 	std::cout << "Creating network...\n";
 
-	if (layerSize < 0)
+	if (layers.GetSize() == 0)
 	{
 		if (!_ReadNetStateFromFile(_network)) return;
 	}
 	else
 	{
-		_network.InputLayer().Generate(784);
+		_network = Network();
+		_network.SetCost(_cost);
+		_network.InputLayer().Generate(Network::Shape(28, 28, 1));
 		_network.OutputLayer().Generate(10);
 
-		auto& mid = _network.CreateLayer();
-		mid.Generate(layerSize);
+		//mid layers are stacked, each taking the previous one as input
+		for (const String& layer : layers)
+		{
+			auto& mid = _network.CreateLayer();
+			mid.SetActivation(_activation);
 
-		mid.SetInputLinkType(LayeredNetwork::LinkingType::ALL);
-		_network.OutputLayer().SetInputLinkType(LayeredNetwork::LinkingType::ALL);
+			if (!_GenerateLayer(mid, layer))
+			{
+				Debug::Error(CSTR("GEN ERROR: BAD LAYER ", layer.GetData(), "!"));
+				return;
+			}
+
+			mid.RandomiseWeightsAndBiases(rand);
+		}
 
-		mid.RandomiseWeightsAndBiases(rand);
+		_network.OutputLayer().SetInputLinkType(Network::LinkingType::ALL);
 		_network.OutputLayer().RandomiseWeightsAndBiases(rand);
 	}
 
+	//independent branches of the layer graph run on the scheduler too
+	_network.SetScheduler(&_scheduler);
+
+	_network.SetOptimizer(_optimizer);
+
+	if (learningRate <= 0.0)
+	{
+		//cross-entropy gradients are not damped by sigmoid', so softmax networks want a smaller step
+		learningRate = _network.GetCost() == Network::Cost::SOFTMAX_CROSS_ENTROPY ? 0.5 : 3.0;
+
+		switch (_optimizer.type)
+		{
+		case Network::Optimizer::Type::MOMENTUM:
+		case Network::Optimizer::Type::NESTEROV:
+			//the velocity builds up to 1 / (1 - momentum) steps
+			learningRate *= 1.0 - _optimizer.momentum;
+			break;
+
+		case Network::Optimizer::Type::RMSPROP:
+		case Network::Optimizer::Type::ADAM:
+			//steps are normalised by the gradient's own size, so the rate is the step size
+			learningRate = 0.001;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	std::cout << "cost = " << (_network.GetCost() == Network::Cost::SOFTMAX_CROSS_ENTROPY ? "softmax cross-entropy" : "quadratic") <<
+		"\nactivations =";
+
+	for (size_t i = 2; i < _network.GetLayerCount(); ++i)
+		std::cout << ' ' << _GetActivationName(_network.GetLayer(i).GetActivation());
+
+	std::cout << ' ' << (_network.GetCost() == Network::Cost::SOFTMAX_CROSS_ENTROPY ? "softmax" : _GetActivationName(_network.OutputLayer().GetActivation())) <<
+		"\noptimizer = " << _GetOptimizerName(_optimizer.type) <<
+		"\nlearning rate = " << learningRate << "\n\n";
+
 	std::cout << "Reading training/testing data...\n";
 
 	ImagesIDX3 trainImages;
@@ -210,71 +326,72 @@ void Digits::Train(int iterations, int batchSize, int layerSize, double learning
 	ImagesIDX3 testImages;
 	LabelsIDX1 testLabels;
 
+	//Streamed minibatch training reads the training set in chunks through a fixed amount of memory, otherwise it is loaded whole
+	const bool streamed = _streamMegabytes > 0 && !_hogwild;
+	IDXStream trainStream;
+
+	if (streamed)
 	{
-		ByteReader trainImageReader(trainImageData);
-		if (!trainImages.Read(trainImageReader)) return;
-	
-		ByteReader trainLabelReader(trainLabelData);
-		if (!trainLabels.Read(trainLabelReader)) return;
-	
-		ByteReader testImageReader(testImageData);
-		if (!testImages.Read(testImageReader)) return;
+		//4 MB reads keep the disk streaming, 3/4 of the memory mixes chunks and 1/4 reads ahead
+		const size_t chunkBytes = (size_t)4 << 20;
+		const size_t chunks = Maths::Max((size_t)2, ((size_t)_streamMegabytes << 20) / chunkBytes);
 
-		ByteReader testLabelReader(testLabelData);
-		if (!testLabels.Read(testLabelReader)) return;
+		if (!trainStream.Open("Data/train-images.idx3-ubyte", "Data/train-labels.idx1-ubyte", chunkBytes, chunks - chunks / 4, chunks / 4)) return;
 	}
+	else
+	{
+		//training gathers its rows straight from the mapping, in shuffled order
+		if (!trainImages.Map("Data/train-images.idx3-ubyte", MappedFile::Access::RANDOM)) return;
+		if (!trainLabels.Map("Data/train-labels.idx1-ubyte", MappedFile::Access::SEQUENTIAL)) return;
 
-	Debug::Assert(trainImages.GetHeight() == testImages.GetHeight(), "training / test image height mismatch");
-	Debug::Assert(trainImages.GetWidth() == testImages.GetWidth(), "training / test image width mismatch");
+		Debug::Assert(trainImages.GetCount() == trainLabels.GetCount(), "training image count does not equal training label count!");
+	}
 
-	Debug::Assert(trainImages.GetCount() == trainLabels.GetCount(), "training image count does not equal training label count!");
-	Debug::Assert(testImages.GetCount() == testLabels.GetCount(), "test image count does not equal test label count!");
-	
-	const uint32 imgW = trainImages.GetWidth();
-	const uint32 imgH = trainImages.GetHeight();
+	if (!testImages.Map("Data/test-images.idx3-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+	if (!testLabels.Map("Data/test-labels.idx1-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+
+	const uint32 imgW = streamed ? trainStream.GetWidth() : trainImages.GetWidth();
+	const uint32 imgH = streamed ? trainStream.GetHeight() : trainImages.GetHeight();
 	const uint32 imgSz = imgW * imgH;
+	const uint32 trainCount = streamed ? trainStream.GetCount() : trainImages.GetCount();
+
+	Debug::Assert(imgH == testImages.GetHeight(), "training / test image height mismatch");
+	Debug::Assert(imgW == testImages.GetWidth(), "training / test image width mismatch");
+
+	Debug::Assert(testImages.GetCount() == testLabels.GetCount(), "test image count does not equal test label count!");
 	
-	std::cout << CSTR("training: found ", trainImages.GetCount(), " images (", trainImages.GetWidth(), 'x', trainImages.GetHeight(), ")\n");
-	std::cout << CSTR("testing: found ", testImages.GetCount(), " images (", trainImages.GetWidth(), 'x', trainImages.GetHeight(), ")\n");
+	std::cout << CSTR("training: found ", trainCount, " images (", imgW, 'x', imgH, ")");
+	if (streamed) std::cout << ", streamed through " << (trainStream.GetBufferBytes() >> 20) << " MB";
+	std::cout << '\n';
+	std::cout << CSTR("testing: found ", testImages.GetCount(), " images (", imgW, 'x', imgH, ")\n");
 	
 	Debug::Assert(imgW == 28 && imgH == 28, CSTR("expected image size of 28x28, instead found (", imgW, 'x', imgH, ")!"));
 
 	std::cout << "Generating input buffers...\n";
-	Buffer<Buffer<double>> trainInputs;
-	Buffer<Buffer<double>> testInputs;
-	trainInputs.SetSize(trainImages.GetCount());
-	testInputs.SetSize(testImages.GetCount());
 
-	const size_t maxCount = Maths::Max(trainImages.GetCount(), testImages.GetCount());
-	for (size_t i = 0; i < maxCount; ++i)
-	{
-		if (i < trainInputs.GetSize())
-		{
-			trainInputs[i].SetSize(imgSz);
-
-			const byte* img = trainImages.GetImage(i);
-			for (int p = 0; p < imgSz; ++p)
-				trainInputs[i][p] = (double)img[p] / 255.0;
-		}
+	//Pixels stay bytes where they are in the mapped files, the network scales them to [0, 1] as it reads them
+	Dataset<byte> trainSet;
+	Dataset<byte> testSet;
+	if (!streamed) trainSet.View(trainImages, trainLabels, &_scheduler);
+	testSet.View(testImages, testLabels, &_scheduler);
 
-		if (i < testInputs.GetSize())
-		{
-			testInputs[i].SetSize(imgSz);
+	const Scalar inputScale = (Scalar)Dataset<byte>::GetInputScale();
 
-			const byte* img = testImages.GetImage(i);
-			for (int p = 0; p < imgSz; ++p)
-				testInputs[i][p] = (double)img[p] / 255.0;
-		}
+	if (_network.InputLayer().GetSize() != imgSz || _network.OutputLayer().GetSize() != 10)
+	{
+		Debug::Error("TRAINING ERROR: LAYER SIZE MISMATCH!");
+		return;
 	}
 
-	Buffer<double> oBuffer;
-	oBuffer.SetSize(10);
+	Buffer<Scalar> batchOutputs;
+	batchOutputs.SetSize((size_t)batchSize * 10);
 
-	Buffer<uint32> batchIndices;
-	batchIndices.SetSize(trainInputs.GetSize());
+	//enough rows for every thread to get a useful shard
+	const int testBatchSize = 250 * trainer.GetThreadCount();
+	Buffer<Scalar> testOBuffer;
+	testOBuffer.SetSize((size_t)testBatchSize * 10);
 
-	for (int i = 0; i < batchIndices.GetSize(); ++i)
-		batchIndices[i] = i;
+	const int sampleCount = (int)trainCount;
 
 	//Debug setup
 	Buffer<byte> imgData;
@@ -288,70 +405,179 @@ void Digits::Train(int iterations, int batchSize, int layerSize, double learning
 		_InitTexEnvironment(tex, imgData, imgW, imgH);
 	}
 
-	int dotStep = batchIndices.GetSize() / 10;
-	WindowEvent e;
-	for (int iteration = 0; iteration < iterations; ++iteration)
+	//Hogwild trains straight from the rows, through pointers (and labels) that are shuffled in their place
+	Buffer<const byte*> hogwildInputs;
+	Buffer<uint32> hogwildLabels;
+
+	//Minibatches are shuffled, gathered and augmented into staging on the loader thread, a few batches ahead of the one training
+	//Augmentation shares the pool with training, but the loader's waits never run training shards (nor the trainer's augmentation)
+	Augmenter augmenter(_scheduler, (uint32)Time::GetRandSeed());
+	augmenter.SetSettings(_augmentation);
+
+	BatchPipeline<byte> batches;
+
+	if (_hogwild)
 	{
-		std::cout << "ITERATION " << iteration;
+		hogwildInputs.SetSize(sampleCount);
+		hogwildLabels.SetSize(sampleCount);
+		for (int i = 0; i < sampleCount; ++i)
+		{
+			hogwildInputs[i] = trainSet.GetSamples(i);
+			hogwildLabels[i] = trainSet.GetLabels()[i];
+		}
 
-		for (int i = 0; i < batchIndices.GetSize(); ++i)
-			Utilities::Swap(batchIndices[i], batchIndices[(size_t)(rand.NextFloat() * batchIndices.GetSize())]);
+		if (debug)
+		{
+			std::cout << "(no preview in hogwild mode)\n";
+			debug = false;
+		}
+	}
+	else if (streamed)
+	{
+		Buffer<const byte*> sources;
+		sources.SetSize(batchSize);
 
-		for (int batchStart = 0; batchStart < batchIndices.GetSize(); batchStart += batchSize)
+		trainStream.Start(iterations, (uint32)Time::GetRandSeed());
+
+		//The stream already shuffles, and never returns samples of two epochs at once
+		batches.Start(imgSz, batchSize, 3, [&, sources = std::move(sources)](byte* samples, uint32* labels, size_t capacity) mutable -> size_t
 		{
-			_network.BeginTraining();
+			const size_t count = trainStream.Next(sources.Data(), labels, capacity);
+			augmenter.Apply(sources.Data(), samples, count, imgW, imgH);
+			return count;
+		});
+	}
+	else
+	{
+		Buffer<uint32> order;
+		order.SetSize(sampleCount);
+		for (int i = 0; i < sampleCount; ++i)
+			order[i] = i;
+
+		Buffer<const byte*> sources;
+		sources.SetSize(batchSize);
 
-			for (int batchItem = 0; batchItem < batchSize; ++batchItem)
+		//The producer owns the sample order and runs on the loader thread, which is the only one using rand from here on
+		batches.Start(imgSz, batchSize, 3, [&, order = std::move(order), sources = std::move(sources), next = (size_t)0, epochsLoaded = 0](byte* samples, uint32* labels, size_t capacity) mutable -> size_t
+		{
+			if (next == 0)
+			{
+				if (epochsLoaded == iterations)
+					return 0;
+
+				//Fisher-Yates over the indices, the rows stay where they are
+				for (size_t i = 0; i + 1 < order.GetSize(); ++i)
+					Utilities::Swap(order[i], order[Maths::Min(i + (size_t)(rand.NextDouble() * (double)(order.GetSize() - i)), order.GetSize() - 1)]);
+
+				++epochsLoaded;
+			}
+
+			//batches never straddle two epochs
+			const size_t count = Maths::Min(capacity, order.GetSize() - next);
+			for (size_t i = 0; i < count; ++i)
 			{
-				const int batchIndex = batchStart + batchItem;
-				const int imageIndex = batchIndices[batchIndex];
-				Buffer<double>& iBuffer = trainInputs[imageIndex];
+				const uint32 index = order[next + i];
+				sources[i] = trainSet.GetSamples(index);
+				labels[i] = trainSet.GetLabels()[index];
+			}
+
+			//a plain copy when augmentation is off
+			augmenter.Apply(sources.Data(), samples, count, imgW, imgH);
+
+			next += count;
+			if (next == order.GetSize()) next = 0;
+
+			return count;
+		});
+	}
 
-				//Train
-				if (!_network.Train(iBuffer.Data(), iBuffer.GetSize(), desiredStates[trainLabels.GetLabel(imageIndex)], oBuffer.Data(), 10))
-					Debug::PrintLine("TRAINING ERROR: LAYER SIZE MISMATCH!");
+	int dotStep = sampleCount / 10;
+	WindowEvent e;
+	auto shuffle = [&]()
+	{
+		//Fisher-Yates over the pointers and labels together, the mapped rows stay where they are
+		for (size_t i = 0; i + 1 < hogwildInputs.GetSize(); ++i)
+		{
+			const size_t j = Maths::Min(i + (size_t)(rand.NextDouble() * (double)(hogwildInputs.GetSize() - i)), hogwildInputs.GetSize() - 1);
+			Utilities::Swap(hogwildInputs[i], hogwildInputs[j]);
+			Utilities::Swap(hogwildLabels[i], hogwildLabels[j]);
+		}
+	};
 
-				if (batchIndex % dotStep == 0) std::cout << '.';
+	//Later iterations are shuffled while the previous one is being tested
+	if (_hogwild) shuffle();
 
-				if (debug)
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		std::cout << "ITERATION " << iteration;
+
+		if (_hogwild)
+		{
+			trainer.TrainHogwild(_network, hogwildInputs.Data(), inputScale, hogwildLabels.Data(), hogwildInputs.GetSize(), learningRate);
+		}
+		else
+		{
+			BatchPipeline<byte>::Batch batch;
+			for (int batchStart = 0; batchStart < sampleCount && batches.Next(batch); batchStart += (int)batch.count)
+			{
+				for (int batchItem = 0; batchItem < (int)batch.count; ++batchItem)
 				{
-					WindowEvent e;
-					while (_previewWindow.PollEvent(e))
-						if (e.type == WindowEvent::RESIZE)
-							glViewport(0, 0, e.data.resize.w, e.data.resize.h);
+					const int batchIndex = batchStart + batchItem;
+
+					if (batchIndex % dotStep == 0) std::cout << '.';
+
+					if (debug)
+					{
+						WindowEvent e;
+						while (_previewWindow.PollEvent(e))
+							if (e.type == WindowEvent::RESIZE)
+								glViewport(0, 0, e.data.resize.w, e.data.resize.h);
 
-					for (int i = 0; i < imgData.GetSize(); i += 4)
-						imgData[i] = imgData[i + 1] = imgData[i + 2] = iBuffer[i / 4] * 255;
+						const byte* image = batch.samples + (size_t)batchItem * imgSz;
+						for (int i = 0; i < imgData.GetSize(); i += 4)
+							imgData[i] = imgData[i + 1] = imgData[i + 2] = image[i / 4];
 
-					tex.Modify(0, 0, 0, imgW, imgH, imgData.Data());
+						tex.Modify(0, 0, 0, imgW, imgH, imgData.Data());
 
-					char title[30];
-					std::snprintf(title, 30, "%d", trainLabels.GetLabel(imageIndex));
-					_previewWindow.SetTitle(title);
+						char title[30];
+						std::snprintf(title, 30, "%d", batch.labels[batchItem]);
+						_previewWindow.SetTitle(title);
 
-					_RenderTextureToWindow(_previewWindow, _program, tex, &_meshes, &_textures);
+						_RenderTextureToWindow(_previewWindow, _program, tex, &_meshes, &_textures);
+					}
 				}
-			}
 
-			_network.ApplyTraining(learningRate);
+				//Train, the loader is already filling the batches after this one
+				trainer.TrainBatch(_network, batch.samples, inputScale, batch.count, batch.labels, batchOutputs.Data(), learningRate);
+				batches.Release();
+			}
 		}
 
 		if (true)
 		{
+			TaskGroup nextShuffle(_scheduler);
+			if (_hogwild && iteration + 1 < iterations)
+				nextShuffle.Run(shuffle);
+
 			std::cout << "| Matched ";
 
 			int matches = 0;
-			for (int test = 0; test < testImages.GetCount(); ++test)
+			for (int testStart = 0; testStart < testImages.GetCount(); testStart += testBatchSize)
 			{
-				Buffer<double>& iBuffer = testInputs[test];
-				_network.Evaluate(iBuffer.Data(), iBuffer.GetSize(), oBuffer.Data(), oBuffer.GetSize());
+				const int batch = Maths::Min(testBatchSize, (int)testImages.GetCount() - testStart);
+				trainer.EvaluateBatch(_network, testSet.GetSamples(testStart), inputScale, batch, testOBuffer.Data());
 
-				int largest = 0;
-				for (int i = 1; i < 10; ++i)
-					if (oBuffer[i] > oBuffer[largest])
-						largest = i;
+				for (int test = 0; test < batch; ++test)
+				{
+					const Scalar* outputs = &testOBuffer[(size_t)test * 10];
+
+					int largest = 0;
+					for (int i = 1; i < 10; ++i)
+						if (outputs[i] > outputs[largest])
+							largest = i;
 
-				if (largest == testLabels.GetLabel(test)) ++matches;
+					if (largest == testLabels.GetLabel(testStart + test)) ++matches;
+				}
 			}
 
 			std::cout << matches << "/" << testImages.GetCount() << "\n";
@@ -368,20 +594,40 @@ void Digits::Train(int iterations, int batchSize, int layerSize, double learning
 
 void Digits::Draw()
 {
-	if (!_ReadNetStateFromFile(_network)) return;
-	
+	if (!IO::FileExists("Data/net-state.bin"))
+	{
+		std::cout << "No existing network found...\n";
+		return;
+	}
+
+	//Drawing only evaluates, so the training state is never needed
+	FrozenNetworkT<Scalar> network;
+	FrozenNetworkT<Scalar>::Workspace workspace;
+
+	{
+		std::cout << "Reading net state...\n";
+		Buffer<byte> netStateData = IO::ReadFile("Data/net-state.bin", true);
+		ByteReader reader(netStateData);
+
+		if (!network.Read(reader))
+		{
+			Debug::Error("Invalid netfile");
+			return;
+		}
+	}
+
 	_previewWindow.SetSize(256, 256);
 	_previewWindow.Show();
 
 	Texture tex;
 	Buffer<byte> imgData;
-	const int w = Maths::SquareRoot(_network.InputLayer().GetSize());
+	const int w = Maths::SquareRoot(network.GetInputSize());
 	_InitTexEnvironment(tex, imgData, w, w);
 
-	Buffer<double> iBuffer;
-	iBuffer.SetSize(_network.InputLayer().GetSize());
+	Buffer<Scalar> iBuffer;
+	iBuffer.SetSize(network.GetInputSize());
 
-	double oBuffer[10];
+	Scalar oBuffer[10];
 
 	float penRadiusSq = 5.f;
 	bool drawing = false;
@@ -395,10 +641,10 @@ void Digits::Draw()
 		{
 			//Evaluate network
 			for (size_t i = 0; i < iBuffer.GetSize(); ++i)
-				iBuffer[i] = imgData[i * 4] / 255.0;
+				iBuffer[i] = (Scalar)(imgData[i * 4] / 255.0);
 
 			std::cout << "Evaluating... ";
-			if (_network.Evaluate(iBuffer.Data(), iBuffer.GetSize(), oBuffer, 10))
+			if (network.Evaluate(workspace, iBuffer.Data(), iBuffer.GetSize(), oBuffer, 10))
 			{
 				int largest = 0;
 				for (int i = 1; i < 10; ++i)
@@ -424,6 +670,8 @@ void Digits::Draw()
 void Digits::MTrain()
 {
 	std::cout << "Loading training data...\n";
+
+	//Read rather than mapped, the same files are written back with the new images
 	Buffer<byte> trainImageData = IO::ReadFile("Data/train-images.idx3-ubyte");
 	Buffer<byte> trainLabelData = IO::ReadFile("Data/train-labels.idx1-ubyte");
 
@@ -513,6 +761,251 @@ void Digits::MTrain()
 	IO::WriteFile("Data/train-labels.idx1-ubyte", trainLabelData);
 }
 
+void Digits::Quantize(int calibrationCount)
+{
+	if (!_ReadNetStateFromFile(_network)) return;
+
+	ImagesIDX3 trainImages;
+	ImagesIDX3 testImages;
+	LabelsIDX1 testLabels;
+
+	if (!trainImages.Map("Data/train-images.idx3-ubyte", MappedFile::Access::RANDOM)) return;
+	if (!testImages.Map("Data/test-images.idx3-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+	if (!testLabels.Map("Data/test-labels.idx1-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+
+	const uint32 imgSz = trainImages.GetWidth() * trainImages.GetHeight();
+	if (_network.InputLayer().GetSize() != imgSz || _network.OutputLayer().GetSize() != 10)
+	{
+		Debug::Error("QUANTIZE ERROR: LAYER SIZE MISMATCH!");
+		return;
+	}
+
+	//Calibrate on a random sample of the training set
+	calibrationCount = Maths::Min(calibrationCount, (int)trainImages.GetCount());
+	std::cout << "Calibrating on " << calibrationCount << " training images...\n";
+
+	Random rand(Time::GetRandSeed());
+
+	Buffer<Scalar> calibrationInputs;
+	calibrationInputs.SetSize((size_t)calibrationCount * imgSz);
+	for (int i = 0; i < calibrationCount; ++i)
+	{
+		const byte* img = trainImages.GetImage((size_t)(rand.NextFloat() * trainImages.GetCount()) % trainImages.GetCount());
+		for (uint32 p = 0; p < imgSz; ++p)
+			calibrationInputs[(size_t)i * imgSz + p] = (Scalar)(img[p] / 255.0);
+	}
+
+	QuantizedNetwork quantized;
+	if (!quantized.Quantize(_network, calibrationInputs.Data(), calibrationCount))
+	{
+		Debug::Error("QUANTIZE ERROR: OUTPUT LAYER IS NOT A SIMPLE CHAIN FROM THE INPUT LAYER!");
+		return;
+	}
+
+	//Both models are evaluated one sample at a time, as they would be when serving requests
+	Buffer<Scalar> input;
+	Buffer<float> quantizedInput;
+	input.SetSize(imgSz);
+	quantizedInput.SetSize(imgSz);
+
+	Scalar outputs[10];
+	float quantizedOutputs[10];
+
+	int matches = 0;
+	int quantizedMatches = 0;
+	int agreements = 0;
+	double maxOutputDifference = 0.0;
+	float seconds = 0.f;
+	float quantizedSeconds = 0.f;
+
+	Timer timer;
+	for (uint32 i = 0; i < testImages.GetCount(); ++i)
+	{
+		const byte* img = testImages.GetImage(i);
+		for (uint32 p = 0; p < imgSz; ++p)
+			quantizedInput[p] = (float)(input[p] = (Scalar)(img[p] / 255.0));
+
+		timer.Start();
+		_network.Evaluate(input.Data(), imgSz, outputs, 10);
+		seconds += timer.SecondsSinceStart();
+
+		timer.Start();
+		quantized.Evaluate(quantizedInput.Data(), imgSz, quantizedOutputs, 10);
+		quantizedSeconds += timer.SecondsSinceStart();
+
+		int largest = 0;
+		int quantizedLargest = 0;
+		for (int o = 0; o < 10; ++o)
+		{
+			if (outputs[o] > outputs[largest]) largest = o;
+			if (quantizedOutputs[o] > quantizedOutputs[quantizedLargest]) quantizedLargest = o;
+
+			const double difference = (double)quantizedOutputs[o] - (double)outputs[o];
+			maxOutputDifference = Maths::Max(maxOutputDifference, difference < 0.0 ? -difference : difference);
+		}
+
+		if (largest == testLabels.GetLabel(i)) ++matches;
+		if (quantizedLargest == testLabels.GetLabel(i)) ++quantizedMatches;
+		if (largest == quantizedLargest) ++agreements;
+	}
+
+	size_t parameterBytes = 0;
+	for (size_t l = 1; l < _network.GetLayerCount(); ++l)
+	{
+		auto& layer = _network.GetLayer(l);
+		parameterBytes += (layer.GetSize() * layer.GetInputCount() + layer.GetSize()) * sizeof(Scalar);
+	}
+
+	const uint32 count = testImages.GetCount();
+	std::cout << CSTR("Original: ", matches, "/", count, " (", 100.0 * matches / count, "%), ", parameterBytes / 1024.0, "KB, ", 1e6 * seconds / count, "us/sample\n");
+	std::cout << CSTR("Int8:     ", quantizedMatches, "/", count, " (", 100.0 * quantizedMatches / count, "%), ", quantized.GetParameterBytes() / 1024.0, "KB, ", 1e6 * quantizedSeconds / count, "us/sample\n");
+	std::cout << CSTR("Accuracy delta ", 100.0 * (quantizedMatches - matches) / count, "%, predictions agree on ", agreements, "/", count, ", max output difference ", maxOutputDifference, "\n");
+}
+
+void Digits::CompareStatic()
+{
+	if (!_ReadNetStateFromFile(_network)) return;
+
+	//Holds every weight, too large to comfortably live on the stack
+	static StaticNetworkT<Scalar, 784, 30, 10> staticNetwork;
+	if (!staticNetwork.Assign(_network))
+	{
+		Debug::Error("STATIC ERROR: SAVED NETWORK IS NOT A 784-30-10 CHAIN!");
+		return;
+	}
+
+	ImagesIDX3 testImages;
+	LabelsIDX1 testLabels;
+
+	if (!testImages.Map("Data/test-images.idx3-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+	if (!testLabels.Map("Data/test-labels.idx1-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+
+	const uint32 imgSz = testImages.GetWidth() * testImages.GetHeight();
+	if (imgSz != staticNetwork.INPUT_SIZE)
+	{
+		Debug::Error("STATIC ERROR: LAYER SIZE MISMATCH!");
+		return;
+	}
+
+	Scalar input[784];
+	Scalar outputs[10];
+	Scalar staticOutputs[10];
+
+	int matches = 0;
+	int staticMatches = 0;
+	double maxOutputDifference = 0.0;
+	float seconds = 0.f;
+	float staticSeconds = 0.f;
+
+	Timer timer;
+	for (uint32 i = 0; i < testImages.GetCount(); ++i)
+	{
+		const byte* img = testImages.GetImage(i);
+		for (uint32 p = 0; p < imgSz; ++p)
+			input[p] = (Scalar)(img[p] / 255.0);
+
+		timer.Start();
+		_network.Evaluate(input, imgSz, outputs, 10);
+		seconds += timer.SecondsSinceStart();
+
+		timer.Start();
+		staticNetwork.Evaluate(input, staticOutputs);
+		staticSeconds += timer.SecondsSinceStart();
+
+		int largest = 0;
+		int staticLargest = 0;
+		for (int o = 0; o < 10; ++o)
+		{
+			if (outputs[o] > outputs[largest]) largest = o;
+			if (staticOutputs[o] > staticOutputs[staticLargest]) staticLargest = o;
+
+			const double difference = (double)staticOutputs[o] - (double)outputs[o];
+			maxOutputDifference = Maths::Max(maxOutputDifference, difference < 0.0 ? -difference : difference);
+		}
+
+		if (largest == testLabels.GetLabel(i)) ++matches;
+		if (staticLargest == testLabels.GetLabel(i)) ++staticMatches;
+	}
+
+	const uint32 count = testImages.GetCount();
+	std::cout << CSTR("Layered: ", matches, "/", count, " (", 100.0 * matches / count, "%), ", 1e6 * seconds / count, "us/sample\n");
+	std::cout << CSTR("Static:  ", staticMatches, "/", count, " (", 100.0 * staticMatches / count, "%), ", 1e6 * staticSeconds / count, "us/sample\n");
+	std::cout << CSTR("Max output difference ", maxOutputDifference, ", ", staticNetwork.GetParameterBytes() / 1024.0, "KB of parameters\n");
+}
+
+void Digits::Prune(double fraction, bool global, double neuronFraction)
+{
+	if (!_ReadNetStateFromFile(_network)) return;
+
+	ImagesIDX3 testImages;
+	LabelsIDX1 testLabels;
+
+	if (!testImages.Map("Data/test-images.idx3-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+	if (!testLabels.Map("Data/test-labels.idx1-ubyte", MappedFile::Access::SEQUENTIAL)) return;
+
+	const uint32 imgSz = testImages.GetWidth() * testImages.GetHeight();
+	if (_network.InputLayer().GetSize() != imgSz || _network.OutputLayer().GetSize() != 10)
+	{
+		Debug::Error("PRUNE ERROR: LAYER SIZE MISMATCH!");
+		return;
+	}
+
+	const uint32 count = testImages.GetCount();
+
+	Buffer<Scalar> testInputs;
+	testInputs.SetSize((size_t)count * imgSz);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const byte* img = testImages.GetImage(i);
+		for (uint32 p = 0; p < imgSz; ++p)
+			testInputs[(size_t)i * imgSz + p] = (Scalar)(img[p] / 255.0);
+	}
+
+	//one sample at a time, where the sparse products save the most over the dense ones
+	auto test = [&](const char* name)
+	{
+		Scalar outputs[10];
+		int matches = 0;
+		size_t weights = 0;
+
+		Timer timer;
+		timer.Start();
+
+		for (uint32 i = 0; i < count; ++i)
+		{
+			_network.Evaluate(&testInputs[(size_t)i * imgSz], imgSz, outputs, 10);
+
+			int largest = 0;
+			for (int o = 1; o < 10; ++o)
+				if (outputs[o] > outputs[largest]) largest = o;
+
+			if (largest == testLabels.GetLabel(i)) ++matches;
+		}
+
+		const float seconds = timer.SecondsSinceStart();
+
+		for (size_t l = 1; l < _network.GetLayerCount(); ++l)
+			weights += _network.GetLayer(l).GetWeightCount();
+
+		std::cout << CSTR(name, matches, "/", count, " (", 100.0 * matches / count, "%), ", weights, " weights, ", 1e6 * seconds / count, "us/sample\n");
+	};
+
+	test("Before: ");
+
+	if (neuronFraction > 0.0)
+		std::cout << "Removed " << _network.PruneNeurons(neuronFraction) << " hidden neurons\n";
+
+	if (fraction > 0.0)
+		_network.PruneWeights(fraction, global);
+
+	test("After:  ");
+
+	Buffer<byte> outBuffer;
+	ByteWriter outWriter(outBuffer);
+	_network.Write(outWriter);
+	IO::WriteFile("Data/net-state.bin", outBuffer);
+}
+
 int Digits::Run()
 {
 	_ctx.CreateDummyAndUse();
@@ -549,18 +1042,31 @@ int Digits::Run()
 				std::cout <<
 					"DIGIT RECOGNISER\n"
 					"----------------\n"
-					"gen [iterations=10] [batch_size=10] [layer_size=30] [learning_rate=3] [debug=0]\t\tgenerate a new network\n"
-					"train [iterations=10] [batch_size=10] [learning_rate=3] [debug=0]\t\t\ttrain existing network\n"
+					"gen [iterations=10] [batch_size=10] [layers=30] [learning_rate=0] [debug=0]\t\t\tgenerate a new network (layers e.g. 100,30 or conv:8:5,max:2,30)\n"
+					"train [iterations=10] [batch_size=10] [learning_rate=0] [debug=0]\t\t\ttrain existing network (learning_rate 0 = default for the cost & optimizer, 3 for quadratic SGD)\n"
 					"draw\t\t\t\t\t\t\t\t\t\t\tdraw digits yourself\n"
 					"mtrain\t\t\t\t\t\t\t\t\t\t\tappend new training images\n"
+					"simd [scalar|sse2|avx2|avx512]\t\t\t\t\t\t\t\tshow or force the instruction set used for training\n"
+					"sigmoid [max_error]\t\t\t\t\t\t\t\t\t\tshow or set the error allowed in the vectorised sigmoid\n"
+					"quantize [calibration_count=1000]\t\t\t\t\t\t\tcompare an int8 copy of the saved network against it\n"
+					"static\t\t\t\t\t\t\t\t\t\t\tcompare a fixed shape (784-30-10) copy of the saved network against it\n"
+					"selftest [seed=1]\t\t\t\t\t\t\t\t\tcheck the SIMD kernels, backpropagation and minibatch sharding\n"
+					"prune [fraction=0.9] [global=1] [neuron_fraction=0]\t\t\t\t\tprune the saved network's smallest weights (and weakest hidden neurons), train to recover\n"
+					"threads [count]\t\t\t\t\t\t\t\t\t\tshow or set the worker thread count (0 = all hardware threads)\n"
+					"mode [minibatch|hogwild]\t\t\t\t\t\t\t\tshow or set the training mode (hogwild learning rate is per sample)\n"
+					"cost [quadratic|softmax]\t\t\t\t\t\t\t\tshow or set the cost function of networks made by gen (default quadratic)\n"
+					"optimizer [sgd|momentum|nesterov|rmsprop|adam]\t\t\t\t\t\tshow or set the optimizer used for training\n"
+					"activation [sigmoid|relu|leaky|tanh]\t\t\t\t\t\t\tshow or set the mid layer activation of networks made by gen\n"
+					"augment [off|on|elastic|shift rotation scale elastic smoothness noise]\t\t\tshow or set random distortions of the training images\n"
+					"stream [buffer_mb]\t\t\t\t\t\t\t\t\tshow or set the memory minibatch training streams its images through (0 = load them)\n"
 					"exit\t\t\t\t\t\t\t\t\t\t\t...\n";
 			}
 			else if (first == "gen")
 			{
 				int iterations = 10;
 				int batchSize = 10;
-				int layerSize = 30;
-				double learningRate = 3.0;
+				Buffer<String> layers = { "30" };
+				double learningRate = 0.0;
 				bool debug = false;
 
 				if (tokens.GetSize() > 1)
@@ -568,19 +1074,21 @@ int Digits::Run()
 				if (tokens.GetSize() > 2)
 					batchSize = tokens[2].ToInt();
 				if (tokens.GetSize() > 3)
-					layerSize = tokens[3].ToInt();
+				{
+					layers = tokens[3].Split(",");
+				}
 				if (tokens.GetSize() > 4)
 					learningRate = tokens[4].ToFloat();
 				if (tokens.GetSize() > 5)
 					debug = tokens[5].ToInt() != 0;
 
-				Train(iterations, batchSize, layerSize, learningRate, debug);
+				Train(iterations, batchSize, layers, learningRate, debug);
 			}
 			else if (first == "train")
 			{
 				int iterations = 10;
 				int batchSize = 10;
-				double learningRate = 3.0;
+				double learningRate = 0.0;
 				bool debug = false;
 
 				if (tokens.GetSize() > 1)
@@ -592,7 +1100,7 @@ int Digits::Run()
 				if (tokens.GetSize() > 4)
 					debug = tokens[4].ToInt() != 0;
 
-				Train(iterations, batchSize, -1, learningRate, debug);
+				Train(iterations, batchSize, Buffer<String>(), learningRate, debug);
 			}
 			else if (first == "mtrain")
 			{
@@ -602,6 +1110,170 @@ int Digits::Run()
 			{
 				Draw();
 			}
+			else if (first == "quantize")
+			{
+				int calibrationCount = 1000;
+
+				if (tokens.GetSize() > 1)
+					calibrationCount = tokens[1].ToInt();
+
+				Quantize(calibrationCount);
+			}
+			else if (first == "static")
+			{
+				CompareStatic();
+			}
+			else if (first == "selftest")
+			{
+				const uint32 seed = tokens.GetSize() > 1 ? (uint32)tokens[1].ToInt() : 1;
+
+				const bool kernels = SelfTest::CheckKernels(seed);
+				const bool gradients = SelfTest::CheckGradients(seed, &_scheduler);
+				const bool parallel = SelfTest::CheckParallelTraining(seed);
+				std::cout << (kernels && gradients && parallel ? "Self test passed\n" : "SELF TEST FAILED\n");
+			}
+			else if (first == "prune")
+			{
+				double fraction = 0.9;
+				bool global = true;
+				double neuronFraction = 0.0;
+
+				if (tokens.GetSize() > 1)
+					fraction = tokens[1].ToFloat();
+				if (tokens.GetSize() > 2)
+					global = tokens[2].ToInt() != 0;
+				if (tokens.GetSize() > 3)
+					neuronFraction = tokens[3].ToFloat();
+
+				Prune(fraction, global, neuronFraction);
+			}
+			else if (first == "simd")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+					Kernels::InstructionSet instructionSet = Kernels::GetSupportedInstructionSet();
+
+					if (name == "scalar") instructionSet = Kernels::InstructionSet::SCALAR;
+					else if (name == "sse2") instructionSet = Kernels::InstructionSet::SSE2;
+					else if (name == "avx2") instructionSet = Kernels::InstructionSet::AVX2;
+					else if (name == "avx512") instructionSet = Kernels::InstructionSet::AVX512;
+
+					if (!Kernels::SetInstructionSet(instructionSet))
+						std::cout << Kernels::GetInstructionSetName(instructionSet) << " is not supported by this CPU\n";
+				}
+
+				std::cout << "Using " << Kernels::GetInstructionSetName(Kernels::GetInstructionSet()) << 
+					" kernels (best supported: " << Kernels::GetInstructionSetName(Kernels::GetSupportedInstructionSet()) << ")\n";
+			}
+			else if (first == "sigmoid")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const double maxError = tokens[1].ToFloat();
+					if (maxError > 0.0)
+						Kernels::SetSigmoidMaxError(maxError);
+					else
+						std::cout << "max_error must be positive\n";
+				}
+
+				std::cout << "Sigmoid error <= " << Kernels::GetSigmoidMaxError<Scalar>() << " (degree " << Kernels::GetSigmoidDegree<Scalar>() << " exp polynomial)\n";
+			}
+			else if (first == "threads")
+			{
+				if (tokens.GetSize() > 1)
+					_scheduler.SetThreadCount(Maths::Max(0, (int)tokens[1].ToInt()));
+
+				std::cout << "Using " << _scheduler.GetThreadCount() << " threads\n";
+			}
+			else if (first == "mode")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+
+					if (name == "minibatch") _hogwild = false;
+					else if (name == "hogwild") _hogwild = true;
+					else std::cout << "Unknown mode \"" << name << "\"\n";
+				}
+
+				std::cout << "Training mode: " << (_hogwild ? "hogwild" : "minibatch") << '\n';
+			}
+			else if (first == "cost")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+
+					if (name == "quadratic") _cost = Network::Cost::QUADRATIC;
+					else if (name == "softmax") _cost = Network::Cost::SOFTMAX_CROSS_ENTROPY;
+					else std::cout << "Unknown cost \"" << name << "\"\n";
+				}
+
+				std::cout << "New networks use " << (_cost == Network::Cost::SOFTMAX_CROSS_ENTROPY ? "softmax cross-entropy" : "quadratic") << " cost\n";
+			}
+			else if (first == "optimizer")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+
+					if (name == "sgd") _optimizer.type = Network::Optimizer::Type::SGD;
+					else if (name == "momentum") _optimizer.type = Network::Optimizer::Type::MOMENTUM;
+					else if (name == "nesterov") _optimizer.type = Network::Optimizer::Type::NESTEROV;
+					else if (name == "rmsprop") _optimizer.type = Network::Optimizer::Type::RMSPROP;
+					else if (name == "adam") _optimizer.type = Network::Optimizer::Type::ADAM;
+					else std::cout << "Unknown optimizer \"" << name << "\"\n";
+				}
+
+				std::cout << "Training with " << _GetOptimizerName(_optimizer.type) << '\n';
+			}
+			else if (first == "augment")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+
+					if (name == "off") _augmentation = Augmenter::Settings();
+					else if (name == "on") _augmentation = Augmenter::Settings(2.f, 10.f, 0.1f);
+					else if (name == "elastic") _augmentation = Augmenter::Settings(2.f, 10.f, 0.1f, 34.f, 4.f);
+					else
+					{
+						float* values[] = { &_augmentation.shift, &_augmentation.rotation, &_augmentation.scale, &_augmentation.elastic, &_augmentation.smoothness, &_augmentation.noise };
+						for (size_t i = 1; i < tokens.GetSize() && i <= 6; ++i)
+							*values[i - 1] = Maths::Max(0.f, (float)tokens[i].ToFloat());
+					}
+				}
+
+				std::cout << "Augmentation: shift " << _augmentation.shift << "px, rotation " << _augmentation.rotation << " degrees, scale " << _augmentation.scale <<
+					", elastic " << _augmentation.elastic << " (smoothness " << _augmentation.smoothness << "), noise " << _augmentation.noise <<
+					(_augmentation.IsEnabled() ? "\n" : " (off)\n");
+			}
+			else if (first == "stream")
+			{
+				if (tokens.GetSize() > 1)
+					_streamMegabytes = Maths::Max(0, (int)tokens[1].ToInt());
+
+				if (_streamMegabytes > 0)
+					std::cout << "Minibatch training streams its images through " << _streamMegabytes << " MB\n";
+				else
+					std::cout << "Training images are loaded whole\n";
+			}
+			else if (first == "activation")
+			{
+				if (tokens.GetSize() > 1)
+				{
+					const String name = tokens[1].ToLower();
+
+					if (name == "sigmoid") _activation = Activation::SIGMOID;
+					else if (name == "relu") _activation = Activation::RELU;
+					else if (name == "leaky") _activation = Activation::LEAKY_RELU;
+					else if (name == "tanh") _activation = Activation::TANH;
+					else std::cout << "Unknown activation \"" << name << "\"\n";
+				}
+
+				std::cout << "New networks use " << _GetActivationName(_activation) << " mid layers\n";
+			}
 		}
 	}
 
@@ -0,0 +1,311 @@
+#include "FrozenNetwork.hpp"
+#include "Kernels.hpp"
+#include <ELCore/ByteReader.hpp>
+#include <ELMaths/Maths.hpp>
+
+template <typename T>
+template <typename U>
+bool FrozenNetworkT<T>::Assign(const LayeredNetworkT<U>& network)
+{
+	using Source = typename LayeredNetworkT<U>::Layer;
+
+	const size_t layerCount = network.GetLayerCount();
+	if (layerCount < 2)
+		return false;
+
+	//Find every layer the output depends on
+	Buffer<bool> needed;
+	needed.SetSize(layerCount);
+	for (size_t i = 0; i < layerCount; ++i)
+		needed[i] = false;
+
+	Buffer<int> stack;
+	stack.SetSize(layerCount);
+
+	size_t stackSize = 0;
+	needed[1] = true;
+	stack[stackSize++] = 1;
+
+	auto visit = [&](int layer)
+	{
+		if (layer >= 0 && !needed[layer])
+		{
+			needed[layer] = true;
+			stack[stackSize++] = layer;
+		}
+	};
+
+	while (stackSize)
+	{
+		const int layer = stack[--stackSize];
+		if (layer == 0) continue;
+
+		const Source& source = network.GetLayer(layer);
+		for (size_t i = 0; i < source.GetInputLayerCount(); ++i)
+			visit(source.GetInputLayer(i));
+
+		visit(source.GetResidualLayer());
+	}
+
+	//frozen[i] is the index in _layers of network layer i, -1 until it is placed after everything it reads from
+	Buffer<int> frozen;
+	frozen.SetSize(layerCount);
+	for (size_t i = 0; i < layerCount; ++i)
+		frozen[i] = -1;
+
+	frozen[0] = 0;
+
+	//order[l] is the network layer frozen into _layers[l]
+	Buffer<int> order;
+	order.SetSize(layerCount);
+	order[0] = 0;
+
+	size_t count = 1;
+
+	size_t remaining = 0;
+	for (size_t i = 1; i < layerCount; ++i)
+		if (needed[i]) ++remaining;
+
+	while (remaining)
+	{
+		size_t resolved = 0;
+
+		for (size_t i = 1; i < layerCount; ++i)
+		{
+			if (!needed[i] || frozen[i] >= 0) continue;
+
+			const Source& source = network.GetLayer(i);
+
+			bool ready = source.GetResidualLayer() < 0 || frozen[source.GetResidualLayer()] >= 0;
+			for (size_t j = 0; j < source.GetInputLayerCount(); ++j)
+				ready &= frozen[source.GetInputLayer(j)] >= 0;
+
+			if (ready)
+			{
+				frozen[i] = (int)count;
+				order[count++] = (int)i;
+				++resolved;
+			}
+		}
+
+		if (resolved == 0)
+			return false;
+
+		remaining -= resolved;
+	}
+
+	Buffer<Layer> layers;
+	layers.SetSize(count);
+	layers[0].size = network.GetLayer(0).GetSize();
+
+	for (size_t l = 1; l < count; ++l)
+	{
+		const Source& source = network.GetLayer(order[l]);
+		Layer& layer = layers[l];
+
+		layer.linkType = (LinkingType)source.GetInputLinkType();
+		layer.activation = source.GetActivation();
+		layer.residualLayer = source.GetResidualLayer() >= 0 ? frozen[source.GetResidualLayer()] : -1;
+		layer.size = source.GetSize();
+
+		layer.inputs.SetSize(source.GetInputLayerCount());
+		for (size_t i = 0; i < source.GetInputLayerCount(); ++i)
+		{
+			Input& input = layer.inputs[i];
+			input.layer = frozen[source.GetInputLayer(i)];
+			input.count = network.GetLayer(source.GetInputLayer(i)).GetSize();
+			input.offset = (size_t)(source.GetInputWeights(i) - source.GetWeights());
+
+			if (const uint32* rows = source.GetInputRows(i))
+			{
+				input.rows.SetSize(layer.size + 1);
+				for (size_t n = 0; n <= layer.size; ++n)
+					input.rows[n] = rows[n];
+
+				const uint32* columns = source.GetInputColumns(i);
+				input.columns.SetSize(rows[layer.size]);
+				for (size_t n = 0; n < rows[layer.size]; ++n)
+					input.columns[n] = columns[n];
+			}
+		}
+
+		const bool windowed = layer.inputs.GetSize() && (layer.linkType == LinkingType::CONV || layer.linkType == LinkingType::MAX_POOL || layer.linkType == LinkingType::AVG_POOL);
+		if (windowed)
+		{
+			const auto& shape = network.GetLayer(source.GetInputLayer()).GetShape();
+			const auto& window = source.GetWindow();
+			layer.inputShape = Shape(shape.width, shape.height, shape.channels);
+			layer.window = Window(window.size, window.stride, window.padding, window.channels);
+		}
+
+		layer.weights.SetSize(source.GetWeightCount());
+		for (size_t i = 0; i < source.GetWeightCount(); ++i)
+			layer.weights[i] = (T)source.GetWeights()[i];
+
+		if (windowed && layer.linkType == LinkingType::CONV)
+		{
+			//the epilogue adds biases per neuron
+			const size_t positions = layer.size / layer.window.channels;
+
+			layer.biases.SetSize(layer.size);
+			for (size_t c = 0; c < layer.window.channels; ++c)
+				for (size_t p = 0; p < positions; ++p)
+					layer.biases[c * positions + p] = (T)source.GetBiases()[c];
+		}
+		else if (!windowed)
+		{
+			layer.biases.SetSize(layer.size);
+			for (size_t n = 0; n < layer.size; ++n)
+				layer.biases[n] = (T)source.GetBiases()[n];
+		}
+	}
+
+	_layers = std::move(layers);
+	_softmaxOutput = network.GetCost() == LayeredNetworkT<U>::Cost::SOFTMAX_CROSS_ENTROPY;
+	return true;
+}
+
+template <typename T>
+bool FrozenNetworkT<T>::Read(ByteReader& reader)
+{
+	try
+	{
+		return Assign(LayeredNetworkT<T>(reader));
+	}
+	catch (int)
+	{
+		return false;
+	}
+}
+
+template <typename T>
+size_t FrozenNetworkT<T>::GetParameterBytes() const
+{
+	size_t bytes = 0;
+	for (const Layer& layer : _layers)
+	{
+		bytes += (layer.weights.GetSize() + layer.biases.GetSize()) * sizeof(T);
+
+		for (const Input& input : layer.inputs)
+			bytes += (input.rows.GetSize() + input.columns.GetSize()) * sizeof(uint32);
+	}
+
+	return bytes;
+}
+
+template <typename T>
+bool FrozenNetworkT<T>::Evaluate(Workspace& workspace, const T* inputs, size_t inputCount, T* outputs, size_t outputCount) const
+{
+	if (_layers.GetSize() == 0 || inputCount != GetInputSize() || outputCount != GetOutputSize())
+		return false;
+
+	EvaluateBatch(workspace, inputs, 1, outputs);
+	return true;
+}
+
+template <typename T>
+void FrozenNetworkT<T>::EvaluateBatch(Workspace& workspace, const T* inputs, size_t batch, T* outputs) const
+{
+	const size_t last = _layers.GetSize() - 1;
+
+	//the output layer writes straight into outputs, so it needs no buffer of its own
+	workspace._outputs.SetSize(_layers.GetSize());
+
+	size_t maxSize = 0;
+	for (size_t l = 1; l < _layers.GetSize(); ++l)
+	{
+		const Layer& layer = _layers[l];
+		maxSize = Maths::Max(maxSize, layer.size);
+
+		if (l != last && workspace._outputs[l].GetSize() < batch * layer.size)
+			workspace._outputs[l].SetSize(batch * layer.size);
+
+		if (layer.linkType == LinkingType::CONV && layer.inputs.GetSize())
+		{
+			const size_t columns = layer.window.size * layer.window.size * layer.inputShape.channels * (layer.size / layer.window.channels);
+			if (workspace._columns.GetSize() < columns)
+				workspace._columns.SetSize(columns);
+		}
+	}
+
+	if (workspace._z.GetSize() < batch * maxSize)
+		workspace._z.SetSize(batch * maxSize);
+
+	for (size_t l = 1; l < _layers.GetSize(); ++l)
+		_Forward(workspace, l, inputs, batch, l == last ? outputs : workspace._outputs[l].Data());
+}
+
+template <typename T>
+void FrozenNetworkT<T>::_Forward(Workspace& workspace, size_t index, const T* inputs, size_t batch, T* a) const
+{
+	const Layer& layer = _layers[index];
+	const bool pooling = layer.linkType == LinkingType::MAX_POOL || layer.linkType == LinkingType::AVG_POOL;
+
+	if (layer.inputs.GetSize() && pooling)
+	{
+		const Shape& in = layer.inputShape;
+		const T* x = _GetOutputs(workspace, layer.inputs[0].layer, inputs);
+
+		for (size_t b = 0; b < batch; ++b)
+			Kernels::Pool(layer.linkType == LinkingType::MAX_POOL, x + b * in.GetSize(), a + b * layer.size, in.width, in.height, in.channels, layer.window.size, layer.window.stride);
+	}
+	else
+	{
+		T* z = workspace._z.Data();
+
+		if (layer.inputs.GetSize() && layer.linkType == LinkingType::CONV)
+		{
+			//z[channels x positions] = W[channels x kernel size] * columns[kernel size x positions], one sample at a time
+			const Shape& in = layer.inputShape;
+			const Window& window = layer.window;
+			const T* x = _GetOutputs(workspace, layer.inputs[0].layer, inputs);
+
+			for (size_t b = 0; b < batch; ++b)
+			{
+				Kernels::Im2Col(x + b * in.GetSize(), workspace._columns.Data(), in.width, in.height, in.channels, window.size, window.stride, window.padding);
+				Kernels::MatMulAB(layer.weights.Data(), workspace._columns.Data(), z + b * layer.size, window.channels, layer.size / window.channels, window.size * window.size * in.channels);
+			}
+		}
+		else
+		{
+			//z = x * transpose(W) for every sample at once, one block per input
+			for (size_t i = 0; i < layer.inputs.GetSize(); ++i)
+			{
+				const Input& input = layer.inputs[i];
+				const T* x = _GetOutputs(workspace, input.layer, inputs);
+
+				if (input.rows.GetSize())
+					Kernels::SparseMatMulABt(x, input.rows.Data(), input.columns.Data(), layer.weights.Data() + input.offset, z, batch, layer.size, input.count, i > 0);
+				else
+					Kernels::MatMulABt(x, layer.weights.Data() + input.offset, z, batch, layer.size, input.count, i > 0);
+			}
+
+			if (layer.inputs.GetSize() == 0)
+				for (size_t i = 0; i < batch * layer.size; ++i)
+					z[i] = 0;
+		}
+
+		//bias + activation epilogue
+		if (index == _layers.GetSize() - 1 && _softmaxOutput)
+		{
+			for (size_t b = 0; b < batch; ++b)
+				Kernels::BiasSoftmax(z + b * layer.size, layer.biases.Data(), a + b * layer.size, layer.size);
+		}
+		else
+		{
+			for (size_t b = 0; b < batch; ++b)
+				Kernels::BiasActivate(layer.activation, z + b * layer.size, layer.biases.Data(), a + b * layer.size, layer.size);
+		}
+	}
+
+	if (layer.residualLayer >= 0)
+		Kernels::Axpy((T)1, _GetOutputs(workspace, layer.residualLayer, inputs), a, batch * layer.size);
+}
+
+template class FrozenNetworkT<double>;
+template class FrozenNetworkT<float>;
+
+template bool FrozenNetworkT<double>::Assign(const LayeredNetworkT<double>&);
+template bool FrozenNetworkT<double>::Assign(const LayeredNetworkT<float>&);
+template bool FrozenNetworkT<float>::Assign(const LayeredNetworkT<double>&);
+template bool FrozenNetworkT<float>::Assign(const LayeredNetworkT<float>&);
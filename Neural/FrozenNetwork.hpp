@@ -0,0 +1,111 @@
+#pragma once
+#include "Activation.hpp"
+#include "AlignedBuffer.hpp"
+#include "LayeredNetwork.hpp"
+#include <ELCore/Buffer.hpp>
+
+/*
+	Inference only copy of a trained LayeredNetwork that keeps nothing but its weights and biases
+	No cost PDs, optimizer state, errors or activations, and only the layers the output depends on
+
+	Parameters keep LayeredNetwork's flat layout: one row-major [neurons x inputs] block per input (CSR if it was pruned),
+	CONV layers one [channels x kernel size] block. Evaluation uses the same Kernels, so the outputs match LayeredNetwork's
+
+	Assign and Read are the only members that modify it. Evaluation writes to the caller's Workspace and nothing else,
+	so any number of threads can share one FrozenNetwork, each with its own workspace
+
+	Loading goes through LayeredNetwork, so it reads the same netfiles, which never allocates any training state
+
+	T is the scalar type, float or double (instantiated in FrozenNetwork.cpp), either can be assigned from either LayeredNetwork
+*/
+
+template <typename T>
+class FrozenNetworkT
+{
+public:
+	using LinkingType = typename LayeredNetworkT<T>::LinkingType;
+	using Shape = typename LayeredNetworkT<T>::Shape;
+	using Window = typename LayeredNetworkT<T>::Window;
+
+	//Scratch for one evaluation at a time, grown to the largest batch seen
+	class Workspace
+	{
+		friend FrozenNetworkT;
+
+		Buffer<AlignedBuffer<T>> _outputs;		//[batch x size] activations of each layer, the network inputs and outputs are the caller's
+		AlignedBuffer<T> _z;					//Weighted inputs of the layer being evaluated
+		AlignedBuffer<T> _columns;				//Im2Col of one sample, for CONV layers
+	};
+
+private:
+	struct Input
+	{
+		int layer;			//index into _layers
+		size_t count;
+		size_t offset;		//of this input's block in the layer's weights
+
+		//Empty for a dense block, otherwise the block's CSR row offsets and columns as in LayeredNetwork
+		AlignedBuffer<uint32> rows;
+		AlignedBuffer<uint32> columns;
+
+		Input() : layer(0), count(0), offset(0) {}
+	};
+
+	struct Layer
+	{
+		LinkingType linkType;
+		Activation activation;
+		Buffer<Input> inputs;
+		int residualLayer;			//index into _layers, -1 if none
+
+		size_t size;
+		Shape inputShape;			//CONV and pooling layers only
+		Window window;
+
+		AlignedBuffer<T> weights;
+		AlignedBuffer<T> biases;	//[size], CONV layers' per channel biases repeated over each plane, pooling layers none
+
+		Layer() : linkType(LinkingType::NONE), activation(Activation::SIGMOID), residualLayer(-1), size(0) {}
+	};
+
+	//[0] is the input layer (no parameters), then every layer the output depends on in evaluation order, the output layer last
+	Buffer<Layer> _layers;
+	bool _softmaxOutput;
+
+	//Writes the [batch x size] activations of _layers[index] into a
+	void _Forward(Workspace&, size_t index, const T* inputs, size_t batch, T* a) const;
+
+	const T* _GetOutputs(const Workspace& workspace, int layer, const T* inputs) const { return layer == 0 ? inputs : workspace._outputs[layer].Data(); }
+
+public:
+	FrozenNetworkT() : _softmaxOutput(false) {}
+
+	//Replaces this network with a copy of network's parameters, converted to T
+	//Returns false (leaving this network unchanged) if network has no output layer or its links form a cycle
+	template <typename U>
+	bool Assign(const LayeredNetworkT<U>& network);
+
+	//Reads a netfile written by LayeredNetwork::Write
+	//Returns false (leaving this network unchanged) if it is not a valid netfile
+	bool Read(ByteReader& reader);
+
+	size_t GetInputSize() const { return _layers.GetSize() ? _layers[0].size : 0; }
+	size_t GetOutputSize() const { return _layers.GetSize() ? _layers[_layers.GetSize() - 1].size : 0; }
+
+	//Bytes of weights, biases and sparse block indices
+	size_t GetParameterBytes() const;
+
+	//inputCount must equal input neuron count
+	//outputCount must equal output neuron count
+	bool Evaluate(
+		Workspace&,
+		const T* inputs, size_t inputCount,
+		T* outputs, size_t outputCount) const;
+
+	//inputs is a [batch x input neuron count] matrix, one sample per row
+	//outputs receives a [batch x output neuron count] matrix
+	void EvaluateBatch(Workspace&, const T* inputs, size_t batch, T* outputs) const;
+};
+
+using FrozenNetwork = FrozenNetworkT<double>;
+using FrozenNetworkF32 = FrozenNetworkT<float>;
@@ -0,0 +1,55 @@
+#include "IDXHeader.hpp"
+#include <ELMaths/Maths.hpp>
+#include <ELSys/Debug.hpp>
+
+namespace IDX
+{
+	bool ValidateImages(ImagesHeader& header, uint64 dataSize)
+	{
+		const uint64 imageSize = (uint64)header.width * header.height;
+
+		if (imageSize == 0 || imageSize > SIZE_MAX || header.count > Maths::Min(dataSize, (uint64)SIZE_MAX) / imageSize)
+		{
+			Debug::Error("Bad IDX3 file");
+			return false;
+		}
+
+		header.imageSize = (size_t)imageSize;
+		return true;
+	}
+
+	bool ParseImages(const byte* header, uint64 fileSize, ImagesHeader& images)
+	{
+		if (fileSize < IMAGES_HEADER_SIZE || ReadUint32(header) != IMAGES_MAGIC)
+		{
+			Debug::Error("IDX3 magic number incorrect!");
+			return false;
+		}
+
+		ImagesHeader parsed(ReadUint32(header + 4), ReadUint32(header + 8), ReadUint32(header + 12));
+		if (!ValidateImages(parsed, fileSize - IMAGES_HEADER_SIZE))
+			return false;
+
+		images = parsed;
+		return true;
+	}
+
+	bool ParseLabels(const byte* header, uint64 fileSize, uint32& count)
+	{
+		if (fileSize < LABELS_HEADER_SIZE || ReadUint32(header) != LABELS_MAGIC)
+		{
+			Debug::Error("IDX1 magic number incorrect!");
+			return false;
+		}
+
+		const uint32 labels = ReadUint32(header + 4);
+		if (fileSize - LABELS_HEADER_SIZE < labels)
+		{
+			Debug::Error("Bad IDX1 file");
+			return false;
+		}
+
+		count = labels;
+		return true;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <ELCore/Buffer.hpp>
+#include <cstdint>
+
+/*
+	Parsing and validation of IDX file headers, for every reader of IDX files
+
+	Headers are big endian uint32s: the magic number, the count, then for images their height and width
+	Every check is done without multiplying untrusted sizes together, so a crafted header cannot wrap past them
+*/
+
+namespace IDX
+{
+	constexpr size_t IMAGES_HEADER_SIZE = 4 * 4;
+	constexpr size_t LABELS_HEADER_SIZE = 2 * 4;
+
+	constexpr uint32 IMAGES_MAGIC = 2051;
+	constexpr uint32 LABELS_MAGIC = 2049;
+
+	struct ImagesHeader
+	{
+		uint32 count;
+		uint32 height;
+		uint32 width;
+		size_t imageSize;	//width x height, set by ValidateImages
+
+		ImagesHeader(uint32 count = 0, uint32 height = 0, uint32 width = 0) : count(count), height(height), width(width), imageSize(0) {}
+	};
+
+	inline uint32 ReadUint32(const byte* data) { return ((uint32)data[0] << 24) | ((uint32)data[1] << 16) | ((uint32)data[2] << 8) | (uint32)data[3]; }
+
+	//Sets header.imageSize, returns false (reporting why) if the images are empty, or count of them do not fit in dataSize bytes
+	//dataSize is what follows the header, SIZE_MAX if not known yet (which still checks they fit in memory)
+	bool ValidateImages(ImagesHeader& header, uint64 dataSize);
+
+	//header is the first fileSize bytes of an IDX3 file, or at least IMAGES_HEADER_SIZE of them
+	//Returns false (reporting why) unless it is an IDX3 header and the file holds every image
+	bool ParseImages(const byte* header, uint64 fileSize, ImagesHeader& images);
+
+	//As ParseImages, for an IDX1 file of labels
+	bool ParseLabels(const byte* header, uint64 fileSize, uint32& count);
+}
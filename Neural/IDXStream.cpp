@@ -0,0 +1,322 @@
+#include "IDXStream.hpp"
+#include "IDXHeader.hpp"
+#include <ELMaths/Maths.hpp>
+#include <ELSys/Debug.hpp>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool IDXStream::File::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	//chunks are read front to back, so the cache manager can read ahead within them and drop what is behind
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	_handle = (intptr_t)file;
+	_size = (uint64)size.QuadPart;
+#else
+	const int file = open(filename, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	_handle = file;
+	_size = (uint64)status.st_size;
+#endif
+
+	return true;
+}
+
+void IDXStream::File::Close()
+{
+	if (_handle == -1) return;
+
+#ifdef _WIN32
+	CloseHandle((HANDLE)_handle);
+#else
+	close((int)_handle);
+#endif
+
+	_handle = -1;
+	_size = 0;
+}
+
+bool IDXStream::File::Read(uint64 offset, void* data, size_t bytes) const
+{
+	if (_handle == -1 || offset + bytes > _size)
+		return false;
+
+	byte* destination = (byte*)data;
+
+	while (bytes)
+	{
+#ifdef _WIN32
+		//the offset of a synchronous read comes from the OVERLAPPED, the file pointer is never used
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD read = 0;
+		if (!ReadFile((HANDLE)_handle, destination, (DWORD)Maths::Min(bytes, (size_t)(1u << 30)), &read, &overlapped) || read == 0)
+			return false;
+#else
+		const ssize_t read = pread((int)_handle, destination, bytes, (off_t)offset);
+		if (read <= 0)
+			return false;
+#endif
+
+		destination += read;
+		offset += read;
+		bytes -= read;
+	}
+
+	return true;
+}
+
+void IDXStream::File::Drop(uint64 offset, size_t bytes) const
+{
+#ifdef _WIN32
+	//sequential scan handles already let go of pages behind the reads
+	(void)offset;
+	(void)bytes;
+#else
+	if (_handle != -1)
+		posix_fadvise((int)_handle, (off_t)offset, (off_t)bytes, POSIX_FADV_DONTNEED);
+#endif
+}
+
+IDXStream::IDXStream() :
+	_count(0), _width(0), _height(0), _imageSize(0), _chunkImages(0), _chunkCount(0),
+	_readRandom(0), _nextChunk(0), _epochsRead(0),
+	_random(0), _buffered(0), _epochLeft(0), _epochChunksLeft(0), _epochs(0), _epoch(0), _readAhead(0)
+{}
+
+bool IDXStream::Open(const char* imageFilename, const char* labelFilename, size_t chunkBytes, size_t bufferChunks, size_t readAheadChunks)
+{
+	Close();
+
+	byte header[IDX::IMAGES_HEADER_SIZE];
+	IDX::ImagesHeader images;
+	uint32 labelCount;
+
+	if (!_imageFile.Open(imageFilename) || !_imageFile.Read(0, header, IDX::IMAGES_HEADER_SIZE) || !IDX::ParseImages(header, _imageFile.GetSize(), images))
+	{
+		Debug::Error("Could not read IDX3 file");
+		Close();
+		return false;
+	}
+
+	if (!_labelFile.Open(labelFilename) || !_labelFile.Read(0, header, IDX::LABELS_HEADER_SIZE) || !IDX::ParseLabels(header, _labelFile.GetSize(), labelCount) || labelCount != images.count)
+	{
+		Debug::Error("Could not read IDX1 file, or its label count does not equal the image count");
+		Close();
+		return false;
+	}
+
+	_count = images.count;
+	_width = images.width;
+	_height = images.height;
+	_imageSize = images.imageSize;
+
+	_chunkImages = Maths::Max((size_t)1, chunkBytes / _imageSize);
+	_chunkCount = (_count + _chunkImages - 1) / _chunkImages;
+
+	//no more chunks than there are, so small sets are simply shuffled whole
+	bufferChunks = Maths::Max((size_t)1, Maths::Min(bufferChunks, _chunkCount));
+	_readAhead = Maths::Max((size_t)1, readAheadChunks);
+
+	_buffer.SetSize(bufferChunks);
+	for (size_t i = 0; i < bufferChunks; ++i)
+	{
+		Chunk& chunk = _buffer[i];
+		chunk.images.SetSize(_chunkImages * _imageSize);
+		chunk.labels.SetSize(_chunkImages);
+		chunk.order.SetSize(_chunkImages);
+		chunk.count = chunk.next = 0;
+	}
+
+	_chunkOrder.SetSize(_chunkCount);
+	_labelBytes.SetSize(_chunkImages);
+	return true;
+}
+
+void IDXStream::Close()
+{
+	_reader.Stop();
+
+	_imageFile.Close();
+	_labelFile.Close();
+
+	_count = _width = _height = 0;
+	_imageSize = _chunkImages = _chunkCount = 0;
+	_buffered = _epochLeft = _epochChunksLeft = 0;
+	_epochs = _epoch = 0;
+}
+
+void IDXStream::Start(int epochs, uint32 seed)
+{
+	_reader.Stop();
+
+	for (Chunk& chunk : _buffer)
+		chunk.count = chunk.next = 0;
+
+	_buffered = _epochLeft = _epochChunksLeft = 0;
+	_epochs = epochs;
+	_epoch = 0;
+
+	if (_count == 0 || epochs <= 0)
+		return;
+
+	_random = Random(seed);
+	_readRandom = Random(seed ^ 0x9E3779B9u);
+
+	for (size_t i = 0; i < _chunkCount; ++i)
+		_chunkOrder[i] = (uint32)i;
+
+	_nextChunk = 0;
+	_epochsRead = 0;
+
+	_reader.Start(_imageSize, _chunkImages, _readAhead, [this](byte* images, uint32* labels, size_t capacity) { return _ReadChunk(images, labels, capacity); });
+}
+
+size_t IDXStream::_ReadChunk(byte* images, uint32* labels, size_t capacity)
+{
+	if (_nextChunk == 0)
+	{
+		if (_epochsRead == _epochs)
+			return 0;
+
+		//Fisher-Yates over the chunks, a new order every epoch
+		for (size_t i = 0; i + 1 < _chunkCount; ++i)
+			Utilities::Swap(_chunkOrder[i], _chunkOrder[Maths::Min(i + (size_t)(_readRandom.NextDouble() * (double)(_chunkCount - i)), _chunkCount - 1)]);
+
+		++_epochsRead;
+	}
+
+	const size_t first = (size_t)_chunkOrder[_nextChunk] * _chunkImages;
+	const size_t count = Maths::Min(capacity, _count - first);
+
+	if (++_nextChunk == _chunkCount)
+		_nextChunk = 0;
+
+	const uint64 imageOffset = IDX::IMAGES_HEADER_SIZE + (uint64)first * _imageSize;
+	const uint64 labelOffset = IDX::LABELS_HEADER_SIZE + (uint64)first;
+
+	if (!_imageFile.Read(imageOffset, images, count * _imageSize) || !_labelFile.Read(labelOffset, _labelBytes.Data(), count))
+	{
+		Debug::Error("Could not read IDX chunk");
+		return 0;
+	}
+
+	//every chunk is read once per epoch, caching it would only push out something else
+	_imageFile.Drop(imageOffset, count * _imageSize);
+
+	for (size_t i = 0; i < count; ++i)
+		labels[i] = _labelBytes[i];
+
+	return count;
+}
+
+bool IDXStream::_Refill()
+{
+	for (Chunk& chunk : _buffer)
+	{
+		if (_epochChunksLeft == 0)
+			break;
+
+		if (chunk.next < chunk.count)
+			continue;
+
+		BatchPipeline<byte>::Batch read;
+		if (!_reader.Next(read))
+			return false;
+
+		std::memcpy(chunk.images.Data(), read.samples, read.count * _imageSize);
+		std::memcpy(chunk.labels.Data(), read.labels, read.count * sizeof(uint32));
+		_reader.Release();
+
+		chunk.count = read.count;
+		chunk.next = 0;
+		for (size_t i = 0; i < chunk.count; ++i)
+			chunk.order[i] = (uint32)i;
+
+		_buffered += chunk.count;
+		--_epochChunksLeft;
+	}
+
+	return true;
+}
+
+size_t IDXStream::Next(const byte** images, uint32* labels, size_t capacity)
+{
+	if (_epochLeft == 0)
+	{
+		if (_epoch == _epochs)
+			return 0;
+
+		_epochLeft = _count;
+		_epochChunksLeft = _chunkCount;
+		++_epoch;
+	}
+
+	//chunks emptied by the last call are only replaced now, its images stayed valid until this call
+	if (!_Refill())
+	{
+		_epochLeft = 0;
+		_epoch = _epochs;
+		return 0;
+	}
+
+	const size_t count = Maths::Min(capacity, Maths::Min(_epochLeft, _buffered));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		//a uniform pick from every buffered sample: a chunk by how many it has left, then a sample of it
+		size_t pick = Maths::Min((size_t)(_random.NextDouble() * (double)_buffered), _buffered - 1);
+
+		Chunk* chunk = _buffer.Data();
+		while (pick >= chunk->count - chunk->next)
+		{
+			pick -= chunk->count - chunk->next;
+			++chunk;
+		}
+
+		//Fisher-Yates step, the picked sample swaps to the front of what is left
+		Utilities::Swap(chunk->order[chunk->next], chunk->order[chunk->next + pick]);
+		const uint32 sample = chunk->order[chunk->next++];
+
+		images[i] = chunk->images.Data() + sample * _imageSize;
+		labels[i] = chunk->labels[sample];
+		--_buffered;
+	}
+
+	_epochLeft -= count;
+	return count;
+}
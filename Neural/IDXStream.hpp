@@ -0,0 +1,123 @@
+#pragma once
+#include "AlignedBuffer.hpp"
+#include "BatchPipeline.hpp"
+#include <ELCore/Buffer.hpp>
+#include <ELMaths/Random.hpp>
+#include <cstdint>
+
+/*
+	Out of core reader of an IDX3 image file and its IDX1 labels, for sets larger than memory
+
+	The files are read in fixed size chunks of whole images, each one long contiguous read, so the disk streams rather than seeks
+	A BatchPipeline reads chunks a few ahead on its own thread, in a new random chunk order every epoch
+
+	Samples come out of a bounded buffer of chunks: each is a uniform random pick from every sample buffered, and a chunk is
+	replaced by the next one read as soon as it has been emptied. Memory stays at (buffer + read ahead) chunks however big the files are,
+	and the randomness comes from both the chunk order and the mixing of many chunks in the buffer
+
+	A buffer holding every chunk gives a full shuffle
+*/
+
+class IDXStream
+{
+	//Positional reads from one file, with no seek state so reads may come from any thread
+	class File
+	{
+		intptr_t _handle;	//HANDLE or file descriptor, -1 if closed
+		uint64 _size;
+
+	public:
+		File() : _handle(-1), _size(0) {}
+		File(const File&) = delete;
+		~File() { Close(); }
+
+		File& operator=(const File&) = delete;
+
+		bool Open(const char* filename);
+		void Close();
+
+		uint64 GetSize() const { return _size; }
+
+		//Returns false unless all of [offset, offset + bytes) was read
+		bool Read(uint64 offset, void* data, size_t bytes) const;
+
+		//Hints that [offset, offset + bytes) will not be read again soon, so the OS need not keep it cached
+		void Drop(uint64 offset, size_t bytes) const;
+	};
+
+	struct Chunk
+	{
+		AlignedBuffer<byte> images;		//[count x image size]
+		AlignedBuffer<uint32> labels;
+		AlignedBuffer<uint32> order;	//of the samples not yet taken, from next on
+		size_t count;
+		size_t next;
+
+		Chunk() : count(0), next(0) {}
+	};
+
+	File _imageFile;
+	File _labelFile;
+
+	uint32 _count;
+	uint32 _width;
+	uint32 _height;
+	size_t _imageSize;
+
+	size_t _chunkImages;
+	size_t _chunkCount;
+
+	//Read on the reader's thread only
+	BatchPipeline<byte> _reader;
+	Random _readRandom;
+	Buffer<uint32> _chunkOrder;
+	Buffer<byte> _labelBytes;
+	size_t _nextChunk;
+	int _epochsRead;
+
+	//Taken from by Next
+	Buffer<Chunk> _buffer;
+	Random _random;
+	size_t _buffered;			//samples not yet taken from the buffer
+	size_t _epochLeft;			//samples of this epoch not yet taken
+	size_t _epochChunksLeft;	//chunks of this epoch not yet in the buffer
+	int _epochs;
+	int _epoch;
+
+	size_t _readAhead;
+
+	//Reader producer, reads the next chunk of the chunk order into images and labels
+	size_t _ReadChunk(byte* images, uint32* labels, size_t capacity);
+
+	//Refills every empty chunk with the next one read, while this epoch has any left
+	//Returns false if the reader stopped early
+	bool _Refill();
+
+public:
+	IDXStream();
+	~IDXStream() { Close(); }
+
+	IDXStream(const IDXStream&) = delete;
+	IDXStream& operator=(const IDXStream&) = delete;
+
+	//Opens the files and validates their headers, then allocates every buffer, nothing else is allocated afterwards
+	//chunkBytes is rounded down to whole images (at least one), bufferChunks are mixed, readAheadChunks are read in advance of those
+	//Returns false if either file cannot be read, is not valid or the two differ in count
+	bool Open(const char* imageFilename, const char* labelFilename, size_t chunkBytes, size_t bufferChunks, size_t readAheadChunks);
+	void Close();
+
+	//Starts reading epochs passes over the whole set, restarting any current pass
+	void Start(int epochs, uint32 seed);
+
+	//Points images (each [width x height]) and labels at up to capacity of the next samples, returns how many
+	//The images stay valid until the next call. A call never returns samples of two epochs, so a short count marks the end of one
+	//(or of what is buffered, if capacity exceeds that). Returns 0 once every epoch is done or if the files could not be read
+	size_t Next(const byte** images, uint32* labels, size_t capacity);
+
+	uint32 GetCount() const { return _count; }
+	uint32 GetWidth() const { return _width; }
+	uint32 GetHeight() const { return _height; }
+
+	//Memory used by the chunks, both buffered and read ahead
+	size_t GetBufferBytes() const { return (_buffer.GetSize() + _readAhead) * _chunkImages * (_imageSize + sizeof(uint32)); }
+};
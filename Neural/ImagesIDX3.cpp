@@ -1,22 +1,35 @@
 #include "ImagesIDX3.hpp"
+#include "IDXHeader.hpp"
 #include <ELCore/ByteReader.hpp>
 #include <ELCore/ByteWriter.hpp>
 #include <ELSys/Debug.hpp>
 
 bool ImagesIDX3::Read(ByteReader& reader)
 {
-	if (reader.Read_uint32() != 2051)
+	if (reader.Read_uint32() != IDX::IMAGES_MAGIC)
 	{
 		Debug::Error("IDX3 magic number incorrect!");
 		return false;
 	}
+
+	const uint32 count = reader.Read_uint32();
+	const uint32 height = reader.Read_uint32();
+	IDX::ImagesHeader header(count, height, reader.Read_uint32());
+
+	//the reader's size is only known as it runs out, so this only checks the images fit in memory
+	if (!IDX::ValidateImages(header, SIZE_MAX))
+		return false;
 	
-	_count = reader.Read_uint32();
-	_height = reader.Read_uint32();
-	_width = reader.Read_uint32();
-	_sz = _width * _height;
+	_file.Close();
+
+	_count = header.count;
+	_height = header.height;
+	_width = header.width;
+	_sz = header.imageSize;
+
+	_imageData.SetSize((size_t)_count * _sz);
+	_images = _imageData.Data();
 
-	_imageData.SetSize((size_t)_count * _width * _height);
 	if (reader.Read(_imageData.Data(), _imageData.GetSize()) != _imageData.GetSize())
 	{
 		Debug::Error("Bad IDX3 file");
@@ -26,6 +39,31 @@ bool ImagesIDX3::Read(ByteReader& reader)
 	return true;
 }
 
+bool ImagesIDX3::Map(const char* filename, MappedFile::Access access)
+{
+	MappedFile file;
+	if (!file.Open(filename, access))
+	{
+		Debug::Error("Could not map IDX3 file");
+		return false;
+	}
+
+	//checked once here, so GetImage can index without checking
+	IDX::ImagesHeader header;
+	if (!IDX::ParseImages(file.GetData(), file.GetSize(), header))
+		return false;
+
+	_count = header.count;
+	_height = header.height;
+	_width = header.width;
+	_sz = header.imageSize;
+
+	_imageData.Clear();
+	_file = std::move(file);
+	_images = _file.GetData() + IDX::IMAGES_HEADER_SIZE;
+	return true;
+}
+
 void ImagesIDX3::Write(ByteWriter& writer)
 {
 	writer.EnsureSpace((size_t)4 * 4 + (_count + _additionalCount) * _sz);
@@ -34,7 +72,7 @@ void ImagesIDX3::Write(ByteWriter& writer)
 	writer.Write_uint32(_height);
 	writer.Write_uint32(_width);
 
-	writer.Write(_imageData.Data(), _imageData.GetSize());
+	writer.Write(_images, (size_t)_count * _sz);
 
 	for (Buffer<byte>& data : _additionalImages)
 		writer.Write(data.Data(), data.GetSize());
@@ -1,25 +1,33 @@
 #pragma once
+#include "MappedFile.hpp"
 #include <ELCore/Buffer.hpp>
 #include <ELCore/List.hpp>
 
 class ImagesIDX3
 {
-	Buffer<byte> _imageData;
+	Buffer<byte> _imageData;		//Copied in by Read
+	MappedFile _file;				//Or served straight from the file by Map
+	const byte* _images;			//[_count x _sz], into one of the above
 
 	uint32 _count;
 	uint32 _width;
 	uint32 _height;
-	uint32 _sz;
+	size_t _sz;
 
 	List<Buffer<byte>> _additionalImages;
 	uint32 _additionalCount;
 
 public:
-	ImagesIDX3() : _count(0), _width(0), _height(0), _additionalCount(0) {}
+	ImagesIDX3() : _images(nullptr), _count(0), _width(0), _height(0), _sz(0), _additionalCount(0) {}
 
 	bool Read(class ByteReader&);
 	void Write(class ByteWriter&);
 
+	//Maps filename instead of reading it, GetImage then points into the mapping
+	//Nothing is copied and only the pages touched are ever read, access tells the OS in what order that will be
+	//The file must not be written while mapped
+	bool Map(const char* filename, MappedFile::Access access);
+
 	uint32 GetCount() const { return _count + _additionalCount; }
 	uint32 GetWidth() const { return _width; }
 	uint32 GetHeight() const { return _height; }
@@ -27,7 +35,7 @@ public:
 	const byte* GetImage(uint32 index) const
 	{
 		if (index < _count)
-			return &_imageData[(size_t)index * _sz];
+			return _images + (size_t)index * _sz;
 
 		index -= _count;
 		if (index < _additionalCount)
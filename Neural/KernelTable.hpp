@@ -0,0 +1,88 @@
+#pragma once
+#include "Activation.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/*
+	Innermost loops behind Kernels, one table per instruction set with a double and a float version of each
+	The blocked drivers in Kernels.cpp call through whichever table was selected at startup
+*/
+
+//exp(x) ~= 2^n * p(f), where x * log2(e) = n + f, n is an integer and |f| <= 0.5
+//p(f) = coefficients[0] + coefficients[1] * f + ... + coefficients[degree] * f^degree
+struct ExpPolynomial
+{
+	static constexpr int MAX_DEGREE = 13;
+
+	static constexpr double LOG2E = 1.4426950408889634;
+	static constexpr double ROUNDING_BIAS = 6755399441055744.0;	//1.5 * 2^52, adding and subtracting this rounds to the nearest integer
+	static constexpr float ROUNDING_BIAS_F32 = 12582912.0f;		//1.5 * 2^23, the same for floats
+	static constexpr double SIGMOID_RANGE = 40.0;				//Sigmoid is 0 or 1 to within 4.3e-18 beyond this, so inputs are clamped to it
+
+	//float kernels convert these as they load them
+	int degree;
+	double coefficients[MAX_DEGREE + 1];
+};
+
+template <typename T>
+struct KernelFunctions
+{
+	T (*dot)(const T* a, const T* b, size_t count);
+
+	//y += alpha * x
+	void (*axpy)(T alpha, const T* x, T* y, size_t count);
+
+	//c += a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]
+	void (*axpy4)(const T* a, const T* const* b, T* c, size_t count);
+
+	//sum of values[i] * x[indices[i]], the dot product of a sparse row with a dense vector
+	T (*sparseDot)(const T* values, const uint32_t* indices, const T* x, size_t count);
+
+	//y[i] += alpha * x[indices[i]]
+	void (*sparseAxpy)(T alpha, const T* x, const uint32_t* indices, T* y, size_t count);
+
+	//c[4 x 4] += a[4 x kc] * transpose(b[4 x kc])
+	//rows of a and b are k elements apart, rows of c are ldc elements apart
+	void (*tileABt4x4)(const T* a, const T* b, T* c, size_t ldc, size_t k, size_t kc);
+
+	//values -= factor * pdC, then pdC = 0
+	void (*applyGradient)(T* values, T* pdC, T factor, size_t count);
+
+	//The optimizer updates below scale the summed PDs to g = gradientScale * pdC, then zero pdC in the same pass
+
+	//velocity = momentum * velocity + g, values -= gradientRate * g + velocityRate * velocity
+	void (*applyMomentum)(T* values, T* pdC, T* velocity, T gradientScale, T momentum, T gradientRate, T velocityRate, size_t count);
+
+	//meanSquare = decay * meanSquare + (1 - decay) * g^2, values -= rate * g / (sqrt(meanSquare) + epsilon)
+	void (*applyRMSProp)(T* values, T* pdC, T* meanSquare, T gradientScale, T decay, T rate, T epsilon, size_t count);
+
+	//m = beta1 * m + (1 - beta1) * g, v = beta2 * v + (1 - beta2) * g^2, values -= rate * m / (sqrt(v) + epsilon)
+	void (*applyAdam)(T* values, T* pdC, T* firstMoment, T* secondMoment, T gradientScale, T beta1, T beta2, T rate, T epsilon, size_t count);
+
+	//z += bias, a = activation(z), indexed by Activation
+	//The scalar table ignores the polynomial and uses the exact exponential
+	void (*biasActivate[ACTIVATION_COUNT])(T* z, const T* bias, T* a, size_t count, const ExpPolynomial& exp);
+
+	//error *= activation'(z), in terms of the activation's output a, indexed by Activation
+	void (*mulActivationPrime[ACTIVATION_COUNT])(T* error, const T* a, size_t count);
+};
+
+struct KernelTable
+{
+	const char* name;
+
+	KernelFunctions<double> f64;
+	KernelFunctions<float> f32;
+
+	//y[rows] = a[rows x cols] * x[cols], int8 products accumulated in int32
+	void (*matVecInt8)(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols);
+
+	//Fraction of nonzero inputs below which the products through only the nonzeros beat the dense ones
+	//Measured: skipping zeros saves the scalar loops the most, the wider the vectors the less there is to gain
+	double sparseInputDensity;
+};
+
+extern const KernelTable kernelsScalar;
+extern const KernelTable kernelsSSE2;
+extern const KernelTable kernelsAVX2;
+extern const KernelTable kernelsAVX512;
@@ -0,0 +1,798 @@
+#include "Kernels.hpp"
+#include "KernelTable.hpp"
+#include <ELMaths/Maths.hpp>
+#include <cmath>
+#include <intrin.h>
+
+namespace
+{
+	//Block sizes chosen so that a BLOCK_N x BLOCK_K panel of b (128KB of doubles) sits in L2
+	//while every row of the matching a panel streams past it
+	constexpr size_t BLOCK_M = 64;
+	constexpr size_t BLOCK_N = 64;
+	constexpr size_t BLOCK_K = 256;
+
+	//For the AB/AtB forms rows of c are built up from scaled rows of b,
+	//so the b panel is short and wide instead
+	constexpr size_t ROW_BLOCK_K = 64;
+	constexpr size_t ROW_BLOCK_N = 256;
+
+	__forceinline size_t _Min(size_t a, size_t b) { return a < b ? a : b; }
+
+	template <typename T>
+	T _DotScalar(const T* a, const T* b, size_t count)
+	{
+		T sum = 0;
+		for (size_t i = 0; i < count; ++i)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	template <typename T>
+	void _AxpyScalar(T alpha, const T* x, T* y, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			y[i] += alpha * x[i];
+	}
+
+	template <typename T>
+	T _SparseDotScalar(const T* values, const uint32_t* indices, const T* x, size_t count)
+	{
+		T sum = 0;
+		for (size_t i = 0; i < count; ++i)
+			sum += values[i] * x[indices[i]];
+
+		return sum;
+	}
+
+	template <typename T>
+	void _SparseAxpyScalar(T alpha, const T* x, const uint32_t* indices, T* y, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			y[i] += alpha * x[indices[i]];
+	}
+
+	template <typename T>
+	void _Axpy4Scalar(const T* a, const T* const* b, T* c, size_t count)
+	{
+		const T a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+		const T* b0 = b[0];
+		const T* b1 = b[1];
+		const T* b2 = b[2];
+		const T* b3 = b[3];
+
+		for (size_t i = 0; i < count; ++i)
+			c[i] += a0 * b0[i] + a1 * b1[i] + a2 * b2[i] + a3 * b3[i];
+	}
+
+	//4 rows of a against 4 rows of b, 16 independent accumulators
+	template <typename T>
+	void _TileABt4x4Scalar(const T* a, const T* b, T* c, size_t ldc, size_t k, size_t kc)
+	{
+		T c00 = 0, c01 = 0, c02 = 0, c03 = 0;
+		T c10 = 0, c11 = 0, c12 = 0, c13 = 0;
+		T c20 = 0, c21 = 0, c22 = 0, c23 = 0;
+		T c30 = 0, c31 = 0, c32 = 0, c33 = 0;
+
+		const T* a0 = a;
+		const T* a1 = a + k;
+		const T* a2 = a + 2 * k;
+		const T* a3 = a + 3 * k;
+		const T* b0 = b;
+		const T* b1 = b + k;
+		const T* b2 = b + 2 * k;
+		const T* b3 = b + 3 * k;
+
+		for (size_t p = 0; p < kc; ++p)
+		{
+			const T va0 = a0[p], va1 = a1[p], va2 = a2[p], va3 = a3[p];
+			const T vb0 = b0[p], vb1 = b1[p], vb2 = b2[p], vb3 = b3[p];
+
+			c00 += va0 * vb0; c01 += va0 * vb1; c02 += va0 * vb2; c03 += va0 * vb3;
+			c10 += va1 * vb0; c11 += va1 * vb1; c12 += va1 * vb2; c13 += va1 * vb3;
+			c20 += va2 * vb0; c21 += va2 * vb1; c22 += va2 * vb2; c23 += va2 * vb3;
+			c30 += va3 * vb0; c31 += va3 * vb1; c32 += va3 * vb2; c33 += va3 * vb3;
+		}
+
+		c[0] += c00; c[1] += c01; c[2] += c02; c[3] += c03;
+		c += ldc;
+		c[0] += c10; c[1] += c11; c[2] += c12; c[3] += c13;
+		c += ldc;
+		c[0] += c20; c[1] += c21; c[2] += c22; c[3] += c23;
+		c += ldc;
+		c[0] += c30; c[1] += c31; c[2] += c32; c[3] += c33;
+	}
+
+	template <typename T>
+	void _ApplyGradientScalar(T* values, T* pdC, T factor, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			values[i] -= factor * pdC[i];
+			pdC[i] = 0;
+		}
+	}
+
+	template <typename T>
+	void _ApplyMomentumScalar(T* values, T* pdC, T* velocity, T gradientScale, T momentum, T gradientRate, T velocityRate, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const T g = gradientScale * pdC[i];
+			velocity[i] = momentum * velocity[i] + g;
+			values[i] -= gradientRate * g + velocityRate * velocity[i];
+			pdC[i] = 0;
+		}
+	}
+
+	template <typename T>
+	void _ApplyRMSPropScalar(T* values, T* pdC, T* meanSquare, T gradientScale, T decay, T rate, T epsilon, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const T g = gradientScale * pdC[i];
+			meanSquare[i] = decay * meanSquare[i] + (1 - decay) * g * g;
+			values[i] -= rate * g / (std::sqrt(meanSquare[i]) + epsilon);
+			pdC[i] = 0;
+		}
+	}
+
+	template <typename T>
+	void _ApplyAdamScalar(T* values, T* pdC, T* firstMoment, T* secondMoment, T gradientScale, T beta1, T beta2, T rate, T epsilon, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const T g = gradientScale * pdC[i];
+			firstMoment[i] = beta1 * firstMoment[i] + (1 - beta1) * g;
+			secondMoment[i] = beta2 * secondMoment[i] + (1 - beta2) * g * g;
+			values[i] -= rate * firstMoment[i] / (std::sqrt(secondMoment[i]) + epsilon);
+			pdC[i] = 0;
+		}
+	}
+
+	//Activation policies for the reference kernels, exp is always evaluated in double so that the float reference is as exact as it can be
+	//Prime is the derivative in terms of the activation's output a
+	struct _SigmoidActivation
+	{
+		template <typename T> static T Activate(T z) { return (T)(1.0 / (1.0 + Maths::Exp(-(double)z))); }
+		template <typename T> static T Prime(T a) { return a * (1 - a); }
+	};
+
+	struct _ReluActivation
+	{
+		template <typename T> static T Activate(T z) { return z > 0 ? z : 0; }
+		template <typename T> static T Prime(T a) { return a > 0 ? (T)1 : (T)0; }
+	};
+
+	struct _LeakyReluActivation
+	{
+		template <typename T> static T Activate(T z) { return z > 0 ? z : (T)LEAKY_RELU_SLOPE * z; }
+		template <typename T> static T Prime(T a) { return a > 0 ? (T)1 : (T)LEAKY_RELU_SLOPE; }
+	};
+
+	struct _TanhActivation
+	{
+		template <typename T> static T Activate(T z) { return (T)std::tanh((double)z); }
+		template <typename T> static T Prime(T a) { return 1 - a * a; }
+	};
+
+	template <typename T, typename ACTIVATION>
+	void _BiasActivateScalar(T* z, const T* bias, T* a, size_t count, const ExpPolynomial&)
+	{
+		for (size_t i = 0; i < count; ++i)
+			a[i] = ACTIVATION::Activate(z[i] += bias[i]);
+	}
+
+	template <typename T, typename ACTIVATION>
+	void _MulActivationPrimeScalar(T* error, const T* a, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			error[i] *= ACTIVATION::Prime(a[i]);
+	}
+
+	void _MatVecInt8Scalar(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+	{
+		for (size_t r = 0; r < rows; ++r)
+		{
+			const int8_t* row = a + r * cols;
+
+			int32_t sum = 0;
+			for (size_t i = 0; i < cols; ++i)
+				sum += (int32_t)row[i] * x[i];
+
+			y[r] = sum;
+		}
+	}
+
+	//Taylor series of 2^f = exp(f ln2), truncated at the lowest degree that meets maxError
+	//For |f| <= 0.5 the relative error of the truncated series is below (ln2 / 2)^(d + 1) / (d + 1)! * sqrt(2)
+	//and sigmoid's absolute error is at most a quarter of exp's relative error
+	//Rounding puts a floor on what is achievable, so the search also stops once it reaches minError
+	ExpPolynomial _CreateExpPolynomial(double maxError, double minError, double& errorBound)
+	{
+		const double ln2 = 0.6931471805599453;
+
+		ExpPolynomial poly;
+		poly.coefficients[0] = 1.0;
+
+		double term = 1.0;		//ln2^d / d!
+		double half = 0.5;		//0.5^(d + 1)
+		double bound = 1.0;
+		for (int degree = 1; degree <= ExpPolynomial::MAX_DEGREE; ++degree)
+		{
+			term *= ln2 / degree;
+			half *= 0.5;
+			poly.coefficients[degree] = term;
+			poly.degree = degree;
+
+			bound = term * ln2 / (degree + 1) * half * 1.4142135623730951 / 4.0;
+			if (bound <= maxError || bound <= minError) break;
+		}
+
+		errorBound = Maths::Max(bound, minError);
+		return poly;
+	}
+
+	Kernels::InstructionSet _DetectInstructionSet()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		if (maxLeaf < 1) return Kernels::InstructionSet::SCALAR;
+
+		__cpuid(info, 1);
+		const bool sse2 = (info[3] & (1 << 26)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+
+		if (!sse2) return Kernels::InstructionSet::SCALAR;
+		if (!(osxsave && avx && fma) || maxLeaf < 7) return Kernels::InstructionSet::SSE2;
+
+		//the OS has to save the wider registers on context switches too
+		const unsigned long long xcr0 = _xgetbv(0);
+		if ((xcr0 & 0x6) != 0x6) return Kernels::InstructionSet::SSE2;
+
+		__cpuidex(info, 7, 0);
+		const bool avx2 = (info[1] & (1 << 5)) != 0;
+		const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+		//KernelsAVX512.cpp is built with /arch:AVX512, which lets the compiler use DQ, BW and VL encodings anywhere in it
+		//(F only parts such as Xeon Phi would fault on those), so they are required too
+		const bool avx512dq = (info[1] & (1 << 17)) != 0;
+		const bool avx512bw = (info[1] & (1 << 30)) != 0;
+		const bool avx512vl = (info[1] & (1u << 31)) != 0;
+
+		if (!avx2) return Kernels::InstructionSet::SSE2;
+		if (avx512f && avx512dq && avx512bw && avx512vl && (xcr0 & 0xE6) == 0xE6) return Kernels::InstructionSet::AVX512;
+		return Kernels::InstructionSet::AVX2;
+	}
+
+	const KernelTable* _GetTable(Kernels::InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+		case Kernels::InstructionSet::SCALAR:
+			return &kernelsScalar;
+		case Kernels::InstructionSet::SSE2:
+			return &kernelsSSE2;
+		case Kernels::InstructionSet::AVX2:
+			return &kernelsAVX2;
+		case Kernels::InstructionSet::AVX512:
+			return &kernelsAVX512;
+		}
+
+		return &kernelsScalar;
+	}
+
+	const Kernels::InstructionSet _supportedInstructionSet = _DetectInstructionSet();
+	Kernels::InstructionSet _instructionSet = _supportedInstructionSet;
+	const KernelTable* _table = _GetTable(_supportedInstructionSet);
+
+	//Smallest sigmoid error each precision can actually deliver
+	constexpr double SIGMOID_MIN_ERROR_F64 = 4e-16;
+	constexpr double SIGMOID_MIN_ERROR_F32 = 2e-7;
+
+	double _sigmoidErrorBound = 0.0;
+	double _sigmoidErrorBoundF32 = 0.0;
+	ExpPolynomial _expPolynomial = _CreateExpPolynomial(1e-9, SIGMOID_MIN_ERROR_F64, _sigmoidErrorBound);
+	ExpPolynomial _expPolynomialF32 = _CreateExpPolynomial(1e-9, SIGMOID_MIN_ERROR_F32, _sigmoidErrorBoundF32);
+
+	template <typename T>
+	const KernelFunctions<T>& _Functions();
+
+	template <>
+	const KernelFunctions<double>& _Functions<double>() { return _table->f64; }
+
+	template <>
+	const KernelFunctions<float>& _Functions<float>() { return _table->f32; }
+
+	template <typename T>
+	const ExpPolynomial& _Exp();
+
+	template <>
+	const ExpPolynomial& _Exp<double>() { return _expPolynomial; }
+
+	template <>
+	const ExpPolynomial& _Exp<float>() { return _expPolynomialF32; }
+
+	//c[m x n] += a * b[k x n], where element (i, p) of a is a[i * aRowStride + p * aColStride]
+	//Each row of c is accumulated from 4 rows of b at a time, so c is loaded and stored once per 4 rows of b
+	template <typename T>
+	void _MatMulRows(const T* a, size_t aRowStride, size_t aColStride, const T* b, T* c, size_t m, size_t n, size_t k)
+	{
+		for (size_t kb = 0; kb < k; kb += ROW_BLOCK_K)
+		{
+			const size_t kEnd = _Min(kb + ROW_BLOCK_K, k);
+
+			for (size_t nb = 0; nb < n; nb += ROW_BLOCK_N)
+			{
+				const size_t nc = _Min(ROW_BLOCK_N, n - nb);
+
+				for (size_t i = 0; i < m; ++i)
+				{
+					const T* ai = a + i * aRowStride;
+					T* ci = c + i * n + nb;
+
+					size_t p = kb;
+					for (; p + 4 <= kEnd; p += 4)
+					{
+						const T as[4] = { ai[p * aColStride], ai[(p + 1) * aColStride], ai[(p + 2) * aColStride], ai[(p + 3) * aColStride] };
+						const T* bs[4] = { b + p * n + nb, b + (p + 1) * n + nb, b + (p + 2) * n + nb, b + (p + 3) * n + nb };
+
+						_Functions<T>().axpy4(as, bs, ci, nc);
+					}
+
+					for (; p < kEnd; ++p)
+						_Functions<T>().axpy(ai[p * aColStride], b + p * n + nb, ci, nc);
+				}
+			}
+		}
+	}
+}
+
+const KernelTable kernelsScalar =
+{
+	"Scalar",
+	{
+		_DotScalar<double>, _AxpyScalar<double>, _Axpy4Scalar<double>, _SparseDotScalar<double>, _SparseAxpyScalar<double>, _TileABt4x4Scalar<double>,
+		_ApplyGradientScalar<double>, _ApplyMomentumScalar<double>, _ApplyRMSPropScalar<double>, _ApplyAdamScalar<double>,
+		{ _BiasActivateScalar<double, _SigmoidActivation>, _BiasActivateScalar<double, _ReluActivation>, _BiasActivateScalar<double, _LeakyReluActivation>, _BiasActivateScalar<double, _TanhActivation> },
+		{ _MulActivationPrimeScalar<double, _SigmoidActivation>, _MulActivationPrimeScalar<double, _ReluActivation>, _MulActivationPrimeScalar<double, _LeakyReluActivation>, _MulActivationPrimeScalar<double, _TanhActivation> }
+	},
+	{
+		_DotScalar<float>, _AxpyScalar<float>, _Axpy4Scalar<float>, _SparseDotScalar<float>, _SparseAxpyScalar<float>, _TileABt4x4Scalar<float>,
+		_ApplyGradientScalar<float>, _ApplyMomentumScalar<float>, _ApplyRMSPropScalar<float>, _ApplyAdamScalar<float>,
+		{ _BiasActivateScalar<float, _SigmoidActivation>, _BiasActivateScalar<float, _ReluActivation>, _BiasActivateScalar<float, _LeakyReluActivation>, _BiasActivateScalar<float, _TanhActivation> },
+		{ _MulActivationPrimeScalar<float, _SigmoidActivation>, _MulActivationPrimeScalar<float, _ReluActivation>, _MulActivationPrimeScalar<float, _LeakyReluActivation>, _MulActivationPrimeScalar<float, _TanhActivation> }
+	},
+	_MatVecInt8Scalar,
+	0.25
+};
+
+Kernels::InstructionSet Kernels::GetSupportedInstructionSet()
+{
+	return _supportedInstructionSet;
+}
+
+Kernels::InstructionSet Kernels::GetInstructionSet()
+{
+	return _instructionSet;
+}
+
+bool Kernels::SetInstructionSet(InstructionSet instructionSet)
+{
+	if ((int)instructionSet > (int)_supportedInstructionSet)
+		return false;
+
+	_instructionSet = instructionSet;
+	_table = _GetTable(instructionSet);
+	return true;
+}
+
+const char* Kernels::GetInstructionSetName(InstructionSet instructionSet)
+{
+	return _GetTable(instructionSet)->name;
+}
+
+void Kernels::SetSigmoidMaxError(double maxError)
+{
+	_expPolynomial = _CreateExpPolynomial(maxError, SIGMOID_MIN_ERROR_F64, _sigmoidErrorBound);
+	_expPolynomialF32 = _CreateExpPolynomial(maxError, SIGMOID_MIN_ERROR_F32, _sigmoidErrorBoundF32);
+}
+
+template <typename T>
+double Kernels::GetSigmoidMaxError()
+{
+	return sizeof(T) == sizeof(float) ? _sigmoidErrorBoundF32 : _sigmoidErrorBound;
+}
+
+template <typename T>
+int Kernels::GetSigmoidDegree()
+{
+	return _Exp<T>().degree;
+}
+
+double Kernels::GetSparseInputDensity()
+{
+	return _table->sparseInputDensity;
+}
+
+void Kernels::MatVecInt8(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+{
+	_table->matVecInt8(a, x, y, rows, cols);
+}
+
+template <typename T>
+T Kernels::Dot(const T* a, const T* b, size_t count)
+{
+	return _Functions<T>().dot(a, b, count);
+}
+
+template <typename T>
+void Kernels::Axpy(T alpha, const T* x, T* y, size_t count)
+{
+	_Functions<T>().axpy(alpha, x, y, count);
+}
+
+template <typename T>
+void Kernels::ApplyGradient(T* values, T* pdC, T factor, size_t count)
+{
+	_Functions<T>().applyGradient(values, pdC, factor, count);
+}
+
+template <typename T>
+void Kernels::ApplyMomentum(T* values, T* pdC, T* velocity, T gradientScale, T momentum, T gradientRate, T velocityRate, size_t count)
+{
+	_Functions<T>().applyMomentum(values, pdC, velocity, gradientScale, momentum, gradientRate, velocityRate, count);
+}
+
+template <typename T>
+void Kernels::ApplyRMSProp(T* values, T* pdC, T* meanSquare, T gradientScale, T decay, T rate, T epsilon, size_t count)
+{
+	_Functions<T>().applyRMSProp(values, pdC, meanSquare, gradientScale, decay, rate, epsilon, count);
+}
+
+template <typename T>
+void Kernels::ApplyAdam(T* values, T* pdC, T* firstMoment, T* secondMoment, T gradientScale, T beta1, T beta2, T rate, T epsilon, size_t count)
+{
+	_Functions<T>().applyAdam(values, pdC, firstMoment, secondMoment, gradientScale, beta1, beta2, rate, epsilon, count);
+}
+
+template <typename T>
+void Kernels::BiasActivate(Activation activation, T* z, const T* bias, T* a, size_t count)
+{
+	_Functions<T>().biasActivate[(size_t)activation](z, bias, a, count, _Exp<T>());
+}
+
+template <typename T>
+void Kernels::BiasSoftmax(T* z, const T* bias, T* a, size_t count)
+{
+	if (count == 0) return;
+
+	T max = z[0] += bias[0];
+	for (size_t i = 1; i < count; ++i)
+		max = Maths::Max(max, z[i] += bias[i]);
+
+	//the largest term is exp(0) = 1, so the sum is never 0
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i)
+		sum += a[i] = (T)Maths::Exp((double)(z[i] - max));
+
+	const T scale = (T)(1.0 / sum);
+	for (size_t i = 0; i < count; ++i)
+		a[i] *= scale;
+}
+
+template <typename T>
+void Kernels::MulActivationPrime(Activation activation, T* error, const T* a, size_t count)
+{
+	_Functions<T>().mulActivationPrime[(size_t)activation](error, a, count);
+}
+
+template <typename T>
+void Kernels::MatMulABt(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	const KernelFunctions<T>& functions = _Functions<T>();
+
+	for (size_t kb = 0; kb < k; kb += BLOCK_K)
+	{
+		const size_t kc = _Min(BLOCK_K, k - kb);
+
+		for (size_t nb = 0; nb < n; nb += BLOCK_N)
+		{
+			const size_t nEnd = _Min(nb + BLOCK_N, n);
+
+			for (size_t mb = 0; mb < m; mb += BLOCK_M)
+			{
+				const size_t mEnd = _Min(mb + BLOCK_M, m);
+
+				size_t i = mb;
+				for (; i + 4 <= mEnd; i += 4)
+				{
+					size_t j = nb;
+					for (; j + 4 <= nEnd; j += 4)
+						functions.tileABt4x4(a + i * k + kb, b + j * k + kb, c + i * n + j, n, k, kc);
+
+					for (; j < nEnd; ++j)
+						for (size_t r = i; r < i + 4; ++r)
+							c[r * n + j] += functions.dot(a + r * k + kb, b + j * k + kb, kc);
+				}
+
+				for (; i < mEnd; ++i)
+					for (size_t j = nb; j < nEnd; ++j)
+						c[i * n + j] += functions.dot(a + i * k + kb, b + j * k + kb, kc);
+			}
+		}
+	}
+}
+
+template <typename T>
+void Kernels::MatMulAB(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	_MatMulRows(a, k, 1, b, c, m, n, k);
+}
+
+template <typename T>
+void Kernels::MatMulAtB(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	_MatMulRows(a, 1, m, b, c, m, n, k);
+}
+
+template <typename T>
+void Kernels::AddColumnSums(const T* a, T* sums, size_t m, size_t n)
+{
+	const KernelFunctions<T>& functions = _Functions<T>();
+
+	for (size_t i = 0; i < m; ++i)
+		functions.axpy(1, a + i * n, sums, n);
+}
+
+template <typename T>
+void Kernels::SparseAxpy(T alpha, const T* x, const uint32_t* indices, T* y, size_t count)
+{
+	_Functions<T>().sparseAxpy(alpha, x, indices, y, count);
+}
+
+template <typename T>
+void Kernels::SparseMatMulABt(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	const KernelFunctions<T>& functions = _Functions<T>();
+
+	//one sparse row against every sample before moving on, so its values and indices stay in cache
+	for (size_t r = 0; r < n; ++r)
+	{
+		const size_t begin = rows[r];
+		const size_t count = rows[r + 1] - begin;
+		if (count == 0) continue;
+
+		for (size_t i = 0; i < m; ++i)
+			c[i * n + r] += functions.sparseDot(values + begin, columns + begin, a + i * k, count);
+	}
+}
+
+template <typename T>
+void Kernels::SparseMatMulAB(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	//scatters each row of W, scaled by a, into the row of c
+	for (size_t i = 0; i < m; ++i)
+	{
+		T* ci = c + i * n;
+
+		for (size_t r = 0; r < k; ++r)
+		{
+			const T scale = a[i * k + r];
+			if (scale == 0) continue;
+
+			for (size_t j = rows[r]; j < rows[r + 1]; ++j)
+				ci[columns[j]] += scale * values[j];
+		}
+	}
+}
+
+template <typename T>
+void Kernels::SparseAddAtB(const T* a, const T* b, const uint32_t* rows, const uint32_t* columns, T* values, size_t m, size_t n, size_t k)
+{
+	const KernelFunctions<T>& functions = _Functions<T>();
+
+	for (size_t r = 0; r < m; ++r)
+	{
+		const size_t begin = rows[r];
+		const size_t count = rows[r + 1] - begin;
+		if (count == 0) continue;
+
+		for (size_t i = 0; i < k; ++i)
+			functions.sparseAxpy(a[i * m + r], b + i * n, columns + begin, values + begin, count);
+	}
+}
+
+template <typename T>
+void Kernels::SparseAMatMulABt(const uint32_t* rows, const uint32_t* columns, const T* values, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate)
+{
+	if (!accumulate)
+		for (size_t i = 0; i < m * n; ++i)
+			c[i] = 0;
+
+	const KernelFunctions<T>& functions = _Functions<T>();
+
+	//each element of c gathers the columns of a row of b under the nonzeros of a row of A
+	for (size_t i = 0; i < m; ++i)
+	{
+		const size_t begin = rows[i];
+		const size_t count = rows[i + 1] - begin;
+		if (count == 0) continue;
+
+		for (size_t j = 0; j < n; ++j)
+			c[i * n + j] += functions.sparseDot(values + begin, columns + begin, b + j * k, count);
+	}
+}
+
+template <typename T>
+void Kernels::SparseBAddAtB(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k)
+{
+	//row i of B scaled by each element of row i of a, scattered into the rows of c
+	for (size_t i = 0; i < k; ++i)
+	{
+		const size_t begin = rows[i];
+		const size_t end = rows[i + 1];
+
+		for (size_t r = 0; r < m; ++r)
+		{
+			const T scale = a[i * m + r];
+			if (scale == 0) continue;
+
+			T* cr = c + r * n;
+			for (size_t j = begin; j < end; ++j)
+				cr[columns[j]] += scale * values[j];
+		}
+	}
+}
+
+template <typename T>
+void Kernels::Im2Col(const T* image, T* columns, size_t width, size_t height, size_t channels, size_t size, size_t stride, size_t padding)
+{
+	const size_t outWidth = (width + 2 * padding - size) / stride + 1;
+	const size_t outHeight = (height + 2 * padding - size) / stride + 1;
+
+	for (size_t c = 0; c < channels; ++c)
+		for (size_t ky = 0; ky < size; ++ky)
+			for (size_t kx = 0; kx < size; ++kx)
+			{
+				const T* plane = image + c * width * height;
+
+				for (size_t oy = 0; oy < outHeight; ++oy)
+				{
+					//unsigned, so rows and columns in the padding wrap around to huge values
+					const size_t y = oy * stride + ky - padding;
+
+					if (y >= height)
+					{
+						for (size_t ox = 0; ox < outWidth; ++ox)
+							*columns++ = 0;
+
+						continue;
+					}
+
+					const T* row = plane + y * width;
+					for (size_t ox = 0; ox < outWidth; ++ox)
+					{
+						const size_t x = ox * stride + kx - padding;
+						*columns++ = x < width ? row[x] : (T)0;
+					}
+				}
+			}
+}
+
+template <typename T>
+void Kernels::Col2Im(const T* columns, T* image, size_t width, size_t height, size_t channels, size_t size, size_t stride, size_t padding)
+{
+	const size_t outWidth = (width + 2 * padding - size) / stride + 1;
+	const size_t outHeight = (height + 2 * padding - size) / stride + 1;
+
+	for (size_t c = 0; c < channels; ++c)
+		for (size_t ky = 0; ky < size; ++ky)
+			for (size_t kx = 0; kx < size; ++kx)
+			{
+				T* plane = image + c * width * height;
+
+				for (size_t oy = 0; oy < outHeight; ++oy)
+				{
+					const size_t y = oy * stride + ky - padding;
+
+					if (y >= height)
+					{
+						columns += outWidth;
+						continue;
+					}
+
+					T* row = plane + y * width;
+					for (size_t ox = 0; ox < outWidth; ++ox, ++columns)
+					{
+						const size_t x = ox * stride + kx - padding;
+						if (x < width) row[x] += *columns;
+					}
+				}
+			}
+}
+
+template <typename T>
+void Kernels::Pool(bool max, const T* image, T* pooled, size_t width, size_t height, size_t channels, size_t size, size_t stride)
+{
+	const size_t outWidth = (width - size) / stride + 1;
+	const size_t outHeight = (height - size) / stride + 1;
+	const T invArea = (T)1 / (T)(size * size);
+
+	for (size_t c = 0; c < channels; ++c)
+	{
+		const T* plane = image + c * width * height;
+
+		for (size_t oy = 0; oy < outHeight; ++oy)
+			for (size_t ox = 0; ox < outWidth; ++ox)
+			{
+				const T* corner = plane + oy * stride * width + ox * stride;
+
+				T value = max ? corner[0] : (T)0;
+				for (size_t ky = 0; ky < size; ++ky)
+					for (size_t kx = 0; kx < size; ++kx)
+					{
+						if (max)
+							value = Maths::Max(value, corner[ky * width + kx]);
+						else
+							value += corner[ky * width + kx];
+					}
+
+				*pooled++ = max ? value : value * invArea;
+			}
+	}
+}
+
+#define INSTANTIATE_KERNELS(T) \
+	template double Kernels::GetSigmoidMaxError<T>(); \
+	template int Kernels::GetSigmoidDegree<T>(); \
+	template T Kernels::Dot(const T*, const T*, size_t); \
+	template void Kernels::Axpy(T, const T*, T*, size_t); \
+	template void Kernels::ApplyGradient(T*, T*, T, size_t); \
+	template void Kernels::ApplyMomentum(T*, T*, T*, T, T, T, T, size_t); \
+	template void Kernels::ApplyRMSProp(T*, T*, T*, T, T, T, T, size_t); \
+	template void Kernels::ApplyAdam(T*, T*, T*, T*, T, T, T, T, T, size_t); \
+	template void Kernels::BiasActivate(Activation, T*, const T*, T*, size_t); \
+	template void Kernels::BiasSoftmax(T*, const T*, T*, size_t); \
+	template void Kernels::MulActivationPrime(Activation, T*, const T*, size_t); \
+	template void Kernels::MatMulABt(const T*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::MatMulAB(const T*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::MatMulAtB(const T*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::AddColumnSums(const T*, T*, size_t, size_t); \
+	template void Kernels::SparseAxpy(T, const T*, const uint32_t*, T*, size_t); \
+	template void Kernels::SparseMatMulABt(const T*, const uint32_t*, const uint32_t*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::SparseMatMulAB(const T*, const uint32_t*, const uint32_t*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::SparseAddAtB(const T*, const T*, const uint32_t*, const uint32_t*, T*, size_t, size_t, size_t); \
+	template void Kernels::SparseAMatMulABt(const uint32_t*, const uint32_t*, const T*, const T*, T*, size_t, size_t, size_t, bool); \
+	template void Kernels::SparseBAddAtB(const T*, const uint32_t*, const uint32_t*, const T*, T*, size_t, size_t, size_t); \
+	template void Kernels::Im2Col(const T*, T*, size_t, size_t, size_t, size_t, size_t, size_t); \
+	template void Kernels::Col2Im(const T*, T*, size_t, size_t, size_t, size_t, size_t, size_t); \
+	template void Kernels::Pool(bool, const T*, T*, size_t, size_t, size_t, size_t, size_t);
+
+INSTANTIATE_KERNELS(double)
+INSTANTIATE_KERNELS(float)
@@ -0,0 +1,152 @@
+#pragma once
+#include "Activation.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/*
+	Dense linear algebra used by LayeredNetwork
+
+	All matrices are row-major and tightly packed (row stride == column count)
+	Products are cache blocked so that a panel of each operand stays resident while it is reused
+
+	The inner loops are picked at startup from the best instruction set the CPU supports (see KernelTable)
+*/
+
+namespace Kernels
+{
+	enum class InstructionSet
+	{
+		SCALAR = 0,
+		SSE2 = 1,
+		AVX2 = 2,	//Also requires FMA
+		AVX512 = 3	//AVX-512F + DQ, BW and VL (the /arch:AVX512 baseline)
+	};
+
+	InstructionSet GetSupportedInstructionSet();
+	InstructionSet GetInstructionSet();
+
+	//Forces a lower instruction set, eg. SCALAR to check results against the reference loops
+	//Returns false if the CPU does not support the requested set
+	//Not thread safe, must not be called while any kernel is running
+	bool SetInstructionSet(InstructionSet);
+
+	const char* GetInstructionSetName(InstructionSet);
+
+	//The vectorised sigmoid evaluates exp as a polynomial, this picks the cheapest one whose absolute error is within maxError
+	//The default is 1e-9, float kernels stop at the error their own rounding allows. The scalar reference kernels always use the exact exponential
+	//Tanh is evaluated as 2 * sigmoid(2z) - 1, so its error is twice this
+	//Not thread safe, must not be called while any kernel is running
+	void SetSigmoidMaxError(double maxError);
+
+	//Worst case absolute error of the current sigmoid approximation
+	template <typename T> double GetSigmoidMaxError();
+	template <typename T> int GetSigmoidDegree();
+
+	//Inputs with at most this fraction nonzero are cheaper to multiply with SparseAMatMulABt / SparseBAddAtB than densely
+	double GetSparseInputDensity();
+
+	//y[rows] = a[rows x cols] * x[cols], int8 products accumulated in int32
+	void MatVecInt8(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols);
+
+	//Everything below is instantiated for float and double
+
+	template <typename T>
+	T Dot(const T* a, const T* b, size_t count);
+
+	//y += alpha * x
+	template <typename T>
+	void Axpy(T alpha, const T* x, T* y, size_t count);
+
+	//values -= factor * pdC, then pdC = 0
+	template <typename T>
+	void ApplyGradient(T* values, T* pdC, T factor, size_t count);
+
+	//Optimizer updates, each one pass over the parameters that also zeroes pdC
+	//The summed PDs are first scaled to g = gradientScale * pdC (1 / sample count for the mean gradient)
+
+	//velocity = momentum * velocity + g, values -= gradientRate * g + velocityRate * velocity
+	//Classical momentum is gradientRate = 0, velocityRate = learning rate
+	//Nesterov momentum is gradientRate = learning rate, velocityRate = learning rate * momentum
+	template <typename T>
+	void ApplyMomentum(T* values, T* pdC, T* velocity, T gradientScale, T momentum, T gradientRate, T velocityRate, size_t count);
+
+	//meanSquare = decay * meanSquare + (1 - decay) * g^2, values -= rate * g / (sqrt(meanSquare) + epsilon)
+	template <typename T>
+	void ApplyRMSProp(T* values, T* pdC, T* meanSquare, T gradientScale, T decay, T rate, T epsilon, size_t count);
+
+	//m = beta1 * m + (1 - beta1) * g, v = beta2 * v + (1 - beta2) * g^2, values -= rate * m / (sqrt(v) + epsilon)
+	//Bias correction is left to the caller, folded into rate
+	template <typename T>
+	void ApplyAdam(T* values, T* pdC, T* firstMoment, T* secondMoment, T gradientScale, T beta1, T beta2, T rate, T epsilon, size_t count);
+
+	//z += bias, a = activation(z)
+	template <typename T>
+	void BiasActivate(Activation, T* z, const T* bias, T* a, size_t count);
+
+	//z += bias, a = softmax(z)
+	//Shifted by the largest z so exp cannot overflow. Not vectorised, output layers are only a few neurons wide
+	template <typename T>
+	void BiasSoftmax(T* z, const T* bias, T* a, size_t count);
+
+	//error *= activation'(z), computed from the stored output a (eg. a * (1 - a) for the sigmoid)
+	template <typename T>
+	void MulActivationPrime(Activation, T* error, const T* a, size_t count);
+
+	//c[m x n] = a[m x k] * transpose(b[n x k])
+	//If accumulate is true the product is added to c instead of overwriting it
+	template <typename T>
+	void MatMulABt(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//c[m x n] = a[m x k] * b[k x n]
+	template <typename T>
+	void MatMulAB(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//c[m x n] = transpose(a[k x m]) * b[k x n]
+	template <typename T>
+	void MatMulAtB(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//sums[n] += column sums of a[m x n]
+	template <typename T>
+	void AddColumnSums(const T* a, T* sums, size_t m, size_t n);
+
+	//Sparse weight matrices are stored as CSR: row r's nonzeros are values[rows[r], rows[r + 1]) in columns[rows[r], rows[r + 1])
+
+	//y[i] += alpha * x[indices[i]], the gathered form of Axpy
+	template <typename T>
+	void SparseAxpy(T alpha, const T* x, const uint32_t* indices, T* y, size_t count);
+
+	//c[m x n] = a[m x k] * transpose(W), W is an [n x k] CSR matrix
+	template <typename T>
+	void SparseMatMulABt(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//c[m x n] = a[m x k] * W, W is a [k x n] CSR matrix
+	template <typename T>
+	void SparseMatMulAB(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//W += transpose(a[k x m]) * b[k x n], only at the nonzeros of the [m x n] CSR matrix W, which keep their positions
+	template <typename T>
+	void SparseAddAtB(const T* a, const T* b, const uint32_t* rows, const uint32_t* columns, T* values, size_t m, size_t n, size_t k);
+
+	//c[m x n] = A * transpose(b[n x k]), A is an [m x k] CSR matrix
+	template <typename T>
+	void SparseAMatMulABt(const uint32_t* rows, const uint32_t* columns, const T* values, const T* b, T* c, size_t m, size_t n, size_t k, bool accumulate = false);
+
+	//c[m x n] += transpose(a[k x m]) * B, B is a [k x n] CSR matrix. Only the columns of c under B's nonzeros are touched
+	template <typename T>
+	void SparseBAddAtB(const T* a, const uint32_t* rows, const uint32_t* columns, const T* values, T* c, size_t m, size_t n, size_t k);
+
+	//Convolution lowering, so that a convolution is one MatMulAB of the [channels out x kernel] weights with the columns
+	//image is [channels x height x width], columns is [(channels * size * size) x (outHeight * outWidth)]
+	//Row (c, ky, kx) of columns holds the pixel under kernel element (ky, kx) of plane c at every output position, 0 in the padding
+	template <typename T>
+	void Im2Col(const T* image, T* columns, size_t width, size_t height, size_t channels, size_t size, size_t stride, size_t padding);
+
+	//The reverse of Im2Col for backpropagation, each column element is added back onto the pixel it was taken from
+	template <typename T>
+	void Col2Im(const T* columns, T* image, size_t width, size_t height, size_t channels, size_t size, size_t stride, size_t padding);
+
+	//Downsamples each plane of image ([channels x height x width]) into pooled ([channels x outHeight x outWidth], no padding)
+	//Each output is the largest value of its size x size window if max is set, otherwise their mean
+	template <typename T>
+	void Pool(bool max, const T* image, T* pooled, size_t width, size_t height, size_t channels, size_t size, size_t stride);
+}
@@ -0,0 +1,791 @@
+#include "KernelTable.hpp"
+#include <cmath>
+#include <immintrin.h>
+
+/*
+	AVX2 + FMA, 4 doubles or 8 floats per register
+	Built with /arch:AVX2, only ever called once CPUID has confirmed support
+*/
+
+namespace
+{
+	//{ sum(v0), sum(v1), sum(v2), sum(v3) }
+	__forceinline __m256d _Reduce4(__m256d v0, __m256d v1, __m256d v2, __m256d v3)
+	{
+		const __m256d s01 = _mm256_hadd_pd(v0, v1);
+		const __m256d s23 = _mm256_hadd_pd(v2, v3);
+		return _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20), _mm256_permute2f128_pd(s01, s23, 0x31));
+	}
+
+	//1 / (1 + exp(-z)), with exp done as a scaled polynomial
+	__forceinline __m256d _Sigmoid(__m256d z, const ExpPolynomial& exp)
+	{
+		const __m256d range = _mm256_set1_pd(ExpPolynomial::SIGMOID_RANGE);
+		const __m256d bias = _mm256_set1_pd(ExpPolynomial::ROUNDING_BIAS);
+		const __m256d one = _mm256_set1_pd(1.0);
+
+		const __m256d x = _mm256_min_pd(_mm256_max_pd(z, _mm256_sub_pd(_mm256_setzero_pd(), range)), range);
+		const __m256d v = _mm256_mul_pd(x, _mm256_set1_pd(-ExpPolynomial::LOG2E));
+		const __m256d rounded = _mm256_add_pd(v, bias);
+		const __m256d f = _mm256_sub_pd(v, _mm256_sub_pd(rounded, bias));
+
+		__m256d p = _mm256_set1_pd(exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(exp.coefficients[i]));
+
+		//the integer part sits in the low mantissa bits of rounded, build 2^n directly from it
+		const __m256i n = _mm256_sub_epi64(_mm256_castpd_si256(rounded), _mm256_castpd_si256(bias));
+		const __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(n, _mm256_set1_epi64x(1023)), 52));
+
+		return _mm256_div_pd(one, _mm256_fmadd_pd(p, scale, one));
+	}
+
+	double _Dot(const double* a, const double* b, size_t count)
+	{
+		__m256d s0 = _mm256_setzero_pd();
+		__m256d s1 = _mm256_setzero_pd();
+		__m256d s2 = _mm256_setzero_pd();
+		__m256d s3 = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+			s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8), s2);
+			s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12), s3);
+		}
+
+		for (; i + 4 <= count; i += 4)
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+
+		const __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+		const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+
+		for (; i < count; ++i)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	void _Axpy(double alpha, const double* x, double* y, size_t count)
+	{
+		const __m256d va = _mm256_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+			_mm256_storeu_pd(y + i + 4, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+		}
+
+		for (; i + 4 <= count; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[i];
+	}
+
+	double _SparseDot(const double* values, const uint32_t* indices, const double* x, size_t count)
+	{
+		__m256d s0 = _mm256_setzero_pd();
+		__m256d s1 = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + i), _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + i)), 8), s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(values + i + 4), _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + i + 4)), 8), s1);
+		}
+
+		for (; i + 4 <= count; i += 4)
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + i), _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + i)), 8), s0);
+
+		const __m256d s = _mm256_add_pd(s0, s1);
+		const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+
+		for (; i < count; ++i)
+			sum += values[i] * x[indices[i]];
+
+		return sum;
+	}
+
+	void _SparseAxpy(double alpha, const double* x, const uint32_t* indices, double* y, size_t count)
+	{
+		const __m256d va = _mm256_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + i)), 8), _mm256_loadu_pd(y + i)));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[indices[i]];
+	}
+
+	void _Axpy4(const double* a, const double* const* b, double* c, size_t count)
+	{
+		const __m256d a0 = _mm256_set1_pd(a[0]);
+		const __m256d a1 = _mm256_set1_pd(a[1]);
+		const __m256d a2 = _mm256_set1_pd(a[2]);
+		const __m256d a3 = _mm256_set1_pd(a[3]);
+		const double* b0 = b[0];
+		const double* b1 = b[1];
+		const double* b2 = b[2];
+		const double* b3 = b[3];
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256d vc = _mm256_loadu_pd(c + i);
+			vc = _mm256_fmadd_pd(a0, _mm256_loadu_pd(b0 + i), vc);
+			vc = _mm256_fmadd_pd(a1, _mm256_loadu_pd(b1 + i), vc);
+			vc = _mm256_fmadd_pd(a2, _mm256_loadu_pd(b2 + i), vc);
+			vc = _mm256_fmadd_pd(a3, _mm256_loadu_pd(b3 + i), vc);
+			_mm256_storeu_pd(c + i, vc);
+		}
+
+		for (; i < count; ++i)
+			c[i] += a[0] * b0[i] + a[1] * b1[i] + a[2] * b2[i] + a[3] * b3[i];
+	}
+
+	//Two rows of a at a time so that the 8 accumulators + 6 operands fit in the 16 ymm registers
+	__forceinline void _TileABt2x4(const double* a, const double* b, double* c, size_t ldc, size_t k, size_t kc)
+	{
+		const double* a0 = a;
+		const double* a1 = a + k;
+		const double* b0 = b;
+		const double* b1 = b + k;
+		const double* b2 = b + 2 * k;
+		const double* b3 = b + 3 * k;
+
+		__m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c02 = _mm256_setzero_pd(), c03 = _mm256_setzero_pd();
+		__m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd(), c12 = _mm256_setzero_pd(), c13 = _mm256_setzero_pd();
+
+		size_t p = 0;
+		for (; p + 4 <= kc; p += 4)
+		{
+			const __m256d va0 = _mm256_loadu_pd(a0 + p);
+			const __m256d va1 = _mm256_loadu_pd(a1 + p);
+			const __m256d vb0 = _mm256_loadu_pd(b0 + p);
+			const __m256d vb1 = _mm256_loadu_pd(b1 + p);
+			const __m256d vb2 = _mm256_loadu_pd(b2 + p);
+			const __m256d vb3 = _mm256_loadu_pd(b3 + p);
+
+			c00 = _mm256_fmadd_pd(va0, vb0, c00); c01 = _mm256_fmadd_pd(va0, vb1, c01);
+			c02 = _mm256_fmadd_pd(va0, vb2, c02); c03 = _mm256_fmadd_pd(va0, vb3, c03);
+			c10 = _mm256_fmadd_pd(va1, vb0, c10); c11 = _mm256_fmadd_pd(va1, vb1, c11);
+			c12 = _mm256_fmadd_pd(va1, vb2, c12); c13 = _mm256_fmadd_pd(va1, vb3, c13);
+		}
+
+		alignas(32) double r0[4];
+		alignas(32) double r1[4];
+		_mm256_store_pd(r0, _Reduce4(c00, c01, c02, c03));
+		_mm256_store_pd(r1, _Reduce4(c10, c11, c12, c13));
+
+		for (; p < kc; ++p)
+		{
+			r0[0] += a0[p] * b0[p]; r0[1] += a0[p] * b1[p]; r0[2] += a0[p] * b2[p]; r0[3] += a0[p] * b3[p];
+			r1[0] += a1[p] * b0[p]; r1[1] += a1[p] * b1[p]; r1[2] += a1[p] * b2[p]; r1[3] += a1[p] * b3[p];
+		}
+
+		_mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), _mm256_load_pd(r0)));
+		_mm256_storeu_pd(c + ldc, _mm256_add_pd(_mm256_loadu_pd(c + ldc), _mm256_load_pd(r1)));
+	}
+
+	void _TileABt4x4(const double* a, const double* b, double* c, size_t ldc, size_t k, size_t kc)
+	{
+		_TileABt2x4(a, b, c, ldc, k, kc);
+		_TileABt2x4(a + 2 * k, b, c + 2 * ldc, ldc, k, kc);
+	}
+
+	void _ApplyGradient(double* values, double* pdC, double factor, size_t count)
+	{
+		const __m256d vf = _mm256_set1_pd(factor);
+		const __m256d zero = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm256_storeu_pd(values + i, _mm256_fnmadd_pd(vf, _mm256_loadu_pd(pdC + i), _mm256_loadu_pd(values + i)));
+			_mm256_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			values[i] -= factor * pdC[i];
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyMomentum(double* values, double* pdC, double* velocity, double gradientScale, double momentum, double gradientRate, double velocityRate, size_t count)
+	{
+		const __m256d vs = _mm256_set1_pd(gradientScale);
+		const __m256d vm = _mm256_set1_pd(momentum);
+		const __m256d vgr = _mm256_set1_pd(gradientRate);
+		const __m256d vvr = _mm256_set1_pd(velocityRate);
+		const __m256d zero = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256d g = _mm256_mul_pd(vs, _mm256_loadu_pd(pdC + i));
+			const __m256d v = _mm256_fmadd_pd(vm, _mm256_loadu_pd(velocity + i), g);
+
+			_mm256_storeu_pd(velocity + i, v);
+			_mm256_storeu_pd(values + i, _mm256_fnmadd_pd(vgr, g, _mm256_fnmadd_pd(vvr, v, _mm256_loadu_pd(values + i))));
+			_mm256_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			velocity[i] = momentum * velocity[i] + g;
+			values[i] -= gradientRate * g + velocityRate * velocity[i];
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyRMSProp(double* values, double* pdC, double* meanSquare, double gradientScale, double decay, double rate, double epsilon, size_t count)
+	{
+		const __m256d vs = _mm256_set1_pd(gradientScale);
+		const __m256d vd = _mm256_set1_pd(decay);
+		const __m256d vd1 = _mm256_set1_pd(1.0 - decay);
+		const __m256d vr = _mm256_set1_pd(rate);
+		const __m256d ve = _mm256_set1_pd(epsilon);
+		const __m256d zero = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256d g = _mm256_mul_pd(vs, _mm256_loadu_pd(pdC + i));
+			const __m256d r = _mm256_fmadd_pd(vd, _mm256_loadu_pd(meanSquare + i), _mm256_mul_pd(vd1, _mm256_mul_pd(g, g)));
+
+			_mm256_storeu_pd(meanSquare + i, r);
+			_mm256_storeu_pd(values + i, _mm256_fnmadd_pd(vr, _mm256_div_pd(g, _mm256_add_pd(_mm256_sqrt_pd(r), ve)), _mm256_loadu_pd(values + i)));
+			_mm256_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			meanSquare[i] = decay * meanSquare[i] + (1.0 - decay) * g * g;
+			values[i] -= rate * g / (std::sqrt(meanSquare[i]) + epsilon);
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyAdam(double* values, double* pdC, double* firstMoment, double* secondMoment, double gradientScale, double beta1, double beta2, double rate, double epsilon, size_t count)
+	{
+		const __m256d vs = _mm256_set1_pd(gradientScale);
+		const __m256d vb1 = _mm256_set1_pd(beta1);
+		const __m256d vc1 = _mm256_set1_pd(1.0 - beta1);
+		const __m256d vb2 = _mm256_set1_pd(beta2);
+		const __m256d vc2 = _mm256_set1_pd(1.0 - beta2);
+		const __m256d vr = _mm256_set1_pd(rate);
+		const __m256d ve = _mm256_set1_pd(epsilon);
+		const __m256d zero = _mm256_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256d g = _mm256_mul_pd(vs, _mm256_loadu_pd(pdC + i));
+			const __m256d m = _mm256_fmadd_pd(vb1, _mm256_loadu_pd(firstMoment + i), _mm256_mul_pd(vc1, g));
+			const __m256d v = _mm256_fmadd_pd(vb2, _mm256_loadu_pd(secondMoment + i), _mm256_mul_pd(vc2, _mm256_mul_pd(g, g)));
+
+			_mm256_storeu_pd(firstMoment + i, m);
+			_mm256_storeu_pd(secondMoment + i, v);
+			_mm256_storeu_pd(values + i, _mm256_fnmadd_pd(vr, _mm256_div_pd(m, _mm256_add_pd(_mm256_sqrt_pd(v), ve)), _mm256_loadu_pd(values + i)));
+			_mm256_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			firstMoment[i] = beta1 * firstMoment[i] + (1.0 - beta1) * g;
+			secondMoment[i] = beta2 * secondMoment[i] + (1.0 - beta2) * g * g;
+			values[i] -= rate * firstMoment[i] / (std::sqrt(secondMoment[i]) + epsilon);
+			pdC[i] = 0.0;
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(double* z, const double* bias, double* a, size_t count, const ExpPolynomial& exp)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256d vz = _mm256_add_pd(_mm256_loadu_pd(z + i), _mm256_loadu_pd(bias + i));
+			_mm256_storeu_pd(z + i, vz);
+			_mm256_storeu_pd(a + i, ACTIVATION::Activate(vz, exp));
+		}
+
+		if (i < count)
+		{
+			alignas(32) double tail[4] = {};
+			for (size_t j = i; j < count; ++j)
+				tail[j - i] = z[j] += bias[j];
+
+			_mm256_store_pd(tail, ACTIVATION::Activate(_mm256_load_pd(tail), exp));
+
+			for (size_t j = i; j < count; ++j)
+				a[j] = tail[j - i];
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(double* error, const double* a, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256d va = _mm256_loadu_pd(a + i);
+			_mm256_storeu_pd(error + i, _mm256_mul_pd(_mm256_loadu_pd(error + i), ACTIVATION::Prime(va)));
+		}
+
+		for (; i < count; ++i)
+			error[i] *= ACTIVATION::Prime(a[i]);
+	}
+
+	//Single precision, 8 floats per register
+
+	//{ sum(v0), sum(v1), sum(v2), sum(v3) }
+	__forceinline __m128 _Reduce4(__m256 v0, __m256 v1, __m256 v2, __m256 v3)
+	{
+		const __m256 s = _mm256_hadd_ps(_mm256_hadd_ps(v0, v1), _mm256_hadd_ps(v2, v3));
+		return _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+	}
+
+	__forceinline __m256 _Sigmoid(__m256 z, const ExpPolynomial& exp)
+	{
+		const __m256 range = _mm256_set1_ps((float)ExpPolynomial::SIGMOID_RANGE);
+		const __m256 bias = _mm256_set1_ps(ExpPolynomial::ROUNDING_BIAS_F32);
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		const __m256 x = _mm256_min_ps(_mm256_max_ps(z, _mm256_sub_ps(_mm256_setzero_ps(), range)), range);
+		const __m256 v = _mm256_mul_ps(x, _mm256_set1_ps((float)-ExpPolynomial::LOG2E));
+		const __m256 rounded = _mm256_add_ps(v, bias);
+		const __m256 f = _mm256_sub_ps(v, _mm256_sub_ps(rounded, bias));
+
+		__m256 p = _mm256_set1_ps((float)exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm256_fmadd_ps(p, f, _mm256_set1_ps((float)exp.coefficients[i]));
+
+		const __m256i n = _mm256_sub_epi32(_mm256_castps_si256(rounded), _mm256_castps_si256(bias));
+		const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+
+		return _mm256_div_ps(one, _mm256_fmadd_ps(p, scale, one));
+	}
+
+	float _Dot(const float* a, const float* b, size_t count)
+	{
+		__m256 s0 = _mm256_setzero_ps();
+		__m256 s1 = _mm256_setzero_ps();
+		__m256 s2 = _mm256_setzero_ps();
+		__m256 s3 = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+			s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+			s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), s2);
+			s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), s3);
+		}
+
+		for (; i + 8 <= count; i += 8)
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+
+		const __m256 s = _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3));
+		__m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+		h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+		float sum = _mm_cvtss_f32(_mm_add_ss(h, _mm_movehdup_ps(h)));
+
+		for (; i < count; ++i)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	void _Axpy(float alpha, const float* x, float* y, size_t count)
+	{
+		const __m256 va = _mm256_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+			_mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+		}
+
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[i];
+	}
+
+	float _SparseDot(const float* values, const uint32_t* indices, const float* x, size_t count)
+	{
+		__m256 s0 = _mm256_setzero_ps();
+		__m256 s1 = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(values + i), _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i*)(indices + i)), 4), s0);
+			s1 = _mm256_fmadd_ps(_mm256_loadu_ps(values + i + 8), _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i*)(indices + i + 8)), 4), s1);
+		}
+
+		for (; i + 8 <= count; i += 8)
+			s0 = _mm256_fmadd_ps(_mm256_loadu_ps(values + i), _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i*)(indices + i)), 4), s0);
+
+		const __m256 s = _mm256_add_ps(s0, s1);
+		__m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+		h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+		float sum = _mm_cvtss_f32(_mm_add_ss(h, _mm_movehdup_ps(h)));
+
+		for (; i < count; ++i)
+			sum += values[i] * x[indices[i]];
+
+		return sum;
+	}
+
+	void _SparseAxpy(float alpha, const float* x, const uint32_t* indices, float* y, size_t count)
+	{
+		const __m256 va = _mm256_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i*)(indices + i)), 4), _mm256_loadu_ps(y + i)));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[indices[i]];
+	}
+
+	void _Axpy4(const float* a, const float* const* b, float* c, size_t count)
+	{
+		const __m256 a0 = _mm256_set1_ps(a[0]);
+		const __m256 a1 = _mm256_set1_ps(a[1]);
+		const __m256 a2 = _mm256_set1_ps(a[2]);
+		const __m256 a3 = _mm256_set1_ps(a[3]);
+		const float* b0 = b[0];
+		const float* b1 = b[1];
+		const float* b2 = b[2];
+		const float* b3 = b[3];
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 vc = _mm256_loadu_ps(c + i);
+			vc = _mm256_fmadd_ps(a0, _mm256_loadu_ps(b0 + i), vc);
+			vc = _mm256_fmadd_ps(a1, _mm256_loadu_ps(b1 + i), vc);
+			vc = _mm256_fmadd_ps(a2, _mm256_loadu_ps(b2 + i), vc);
+			vc = _mm256_fmadd_ps(a3, _mm256_loadu_ps(b3 + i), vc);
+			_mm256_storeu_ps(c + i, vc);
+		}
+
+		for (; i < count; ++i)
+			c[i] += a[0] * b0[i] + a[1] * b1[i] + a[2] * b2[i] + a[3] * b3[i];
+	}
+
+	__forceinline void _TileABt2x4(const float* a, const float* b, float* c, size_t ldc, size_t k, size_t kc)
+	{
+		const float* a0 = a;
+		const float* a1 = a + k;
+		const float* b0 = b;
+		const float* b1 = b + k;
+		const float* b2 = b + 2 * k;
+		const float* b3 = b + 3 * k;
+
+		__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c02 = _mm256_setzero_ps(), c03 = _mm256_setzero_ps();
+		__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps(), c12 = _mm256_setzero_ps(), c13 = _mm256_setzero_ps();
+
+		size_t p = 0;
+		for (; p + 8 <= kc; p += 8)
+		{
+			const __m256 va0 = _mm256_loadu_ps(a0 + p);
+			const __m256 va1 = _mm256_loadu_ps(a1 + p);
+			const __m256 vb0 = _mm256_loadu_ps(b0 + p);
+			const __m256 vb1 = _mm256_loadu_ps(b1 + p);
+			const __m256 vb2 = _mm256_loadu_ps(b2 + p);
+			const __m256 vb3 = _mm256_loadu_ps(b3 + p);
+
+			c00 = _mm256_fmadd_ps(va0, vb0, c00); c01 = _mm256_fmadd_ps(va0, vb1, c01);
+			c02 = _mm256_fmadd_ps(va0, vb2, c02); c03 = _mm256_fmadd_ps(va0, vb3, c03);
+			c10 = _mm256_fmadd_ps(va1, vb0, c10); c11 = _mm256_fmadd_ps(va1, vb1, c11);
+			c12 = _mm256_fmadd_ps(va1, vb2, c12); c13 = _mm256_fmadd_ps(va1, vb3, c13);
+		}
+
+		alignas(16) float r0[4];
+		alignas(16) float r1[4];
+		_mm_store_ps(r0, _Reduce4(c00, c01, c02, c03));
+		_mm_store_ps(r1, _Reduce4(c10, c11, c12, c13));
+
+		for (; p < kc; ++p)
+		{
+			r0[0] += a0[p] * b0[p]; r0[1] += a0[p] * b1[p]; r0[2] += a0[p] * b2[p]; r0[3] += a0[p] * b3[p];
+			r1[0] += a1[p] * b0[p]; r1[1] += a1[p] * b1[p]; r1[2] += a1[p] * b2[p]; r1[3] += a1[p] * b3[p];
+		}
+
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _mm_load_ps(r0)));
+		_mm_storeu_ps(c + ldc, _mm_add_ps(_mm_loadu_ps(c + ldc), _mm_load_ps(r1)));
+	}
+
+	void _TileABt4x4(const float* a, const float* b, float* c, size_t ldc, size_t k, size_t kc)
+	{
+		_TileABt2x4(a, b, c, ldc, k, kc);
+		_TileABt2x4(a + 2 * k, b, c + 2 * ldc, ldc, k, kc);
+	}
+
+	void _ApplyGradient(float* values, float* pdC, float factor, size_t count)
+	{
+		const __m256 vf = _mm256_set1_ps(factor);
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(values + i, _mm256_fnmadd_ps(vf, _mm256_loadu_ps(pdC + i), _mm256_loadu_ps(values + i)));
+			_mm256_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			values[i] -= factor * pdC[i];
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyMomentum(float* values, float* pdC, float* velocity, float gradientScale, float momentum, float gradientRate, float velocityRate, size_t count)
+	{
+		const __m256 vs = _mm256_set1_ps(gradientScale);
+		const __m256 vm = _mm256_set1_ps(momentum);
+		const __m256 vgr = _mm256_set1_ps(gradientRate);
+		const __m256 vvr = _mm256_set1_ps(velocityRate);
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 g = _mm256_mul_ps(vs, _mm256_loadu_ps(pdC + i));
+			const __m256 v = _mm256_fmadd_ps(vm, _mm256_loadu_ps(velocity + i), g);
+
+			_mm256_storeu_ps(velocity + i, v);
+			_mm256_storeu_ps(values + i, _mm256_fnmadd_ps(vgr, g, _mm256_fnmadd_ps(vvr, v, _mm256_loadu_ps(values + i))));
+			_mm256_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			velocity[i] = momentum * velocity[i] + g;
+			values[i] -= gradientRate * g + velocityRate * velocity[i];
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyRMSProp(float* values, float* pdC, float* meanSquare, float gradientScale, float decay, float rate, float epsilon, size_t count)
+	{
+		const __m256 vs = _mm256_set1_ps(gradientScale);
+		const __m256 vd = _mm256_set1_ps(decay);
+		const __m256 vd1 = _mm256_set1_ps(1.f - decay);
+		const __m256 vr = _mm256_set1_ps(rate);
+		const __m256 ve = _mm256_set1_ps(epsilon);
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 g = _mm256_mul_ps(vs, _mm256_loadu_ps(pdC + i));
+			const __m256 r = _mm256_fmadd_ps(vd, _mm256_loadu_ps(meanSquare + i), _mm256_mul_ps(vd1, _mm256_mul_ps(g, g)));
+
+			_mm256_storeu_ps(meanSquare + i, r);
+			_mm256_storeu_ps(values + i, _mm256_fnmadd_ps(vr, _mm256_div_ps(g, _mm256_add_ps(_mm256_sqrt_ps(r), ve)), _mm256_loadu_ps(values + i)));
+			_mm256_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			meanSquare[i] = decay * meanSquare[i] + (1.f - decay) * g * g;
+			values[i] -= rate * g / (std::sqrt(meanSquare[i]) + epsilon);
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyAdam(float* values, float* pdC, float* firstMoment, float* secondMoment, float gradientScale, float beta1, float beta2, float rate, float epsilon, size_t count)
+	{
+		const __m256 vs = _mm256_set1_ps(gradientScale);
+		const __m256 vb1 = _mm256_set1_ps(beta1);
+		const __m256 vc1 = _mm256_set1_ps(1.f - beta1);
+		const __m256 vb2 = _mm256_set1_ps(beta2);
+		const __m256 vc2 = _mm256_set1_ps(1.f - beta2);
+		const __m256 vr = _mm256_set1_ps(rate);
+		const __m256 ve = _mm256_set1_ps(epsilon);
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 g = _mm256_mul_ps(vs, _mm256_loadu_ps(pdC + i));
+			const __m256 m = _mm256_fmadd_ps(vb1, _mm256_loadu_ps(firstMoment + i), _mm256_mul_ps(vc1, g));
+			const __m256 v = _mm256_fmadd_ps(vb2, _mm256_loadu_ps(secondMoment + i), _mm256_mul_ps(vc2, _mm256_mul_ps(g, g)));
+
+			_mm256_storeu_ps(firstMoment + i, m);
+			_mm256_storeu_ps(secondMoment + i, v);
+			_mm256_storeu_ps(values + i, _mm256_fnmadd_ps(vr, _mm256_div_ps(m, _mm256_add_ps(_mm256_sqrt_ps(v), ve)), _mm256_loadu_ps(values + i)));
+			_mm256_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			firstMoment[i] = beta1 * firstMoment[i] + (1.f - beta1) * g;
+			secondMoment[i] = beta2 * secondMoment[i] + (1.f - beta2) * g * g;
+			values[i] -= rate * firstMoment[i] / (std::sqrt(secondMoment[i]) + epsilon);
+			pdC[i] = 0.f;
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(float* z, const float* bias, float* a, size_t count, const ExpPolynomial& exp)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 vz = _mm256_add_ps(_mm256_loadu_ps(z + i), _mm256_loadu_ps(bias + i));
+			_mm256_storeu_ps(z + i, vz);
+			_mm256_storeu_ps(a + i, ACTIVATION::Activate(vz, exp));
+		}
+
+		if (i < count)
+		{
+			alignas(32) float tail[8] = {};
+			for (size_t j = i; j < count; ++j)
+				tail[j - i] = z[j] += bias[j];
+
+			_mm256_store_ps(tail, ACTIVATION::Activate(_mm256_load_ps(tail), exp));
+
+			for (size_t j = i; j < count; ++j)
+				a[j] = tail[j - i];
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(float* error, const float* a, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 va = _mm256_loadu_ps(a + i);
+			_mm256_storeu_ps(error + i, _mm256_mul_ps(_mm256_loadu_ps(error + i), ACTIVATION::Prime(va)));
+		}
+
+		for (; i < count; ++i)
+			error[i] *= ACTIVATION::Prime(a[i]);
+	}
+
+	//Int8, widened to int16 so that vpmaddwd can multiply and add pairs into int32
+	void _MatVecInt8(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+	{
+		for (size_t r = 0; r < rows; ++r)
+		{
+			const int8_t* row = a + r * cols;
+			__m256i acc0 = _mm256_setzero_si256();
+			__m256i acc1 = _mm256_setzero_si256();
+
+			size_t i = 0;
+			for (; i + 32 <= cols; i += 32)
+			{
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i)))));
+				acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i + 16))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i + 16)))));
+			}
+
+			for (; i + 16 <= cols; i += 16)
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i)))));
+
+			const __m256i acc = _mm256_add_epi32(acc0, acc1);
+			__m128i h = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+			h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4E));
+			h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xB1));
+			int32_t sum = _mm_cvtsi128_si32(h);
+
+			for (; i < cols; ++i)
+				sum += (int32_t)row[i] * x[i];
+
+			y[r] = sum;
+		}
+	}
+
+	//Activation policies, _BiasActivate and _MulActivationPrime are instantiated once per policy so the activation is fixed at compile time
+	//Prime is the derivative in terms of the activation's output a, with scalar versions for the tails
+	struct _SigmoidActivation
+	{
+		static __forceinline __m256d Activate(__m256d z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+		static __forceinline __m256 Activate(__m256 z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+
+		static __forceinline __m256d Prime(__m256d a) { return _mm256_fnmadd_pd(a, a, a); }
+		static __forceinline __m256 Prime(__m256 a) { return _mm256_fnmadd_ps(a, a, a); }
+		static __forceinline double Prime(double a) { return a * (1.0 - a); }
+		static __forceinline float Prime(float a) { return a * (1.f - a); }
+	};
+
+	struct _ReluActivation
+	{
+		static __forceinline __m256d Activate(__m256d z, const ExpPolynomial&) { return _mm256_max_pd(z, _mm256_setzero_pd()); }
+		static __forceinline __m256 Activate(__m256 z, const ExpPolynomial&) { return _mm256_max_ps(z, _mm256_setzero_ps()); }
+
+		static __forceinline __m256d Prime(__m256d a) { return _mm256_and_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ), _mm256_set1_pd(1.0)); }
+		static __forceinline __m256 Prime(__m256 a) { return _mm256_and_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_set1_ps(1.f)); }
+		static __forceinline double Prime(double a) { return a > 0.0 ? 1.0 : 0.0; }
+		static __forceinline float Prime(float a) { return a > 0.f ? 1.f : 0.f; }
+	};
+
+	struct _LeakyReluActivation
+	{
+		static __forceinline __m256d Activate(__m256d z, const ExpPolynomial&) { return _mm256_max_pd(z, _mm256_mul_pd(z, _mm256_set1_pd(LEAKY_RELU_SLOPE))); }
+		static __forceinline __m256 Activate(__m256 z, const ExpPolynomial&) { return _mm256_max_ps(z, _mm256_mul_ps(z, _mm256_set1_ps((float)LEAKY_RELU_SLOPE))); }
+
+		static __forceinline __m256d Prime(__m256d a) { return _mm256_blendv_pd(_mm256_set1_pd(LEAKY_RELU_SLOPE), _mm256_set1_pd(1.0), _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ)); }
+		static __forceinline __m256 Prime(__m256 a) { return _mm256_blendv_ps(_mm256_set1_ps((float)LEAKY_RELU_SLOPE), _mm256_set1_ps(1.f), _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ)); }
+		static __forceinline double Prime(double a) { return a > 0.0 ? 1.0 : LEAKY_RELU_SLOPE; }
+		static __forceinline float Prime(float a) { return a > 0.f ? 1.f : (float)LEAKY_RELU_SLOPE; }
+	};
+
+	//tanh(z) = 2 * sigmoid(2z) - 1
+	struct _TanhActivation
+	{
+		static __forceinline __m256d Activate(__m256d z, const ExpPolynomial& exp) { return _mm256_fmsub_pd(_mm256_set1_pd(2.0), _Sigmoid(_mm256_add_pd(z, z), exp), _mm256_set1_pd(1.0)); }
+		static __forceinline __m256 Activate(__m256 z, const ExpPolynomial& exp) { return _mm256_fmsub_ps(_mm256_set1_ps(2.f), _Sigmoid(_mm256_add_ps(z, z), exp), _mm256_set1_ps(1.f)); }
+
+		static __forceinline __m256d Prime(__m256d a) { return _mm256_fnmadd_pd(a, a, _mm256_set1_pd(1.0)); }
+		static __forceinline __m256 Prime(__m256 a) { return _mm256_fnmadd_ps(a, a, _mm256_set1_ps(1.f)); }
+		static __forceinline double Prime(double a) { return 1.0 - a * a; }
+		static __forceinline float Prime(float a) { return 1.f - a * a; }
+	};
+}
+
+const KernelTable kernelsAVX2 =
+{
+	"AVX2",
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	_MatVecInt8,
+	0.03
+};
@@ -0,0 +1,747 @@
+#include "KernelTable.hpp"
+#include <immintrin.h>
+
+/*
+	AVX-512F, 8 doubles or 16 floats per register
+	Tails are handled with masked loads/stores instead of scalar loops
+	Built with /arch:AVX512, only ever called once CPUID has confirmed support
+*/
+
+namespace
+{
+	__forceinline __mmask8 _TailMask(size_t count)
+	{
+		return (__mmask8)((1u << count) - 1);
+	}
+
+	//1 / (1 + exp(-z)), with exp done as a scaled polynomial
+	__forceinline __m512d _Sigmoid(__m512d z, const ExpPolynomial& exp)
+	{
+		const __m512d range = _mm512_set1_pd(ExpPolynomial::SIGMOID_RANGE);
+		const __m512d bias = _mm512_set1_pd(ExpPolynomial::ROUNDING_BIAS);
+		const __m512d one = _mm512_set1_pd(1.0);
+
+		const __m512d x = _mm512_min_pd(_mm512_max_pd(z, _mm512_sub_pd(_mm512_setzero_pd(), range)), range);
+		const __m512d v = _mm512_mul_pd(x, _mm512_set1_pd(-ExpPolynomial::LOG2E));
+		const __m512d rounded = _mm512_add_pd(v, bias);
+		const __m512d f = _mm512_sub_pd(v, _mm512_sub_pd(rounded, bias));
+
+		__m512d p = _mm512_set1_pd(exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(exp.coefficients[i]));
+
+		//the integer part sits in the low mantissa bits of rounded, build 2^n directly from it
+		const __m512i n = _mm512_sub_epi64(_mm512_castpd_si512(rounded), _mm512_castpd_si512(bias));
+		const __m512d scale = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(n, _mm512_set1_epi64(1023)), 52));
+
+		return _mm512_div_pd(one, _mm512_fmadd_pd(p, scale, one));
+	}
+
+	//{ sum(v0), sum(v1), sum(v2), sum(v3) }
+	__forceinline __m256d _Reduce4(__m512d v0, __m512d v1, __m512d v2, __m512d v3)
+	{
+		const __m256d h0 = _mm256_add_pd(_mm512_castpd512_pd256(v0), _mm512_extractf64x4_pd(v0, 1));
+		const __m256d h1 = _mm256_add_pd(_mm512_castpd512_pd256(v1), _mm512_extractf64x4_pd(v1, 1));
+		const __m256d h2 = _mm256_add_pd(_mm512_castpd512_pd256(v2), _mm512_extractf64x4_pd(v2, 1));
+		const __m256d h3 = _mm256_add_pd(_mm512_castpd512_pd256(v3), _mm512_extractf64x4_pd(v3, 1));
+
+		const __m256d s01 = _mm256_hadd_pd(h0, h1);
+		const __m256d s23 = _mm256_hadd_pd(h2, h3);
+		return _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20), _mm256_permute2f128_pd(s01, s23, 0x31));
+	}
+
+	double _Dot(const double* a, const double* b, size_t count)
+	{
+		__m512d s0 = _mm512_setzero_pd();
+		__m512d s1 = _mm512_setzero_pd();
+		__m512d s2 = _mm512_setzero_pd();
+		__m512d s3 = _mm512_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+			s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 16), _mm512_loadu_pd(b + i + 16), s2);
+			s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 24), _mm512_loadu_pd(b + i + 24), s3);
+		}
+
+		for (; i + 8 <= count; i += 8)
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+
+		if (i < count)
+		{
+			const __mmask8 mask = _TailMask(count - i);
+			s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i), s1);
+		}
+
+		return _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3)));
+	}
+
+	void _Axpy(double alpha, const double* x, double* y, size_t count)
+	{
+		const __m512d va = _mm512_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+			_mm512_storeu_pd(y + i + 8, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8)));
+		}
+
+		for (; i + 8 <= count; i += 8)
+			_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+
+		if (i < count)
+		{
+			const __mmask8 mask = _TailMask(count - i);
+			_mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+		}
+	}
+
+	double _SparseDot(const double* values, const uint32_t* indices, const double* x, size_t count)
+	{
+		__m512d s0 = _mm512_setzero_pd();
+		__m512d s1 = _mm512_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(values + i), _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + i)), x, 8), s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(values + i + 8), _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + i + 8)), x, 8), s1);
+		}
+
+		for (; i + 8 <= count; i += 8)
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(values + i), _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + i)), x, 8), s0);
+
+		if (i < count)
+		{
+			//masked off lanes gather nothing, so indices past the end are never followed
+			const __mmask8 mask = _TailMask(count - i);
+			const __m256i tail = _mm512_castsi512_si256(_mm512_maskz_loadu_epi32((__mmask16)mask, indices + i));
+			s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values + i), _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, tail, x, 8), s1);
+		}
+
+		return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+	}
+
+	void _SparseAxpy(double alpha, const double* x, const uint32_t* indices, double* y, size_t count)
+	{
+		const __m512d va = _mm512_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+			_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + i)), x, 8), _mm512_loadu_pd(y + i)));
+
+		if (i < count)
+		{
+			const __mmask8 mask = _TailMask(count - i);
+			const __m256i tail = _mm512_castsi512_si256(_mm512_maskz_loadu_epi32((__mmask16)mask, indices + i));
+			_mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(va, _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, tail, x, 8), _mm512_maskz_loadu_pd(mask, y + i)));
+		}
+	}
+
+	void _Axpy4(const double* a, const double* const* b, double* c, size_t count)
+	{
+		const __m512d a0 = _mm512_set1_pd(a[0]);
+		const __m512d a1 = _mm512_set1_pd(a[1]);
+		const __m512d a2 = _mm512_set1_pd(a[2]);
+		const __m512d a3 = _mm512_set1_pd(a[3]);
+		const double* b0 = b[0];
+		const double* b1 = b[1];
+		const double* b2 = b[2];
+		const double* b3 = b[3];
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m512d vc = _mm512_loadu_pd(c + i);
+			vc = _mm512_fmadd_pd(a0, _mm512_loadu_pd(b0 + i), vc);
+			vc = _mm512_fmadd_pd(a1, _mm512_loadu_pd(b1 + i), vc);
+			vc = _mm512_fmadd_pd(a2, _mm512_loadu_pd(b2 + i), vc);
+			vc = _mm512_fmadd_pd(a3, _mm512_loadu_pd(b3 + i), vc);
+			_mm512_storeu_pd(c + i, vc);
+		}
+
+		if (i < count)
+		{
+			const __mmask8 mask = _TailMask(count - i);
+			__m512d vc = _mm512_maskz_loadu_pd(mask, c + i);
+			vc = _mm512_fmadd_pd(a0, _mm512_maskz_loadu_pd(mask, b0 + i), vc);
+			vc = _mm512_fmadd_pd(a1, _mm512_maskz_loadu_pd(mask, b1 + i), vc);
+			vc = _mm512_fmadd_pd(a2, _mm512_maskz_loadu_pd(mask, b2 + i), vc);
+			vc = _mm512_fmadd_pd(a3, _mm512_maskz_loadu_pd(mask, b3 + i), vc);
+			_mm512_mask_storeu_pd(c + i, mask, vc);
+		}
+	}
+
+	//32 zmm registers, so the full 4x4 block of accumulators fits alongside the 8 operands
+	void _TileABt4x4(const double* a, const double* b, double* c, size_t ldc, size_t k, size_t kc)
+	{
+		const double* a0 = a;
+		const double* a1 = a + k;
+		const double* a2 = a + 2 * k;
+		const double* a3 = a + 3 * k;
+		const double* b0 = b;
+		const double* b1 = b + k;
+		const double* b2 = b + 2 * k;
+		const double* b3 = b + 3 * k;
+
+		__m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd(), c02 = _mm512_setzero_pd(), c03 = _mm512_setzero_pd();
+		__m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd(), c12 = _mm512_setzero_pd(), c13 = _mm512_setzero_pd();
+		__m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd(), c22 = _mm512_setzero_pd(), c23 = _mm512_setzero_pd();
+		__m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd(), c32 = _mm512_setzero_pd(), c33 = _mm512_setzero_pd();
+
+		size_t p = 0;
+		while (p < kc)
+		{
+			//full registers until the tail, which is zero-masked so it adds nothing past kc
+			const __mmask8 mask = kc - p >= 8 ? (__mmask8)0xFF : _TailMask(kc - p);
+
+			const __m512d va0 = _mm512_maskz_loadu_pd(mask, a0 + p);
+			const __m512d va1 = _mm512_maskz_loadu_pd(mask, a1 + p);
+			const __m512d va2 = _mm512_maskz_loadu_pd(mask, a2 + p);
+			const __m512d va3 = _mm512_maskz_loadu_pd(mask, a3 + p);
+			const __m512d vb0 = _mm512_maskz_loadu_pd(mask, b0 + p);
+			const __m512d vb1 = _mm512_maskz_loadu_pd(mask, b1 + p);
+			const __m512d vb2 = _mm512_maskz_loadu_pd(mask, b2 + p);
+			const __m512d vb3 = _mm512_maskz_loadu_pd(mask, b3 + p);
+
+			c00 = _mm512_fmadd_pd(va0, vb0, c00); c01 = _mm512_fmadd_pd(va0, vb1, c01); c02 = _mm512_fmadd_pd(va0, vb2, c02); c03 = _mm512_fmadd_pd(va0, vb3, c03);
+			c10 = _mm512_fmadd_pd(va1, vb0, c10); c11 = _mm512_fmadd_pd(va1, vb1, c11); c12 = _mm512_fmadd_pd(va1, vb2, c12); c13 = _mm512_fmadd_pd(va1, vb3, c13);
+			c20 = _mm512_fmadd_pd(va2, vb0, c20); c21 = _mm512_fmadd_pd(va2, vb1, c21); c22 = _mm512_fmadd_pd(va2, vb2, c22); c23 = _mm512_fmadd_pd(va2, vb3, c23);
+			c30 = _mm512_fmadd_pd(va3, vb0, c30); c31 = _mm512_fmadd_pd(va3, vb1, c31); c32 = _mm512_fmadd_pd(va3, vb2, c32); c33 = _mm512_fmadd_pd(va3, vb3, c33);
+
+			p += 8;
+		}
+
+		_mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), _Reduce4(c00, c01, c02, c03)));
+		c += ldc;
+		_mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), _Reduce4(c10, c11, c12, c13)));
+		c += ldc;
+		_mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), _Reduce4(c20, c21, c22, c23)));
+		c += ldc;
+		_mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), _Reduce4(c30, c31, c32, c33)));
+	}
+
+	void _ApplyGradient(double* values, double* pdC, double factor, size_t count)
+	{
+		const __m512d vf = _mm512_set1_pd(factor);
+		const __m512d zero = _mm512_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm512_storeu_pd(values + i, _mm512_fnmadd_pd(vf, _mm512_loadu_pd(pdC + i), _mm512_loadu_pd(values + i)));
+			_mm512_storeu_pd(pdC + i, zero);
+		}
+
+		if (i < count)
+		{
+			const __mmask8 mask = _TailMask(count - i);
+			_mm512_mask_storeu_pd(values + i, mask, _mm512_fnmadd_pd(vf, _mm512_maskz_loadu_pd(mask, pdC + i), _mm512_maskz_loadu_pd(mask, values + i)));
+			_mm512_mask_storeu_pd(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyMomentum(double* values, double* pdC, double* velocity, double gradientScale, double momentum, double gradientRate, double velocityRate, size_t count)
+	{
+		const __m512d vs = _mm512_set1_pd(gradientScale);
+		const __m512d vm = _mm512_set1_pd(momentum);
+		const __m512d vgr = _mm512_set1_pd(gradientRate);
+		const __m512d vvr = _mm512_set1_pd(velocityRate);
+		const __m512d zero = _mm512_setzero_pd();
+
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __mmask8 mask = count - i >= 8 ? (__mmask8)0xFF : _TailMask(count - i);
+
+			const __m512d g = _mm512_mul_pd(vs, _mm512_maskz_loadu_pd(mask, pdC + i));
+			const __m512d v = _mm512_fmadd_pd(vm, _mm512_maskz_loadu_pd(mask, velocity + i), g);
+
+			_mm512_mask_storeu_pd(velocity + i, mask, v);
+			_mm512_mask_storeu_pd(values + i, mask, _mm512_fnmadd_pd(vgr, g, _mm512_fnmadd_pd(vvr, v, _mm512_maskz_loadu_pd(mask, values + i))));
+			_mm512_mask_storeu_pd(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyRMSProp(double* values, double* pdC, double* meanSquare, double gradientScale, double decay, double rate, double epsilon, size_t count)
+	{
+		const __m512d vs = _mm512_set1_pd(gradientScale);
+		const __m512d vd = _mm512_set1_pd(decay);
+		const __m512d vd1 = _mm512_set1_pd(1.0 - decay);
+		const __m512d vr = _mm512_set1_pd(rate);
+		const __m512d ve = _mm512_set1_pd(epsilon);
+		const __m512d zero = _mm512_setzero_pd();
+
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __mmask8 mask = count - i >= 8 ? (__mmask8)0xFF : _TailMask(count - i);
+
+			const __m512d g = _mm512_mul_pd(vs, _mm512_maskz_loadu_pd(mask, pdC + i));
+			const __m512d r = _mm512_fmadd_pd(vd, _mm512_maskz_loadu_pd(mask, meanSquare + i), _mm512_mul_pd(vd1, _mm512_mul_pd(g, g)));
+
+			_mm512_mask_storeu_pd(meanSquare + i, mask, r);
+			_mm512_mask_storeu_pd(values + i, mask, _mm512_fnmadd_pd(vr, _mm512_div_pd(g, _mm512_add_pd(_mm512_sqrt_pd(r), ve)), _mm512_maskz_loadu_pd(mask, values + i)));
+			_mm512_mask_storeu_pd(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyAdam(double* values, double* pdC, double* firstMoment, double* secondMoment, double gradientScale, double beta1, double beta2, double rate, double epsilon, size_t count)
+	{
+		const __m512d vs = _mm512_set1_pd(gradientScale);
+		const __m512d vb1 = _mm512_set1_pd(beta1);
+		const __m512d vc1 = _mm512_set1_pd(1.0 - beta1);
+		const __m512d vb2 = _mm512_set1_pd(beta2);
+		const __m512d vc2 = _mm512_set1_pd(1.0 - beta2);
+		const __m512d vr = _mm512_set1_pd(rate);
+		const __m512d ve = _mm512_set1_pd(epsilon);
+		const __m512d zero = _mm512_setzero_pd();
+
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __mmask8 mask = count - i >= 8 ? (__mmask8)0xFF : _TailMask(count - i);
+
+			const __m512d g = _mm512_mul_pd(vs, _mm512_maskz_loadu_pd(mask, pdC + i));
+			const __m512d m = _mm512_fmadd_pd(vb1, _mm512_maskz_loadu_pd(mask, firstMoment + i), _mm512_mul_pd(vc1, g));
+			const __m512d v = _mm512_fmadd_pd(vb2, _mm512_maskz_loadu_pd(mask, secondMoment + i), _mm512_mul_pd(vc2, _mm512_mul_pd(g, g)));
+
+			_mm512_mask_storeu_pd(firstMoment + i, mask, m);
+			_mm512_mask_storeu_pd(secondMoment + i, mask, v);
+			_mm512_mask_storeu_pd(values + i, mask, _mm512_fnmadd_pd(vr, _mm512_div_pd(m, _mm512_add_pd(_mm512_sqrt_pd(v), ve)), _mm512_maskz_loadu_pd(mask, values + i)));
+			_mm512_mask_storeu_pd(pdC + i, mask, zero);
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(double* z, const double* bias, double* a, size_t count, const ExpPolynomial& exp)
+	{
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __mmask8 mask = count - i >= 8 ? (__mmask8)0xFF : _TailMask(count - i);
+
+			const __m512d vz = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, z + i), _mm512_maskz_loadu_pd(mask, bias + i));
+			_mm512_mask_storeu_pd(z + i, mask, vz);
+			_mm512_mask_storeu_pd(a + i, mask, ACTIVATION::Activate(vz, exp));
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(double* error, const double* a, size_t count)
+	{
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __mmask8 mask = count - i >= 8 ? (__mmask8)0xFF : _TailMask(count - i);
+
+			const __m512d va = _mm512_maskz_loadu_pd(mask, a + i);
+			_mm512_mask_storeu_pd(error + i, mask, _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, error + i), ACTIVATION::Prime(va)));
+		}
+	}
+
+	//Single precision, 16 floats per register
+
+	__forceinline __mmask16 _TailMask16(size_t count)
+	{
+		return (__mmask16)((1u << count) - 1);
+	}
+
+	//Upper 8 floats, AVX-512F only has the 64 bit form of this extract
+	__forceinline __m256 _High(__m512 v)
+	{
+		return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+	}
+
+	//{ sum(v0), sum(v1), sum(v2), sum(v3) }
+	__forceinline __m128 _Reduce4(__m512 v0, __m512 v1, __m512 v2, __m512 v3)
+	{
+		const __m256 h0 = _mm256_add_ps(_mm512_castps512_ps256(v0), _High(v0));
+		const __m256 h1 = _mm256_add_ps(_mm512_castps512_ps256(v1), _High(v1));
+		const __m256 h2 = _mm256_add_ps(_mm512_castps512_ps256(v2), _High(v2));
+		const __m256 h3 = _mm256_add_ps(_mm512_castps512_ps256(v3), _High(v3));
+
+		const __m256 s = _mm256_hadd_ps(_mm256_hadd_ps(h0, h1), _mm256_hadd_ps(h2, h3));
+		return _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+	}
+
+	__forceinline __m512 _Sigmoid(__m512 z, const ExpPolynomial& exp)
+	{
+		const __m512 range = _mm512_set1_ps((float)ExpPolynomial::SIGMOID_RANGE);
+		const __m512 bias = _mm512_set1_ps(ExpPolynomial::ROUNDING_BIAS_F32);
+		const __m512 one = _mm512_set1_ps(1.f);
+
+		const __m512 x = _mm512_min_ps(_mm512_max_ps(z, _mm512_sub_ps(_mm512_setzero_ps(), range)), range);
+		const __m512 v = _mm512_mul_ps(x, _mm512_set1_ps((float)-ExpPolynomial::LOG2E));
+		const __m512 rounded = _mm512_add_ps(v, bias);
+		const __m512 f = _mm512_sub_ps(v, _mm512_sub_ps(rounded, bias));
+
+		__m512 p = _mm512_set1_ps((float)exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm512_fmadd_ps(p, f, _mm512_set1_ps((float)exp.coefficients[i]));
+
+		const __m512i n = _mm512_sub_epi32(_mm512_castps_si512(rounded), _mm512_castps_si512(bias));
+		const __m512 scale = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(127)), 23));
+
+		return _mm512_div_ps(one, _mm512_fmadd_ps(p, scale, one));
+	}
+
+	float _Dot(const float* a, const float* b, size_t count)
+	{
+		__m512 s0 = _mm512_setzero_ps();
+		__m512 s1 = _mm512_setzero_ps();
+		__m512 s2 = _mm512_setzero_ps();
+		__m512 s3 = _mm512_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 64 <= count; i += 64)
+		{
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+			s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+			s2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), s2);
+			s3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), s3);
+		}
+
+		for (; i + 16 <= count; i += 16)
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+
+		if (i < count)
+		{
+			const __mmask16 mask = _TailMask16(count - i);
+			s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), s1);
+		}
+
+		return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(s0, s1), _mm512_add_ps(s2, s3)));
+	}
+
+	void _Axpy(float alpha, const float* x, float* y, size_t count)
+	{
+		const __m512 va = _mm512_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+			_mm512_storeu_ps(y + i + 16, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16)));
+		}
+
+		for (; i + 16 <= count; i += 16)
+			_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+
+		if (i < count)
+		{
+			const __mmask16 mask = _TailMask16(count - i);
+			_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+		}
+	}
+
+	float _SparseDot(const float* values, const uint32_t* indices, const float* x, size_t count)
+	{
+		__m512 s0 = _mm512_setzero_ps();
+		__m512 s1 = _mm512_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(values + i), _mm512_i32gather_ps(_mm512_loadu_si512(indices + i), x, 4), s0);
+			s1 = _mm512_fmadd_ps(_mm512_loadu_ps(values + i + 16), _mm512_i32gather_ps(_mm512_loadu_si512(indices + i + 16), x, 4), s1);
+		}
+
+		for (; i + 16 <= count; i += 16)
+			s0 = _mm512_fmadd_ps(_mm512_loadu_ps(values + i), _mm512_i32gather_ps(_mm512_loadu_si512(indices + i), x, 4), s0);
+
+		if (i < count)
+		{
+			const __mmask16 mask = _TailMask16(count - i);
+			const __m512i tail = _mm512_maskz_loadu_epi32(mask, indices + i);
+			s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, values + i), _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, tail, x, 4), s1);
+		}
+
+		return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+	}
+
+	void _SparseAxpy(float alpha, const float* x, const uint32_t* indices, float* y, size_t count)
+	{
+		const __m512 va = _mm512_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+			_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_i32gather_ps(_mm512_loadu_si512(indices + i), x, 4), _mm512_loadu_ps(y + i)));
+
+		if (i < count)
+		{
+			const __mmask16 mask = _TailMask16(count - i);
+			const __m512i tail = _mm512_maskz_loadu_epi32(mask, indices + i);
+			_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(va, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, tail, x, 4), _mm512_maskz_loadu_ps(mask, y + i)));
+		}
+	}
+
+	void _Axpy4(const float* a, const float* const* b, float* c, size_t count)
+	{
+		const __m512 a0 = _mm512_set1_ps(a[0]);
+		const __m512 a1 = _mm512_set1_ps(a[1]);
+		const __m512 a2 = _mm512_set1_ps(a[2]);
+		const __m512 a3 = _mm512_set1_ps(a[3]);
+		const float* b0 = b[0];
+		const float* b1 = b[1];
+		const float* b2 = b[2];
+		const float* b3 = b[3];
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			__m512 vc = _mm512_maskz_loadu_ps(mask, c + i);
+			vc = _mm512_fmadd_ps(a0, _mm512_maskz_loadu_ps(mask, b0 + i), vc);
+			vc = _mm512_fmadd_ps(a1, _mm512_maskz_loadu_ps(mask, b1 + i), vc);
+			vc = _mm512_fmadd_ps(a2, _mm512_maskz_loadu_ps(mask, b2 + i), vc);
+			vc = _mm512_fmadd_ps(a3, _mm512_maskz_loadu_ps(mask, b3 + i), vc);
+			_mm512_mask_storeu_ps(c + i, mask, vc);
+		}
+	}
+
+	void _TileABt4x4(const float* a, const float* b, float* c, size_t ldc, size_t k, size_t kc)
+	{
+		const float* a0 = a;
+		const float* a1 = a + k;
+		const float* a2 = a + 2 * k;
+		const float* a3 = a + 3 * k;
+		const float* b0 = b;
+		const float* b1 = b + k;
+		const float* b2 = b + 2 * k;
+		const float* b3 = b + 3 * k;
+
+		__m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps(), c02 = _mm512_setzero_ps(), c03 = _mm512_setzero_ps();
+		__m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps(), c12 = _mm512_setzero_ps(), c13 = _mm512_setzero_ps();
+		__m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps(), c22 = _mm512_setzero_ps(), c23 = _mm512_setzero_ps();
+		__m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps(), c32 = _mm512_setzero_ps(), c33 = _mm512_setzero_ps();
+
+		for (size_t p = 0; p < kc; p += 16)
+		{
+			const __mmask16 mask = kc - p >= 16 ? (__mmask16)0xFFFF : _TailMask16(kc - p);
+
+			const __m512 va0 = _mm512_maskz_loadu_ps(mask, a0 + p);
+			const __m512 va1 = _mm512_maskz_loadu_ps(mask, a1 + p);
+			const __m512 va2 = _mm512_maskz_loadu_ps(mask, a2 + p);
+			const __m512 va3 = _mm512_maskz_loadu_ps(mask, a3 + p);
+			const __m512 vb0 = _mm512_maskz_loadu_ps(mask, b0 + p);
+			const __m512 vb1 = _mm512_maskz_loadu_ps(mask, b1 + p);
+			const __m512 vb2 = _mm512_maskz_loadu_ps(mask, b2 + p);
+			const __m512 vb3 = _mm512_maskz_loadu_ps(mask, b3 + p);
+
+			c00 = _mm512_fmadd_ps(va0, vb0, c00); c01 = _mm512_fmadd_ps(va0, vb1, c01); c02 = _mm512_fmadd_ps(va0, vb2, c02); c03 = _mm512_fmadd_ps(va0, vb3, c03);
+			c10 = _mm512_fmadd_ps(va1, vb0, c10); c11 = _mm512_fmadd_ps(va1, vb1, c11); c12 = _mm512_fmadd_ps(va1, vb2, c12); c13 = _mm512_fmadd_ps(va1, vb3, c13);
+			c20 = _mm512_fmadd_ps(va2, vb0, c20); c21 = _mm512_fmadd_ps(va2, vb1, c21); c22 = _mm512_fmadd_ps(va2, vb2, c22); c23 = _mm512_fmadd_ps(va2, vb3, c23);
+			c30 = _mm512_fmadd_ps(va3, vb0, c30); c31 = _mm512_fmadd_ps(va3, vb1, c31); c32 = _mm512_fmadd_ps(va3, vb2, c32); c33 = _mm512_fmadd_ps(va3, vb3, c33);
+		}
+
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _Reduce4(c00, c01, c02, c03)));
+		c += ldc;
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _Reduce4(c10, c11, c12, c13)));
+		c += ldc;
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _Reduce4(c20, c21, c22, c23)));
+		c += ldc;
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _Reduce4(c30, c31, c32, c33)));
+	}
+
+	void _ApplyGradient(float* values, float* pdC, float factor, size_t count)
+	{
+		const __m512 vf = _mm512_set1_ps(factor);
+		const __m512 zero = _mm512_setzero_ps();
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			_mm512_mask_storeu_ps(values + i, mask, _mm512_fnmadd_ps(vf, _mm512_maskz_loadu_ps(mask, pdC + i), _mm512_maskz_loadu_ps(mask, values + i)));
+			_mm512_mask_storeu_ps(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyMomentum(float* values, float* pdC, float* velocity, float gradientScale, float momentum, float gradientRate, float velocityRate, size_t count)
+	{
+		const __m512 vs = _mm512_set1_ps(gradientScale);
+		const __m512 vm = _mm512_set1_ps(momentum);
+		const __m512 vgr = _mm512_set1_ps(gradientRate);
+		const __m512 vvr = _mm512_set1_ps(velocityRate);
+		const __m512 zero = _mm512_setzero_ps();
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			const __m512 g = _mm512_mul_ps(vs, _mm512_maskz_loadu_ps(mask, pdC + i));
+			const __m512 v = _mm512_fmadd_ps(vm, _mm512_maskz_loadu_ps(mask, velocity + i), g);
+
+			_mm512_mask_storeu_ps(velocity + i, mask, v);
+			_mm512_mask_storeu_ps(values + i, mask, _mm512_fnmadd_ps(vgr, g, _mm512_fnmadd_ps(vvr, v, _mm512_maskz_loadu_ps(mask, values + i))));
+			_mm512_mask_storeu_ps(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyRMSProp(float* values, float* pdC, float* meanSquare, float gradientScale, float decay, float rate, float epsilon, size_t count)
+	{
+		const __m512 vs = _mm512_set1_ps(gradientScale);
+		const __m512 vd = _mm512_set1_ps(decay);
+		const __m512 vd1 = _mm512_set1_ps(1.f - decay);
+		const __m512 vr = _mm512_set1_ps(rate);
+		const __m512 ve = _mm512_set1_ps(epsilon);
+		const __m512 zero = _mm512_setzero_ps();
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			const __m512 g = _mm512_mul_ps(vs, _mm512_maskz_loadu_ps(mask, pdC + i));
+			const __m512 r = _mm512_fmadd_ps(vd, _mm512_maskz_loadu_ps(mask, meanSquare + i), _mm512_mul_ps(vd1, _mm512_mul_ps(g, g)));
+
+			_mm512_mask_storeu_ps(meanSquare + i, mask, r);
+			_mm512_mask_storeu_ps(values + i, mask, _mm512_fnmadd_ps(vr, _mm512_div_ps(g, _mm512_add_ps(_mm512_sqrt_ps(r), ve)), _mm512_maskz_loadu_ps(mask, values + i)));
+			_mm512_mask_storeu_ps(pdC + i, mask, zero);
+		}
+	}
+
+	void _ApplyAdam(float* values, float* pdC, float* firstMoment, float* secondMoment, float gradientScale, float beta1, float beta2, float rate, float epsilon, size_t count)
+	{
+		const __m512 vs = _mm512_set1_ps(gradientScale);
+		const __m512 vb1 = _mm512_set1_ps(beta1);
+		const __m512 vc1 = _mm512_set1_ps(1.f - beta1);
+		const __m512 vb2 = _mm512_set1_ps(beta2);
+		const __m512 vc2 = _mm512_set1_ps(1.f - beta2);
+		const __m512 vr = _mm512_set1_ps(rate);
+		const __m512 ve = _mm512_set1_ps(epsilon);
+		const __m512 zero = _mm512_setzero_ps();
+
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			const __m512 g = _mm512_mul_ps(vs, _mm512_maskz_loadu_ps(mask, pdC + i));
+			const __m512 m = _mm512_fmadd_ps(vb1, _mm512_maskz_loadu_ps(mask, firstMoment + i), _mm512_mul_ps(vc1, g));
+			const __m512 v = _mm512_fmadd_ps(vb2, _mm512_maskz_loadu_ps(mask, secondMoment + i), _mm512_mul_ps(vc2, _mm512_mul_ps(g, g)));
+
+			_mm512_mask_storeu_ps(firstMoment + i, mask, m);
+			_mm512_mask_storeu_ps(secondMoment + i, mask, v);
+			_mm512_mask_storeu_ps(values + i, mask, _mm512_fnmadd_ps(vr, _mm512_div_ps(m, _mm512_add_ps(_mm512_sqrt_ps(v), ve)), _mm512_maskz_loadu_ps(mask, values + i)));
+			_mm512_mask_storeu_ps(pdC + i, mask, zero);
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(float* z, const float* bias, float* a, size_t count, const ExpPolynomial& exp)
+	{
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			const __m512 vz = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, z + i), _mm512_maskz_loadu_ps(mask, bias + i));
+			_mm512_mask_storeu_ps(z + i, mask, vz);
+			_mm512_mask_storeu_ps(a + i, mask, ACTIVATION::Activate(vz, exp));
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(float* error, const float* a, size_t count)
+	{
+		for (size_t i = 0; i < count; i += 16)
+		{
+			const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : _TailMask16(count - i);
+
+			const __m512 va = _mm512_maskz_loadu_ps(mask, a + i);
+			_mm512_mask_storeu_ps(error + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, error + i), ACTIVATION::Prime(va)));
+		}
+	}
+
+	//Int8, widened to int16 so that vpmaddwd can multiply and add pairs into int32
+	//vpmaddwd on zmm needs AVX-512BW, which this table does not require, so this stays at ymm width
+	void _MatVecInt8(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+	{
+		for (size_t r = 0; r < rows; ++r)
+		{
+			const int8_t* row = a + r * cols;
+			__m256i acc0 = _mm256_setzero_si256();
+			__m256i acc1 = _mm256_setzero_si256();
+
+			size_t i = 0;
+			for (; i + 32 <= cols; i += 32)
+			{
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i)))));
+				acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i + 16))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i + 16)))));
+			}
+
+			for (; i + 16 <= cols; i += 16)
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(row + i))),
+					_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i)))));
+
+			const __m256i acc = _mm256_add_epi32(acc0, acc1);
+			__m128i h = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+			h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4E));
+			h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xB1));
+			int32_t sum = _mm_cvtsi128_si32(h);
+
+			for (; i < cols; ++i)
+				sum += (int32_t)row[i] * x[i];
+
+			y[r] = sum;
+		}
+	}
+
+	//Activation policies, _BiasActivate and _MulActivationPrime are instantiated once per policy so the activation is fixed at compile time
+	//Prime is the derivative in terms of the activation's output a
+	struct _SigmoidActivation
+	{
+		static __forceinline __m512d Activate(__m512d z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+		static __forceinline __m512 Activate(__m512 z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+
+		static __forceinline __m512d Prime(__m512d a) { return _mm512_fnmadd_pd(a, a, a); }
+		static __forceinline __m512 Prime(__m512 a) { return _mm512_fnmadd_ps(a, a, a); }
+	};
+
+	struct _ReluActivation
+	{
+		static __forceinline __m512d Activate(__m512d z, const ExpPolynomial&) { return _mm512_max_pd(z, _mm512_setzero_pd()); }
+		static __forceinline __m512 Activate(__m512 z, const ExpPolynomial&) { return _mm512_max_ps(z, _mm512_setzero_ps()); }
+
+		static __forceinline __m512d Prime(__m512d a) { return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_GT_OQ), _mm512_set1_pd(1.0)); }
+		static __forceinline __m512 Prime(__m512 a) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ), _mm512_set1_ps(1.f)); }
+	};
+
+	struct _LeakyReluActivation
+	{
+		static __forceinline __m512d Activate(__m512d z, const ExpPolynomial&) { return _mm512_max_pd(z, _mm512_mul_pd(z, _mm512_set1_pd(LEAKY_RELU_SLOPE))); }
+		static __forceinline __m512 Activate(__m512 z, const ExpPolynomial&) { return _mm512_max_ps(z, _mm512_mul_ps(z, _mm512_set1_ps((float)LEAKY_RELU_SLOPE))); }
+
+		static __forceinline __m512d Prime(__m512d a) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_GT_OQ), _mm512_set1_pd(LEAKY_RELU_SLOPE), _mm512_set1_pd(1.0)); }
+		static __forceinline __m512 Prime(__m512 a) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ), _mm512_set1_ps((float)LEAKY_RELU_SLOPE), _mm512_set1_ps(1.f)); }
+	};
+
+	//tanh(z) = 2 * sigmoid(2z) - 1
+	struct _TanhActivation
+	{
+		static __forceinline __m512d Activate(__m512d z, const ExpPolynomial& exp) { return _mm512_fmsub_pd(_mm512_set1_pd(2.0), _Sigmoid(_mm512_add_pd(z, z), exp), _mm512_set1_pd(1.0)); }
+		static __forceinline __m512 Activate(__m512 z, const ExpPolynomial& exp) { return _mm512_fmsub_ps(_mm512_set1_ps(2.f), _Sigmoid(_mm512_add_ps(z, z), exp), _mm512_set1_ps(1.f)); }
+
+		static __forceinline __m512d Prime(__m512d a) { return _mm512_fnmadd_pd(a, a, _mm512_set1_pd(1.0)); }
+		static __forceinline __m512 Prime(__m512 a) { return _mm512_fnmadd_ps(a, a, _mm512_set1_ps(1.f)); }
+	};
+}
+
+const KernelTable kernelsAVX512 =
+{
+	"AVX-512",
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	_MatVecInt8,
+	0.015
+};
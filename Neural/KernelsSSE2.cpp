@@ -0,0 +1,776 @@
+#include "KernelTable.hpp"
+#include <cmath>
+#include <emmintrin.h>
+
+/*
+	SSE2, 2 doubles or 4 floats per register, no FMA
+	Baseline for every x64 CPU, but not for Win32 builds so it still goes through CPUID
+*/
+
+namespace
+{
+	//{ sum(v0), sum(v1) }
+	__forceinline __m128d _Reduce2(__m128d v0, __m128d v1)
+	{
+		return _mm_add_pd(_mm_unpacklo_pd(v0, v1), _mm_unpackhi_pd(v0, v1));
+	}
+
+	//1 / (1 + exp(-z)), with exp done as a scaled polynomial
+	__forceinline __m128d _Sigmoid(__m128d z, const ExpPolynomial& exp)
+	{
+		const __m128d range = _mm_set1_pd(ExpPolynomial::SIGMOID_RANGE);
+		const __m128d bias = _mm_set1_pd(ExpPolynomial::ROUNDING_BIAS);
+		const __m128d one = _mm_set1_pd(1.0);
+
+		const __m128d x = _mm_min_pd(_mm_max_pd(z, _mm_sub_pd(_mm_setzero_pd(), range)), range);
+		const __m128d v = _mm_mul_pd(x, _mm_set1_pd(-ExpPolynomial::LOG2E));
+		const __m128d rounded = _mm_add_pd(v, bias);
+		const __m128d f = _mm_sub_pd(v, _mm_sub_pd(rounded, bias));
+
+		__m128d p = _mm_set1_pd(exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm_add_pd(_mm_mul_pd(p, f), _mm_set1_pd(exp.coefficients[i]));
+
+		//the integer part sits in the low mantissa bits of rounded, build 2^n directly from it
+		const __m128i n = _mm_sub_epi64(_mm_castpd_si128(rounded), _mm_castpd_si128(bias));
+		const __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(n, _mm_set1_epi64x(1023)), 52));
+
+		return _mm_div_pd(one, _mm_add_pd(_mm_mul_pd(p, scale), one));
+	}
+
+	double _Dot(const double* a, const double* b, size_t count)
+	{
+		__m128d s0 = _mm_setzero_pd();
+		__m128d s1 = _mm_setzero_pd();
+		__m128d s2 = _mm_setzero_pd();
+		__m128d s3 = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+			s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+			s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(a + i + 4), _mm_loadu_pd(b + i + 4)));
+			s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(a + i + 6), _mm_loadu_pd(b + i + 6)));
+		}
+
+		for (; i + 2 <= count; i += 2)
+			s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+
+		const __m128d s = _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3));
+		double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+
+		for (; i < count; ++i)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	void _Axpy(double alpha, const double* x, double* y, size_t count)
+	{
+		const __m128d va = _mm_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+			_mm_storeu_pd(y + i + 2, _mm_add_pd(_mm_loadu_pd(y + i + 2), _mm_mul_pd(va, _mm_loadu_pd(x + i + 2))));
+		}
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[i];
+	}
+
+	//SSE2 has no gather, the x elements are paired up by hand
+	double _SparseDot(const double* values, const uint32_t* indices, const double* x, size_t count)
+	{
+		__m128d s0 = _mm_setzero_pd();
+		__m128d s1 = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(values + i), _mm_set_pd(x[indices[i + 1]], x[indices[i]])));
+			s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(values + i + 2), _mm_set_pd(x[indices[i + 3]], x[indices[i + 2]])));
+		}
+
+		const __m128d s = _mm_add_pd(s0, s1);
+		double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+
+		for (; i < count; ++i)
+			sum += values[i] * x[indices[i]];
+
+		return sum;
+	}
+
+	void _SparseAxpy(double alpha, const double* x, const uint32_t* indices, double* y, size_t count)
+	{
+		const __m128d va = _mm_set1_pd(alpha);
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+			_mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_set_pd(x[indices[i + 1]], x[indices[i]]))));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[indices[i]];
+	}
+
+	void _Axpy4(const double* a, const double* const* b, double* c, size_t count)
+	{
+		const __m128d a0 = _mm_set1_pd(a[0]);
+		const __m128d a1 = _mm_set1_pd(a[1]);
+		const __m128d a2 = _mm_set1_pd(a[2]);
+		const __m128d a3 = _mm_set1_pd(a[3]);
+		const double* b0 = b[0];
+		const double* b1 = b[1];
+		const double* b2 = b[2];
+		const double* b3 = b[3];
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d s01 = _mm_add_pd(_mm_mul_pd(a0, _mm_loadu_pd(b0 + i)), _mm_mul_pd(a1, _mm_loadu_pd(b1 + i)));
+			const __m128d s23 = _mm_add_pd(_mm_mul_pd(a2, _mm_loadu_pd(b2 + i)), _mm_mul_pd(a3, _mm_loadu_pd(b3 + i)));
+			_mm_storeu_pd(c + i, _mm_add_pd(_mm_loadu_pd(c + i), _mm_add_pd(s01, s23)));
+		}
+
+		for (; i < count; ++i)
+			c[i] += a[0] * b0[i] + a[1] * b1[i] + a[2] * b2[i] + a[3] * b3[i];
+	}
+
+	//Two rows of a at a time so that the 8 accumulators + 6 operands fit in the 16 xmm registers
+	__forceinline void _TileABt2x4(const double* a, const double* b, double* c, size_t ldc, size_t k, size_t kc)
+	{
+		const double* a0 = a;
+		const double* a1 = a + k;
+		const double* b0 = b;
+		const double* b1 = b + k;
+		const double* b2 = b + 2 * k;
+		const double* b3 = b + 3 * k;
+
+		__m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd(), c02 = _mm_setzero_pd(), c03 = _mm_setzero_pd();
+		__m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd(), c12 = _mm_setzero_pd(), c13 = _mm_setzero_pd();
+
+		size_t p = 0;
+		for (; p + 2 <= kc; p += 2)
+		{
+			const __m128d va0 = _mm_loadu_pd(a0 + p);
+			const __m128d va1 = _mm_loadu_pd(a1 + p);
+			const __m128d vb0 = _mm_loadu_pd(b0 + p);
+			const __m128d vb1 = _mm_loadu_pd(b1 + p);
+			const __m128d vb2 = _mm_loadu_pd(b2 + p);
+			const __m128d vb3 = _mm_loadu_pd(b3 + p);
+
+			c00 = _mm_add_pd(c00, _mm_mul_pd(va0, vb0)); c01 = _mm_add_pd(c01, _mm_mul_pd(va0, vb1));
+			c02 = _mm_add_pd(c02, _mm_mul_pd(va0, vb2)); c03 = _mm_add_pd(c03, _mm_mul_pd(va0, vb3));
+			c10 = _mm_add_pd(c10, _mm_mul_pd(va1, vb0)); c11 = _mm_add_pd(c11, _mm_mul_pd(va1, vb1));
+			c12 = _mm_add_pd(c12, _mm_mul_pd(va1, vb2)); c13 = _mm_add_pd(c13, _mm_mul_pd(va1, vb3));
+		}
+
+		if (p < kc)
+		{
+			const __m128d va0 = _mm_load_sd(a0 + p);
+			const __m128d va1 = _mm_load_sd(a1 + p);
+			const __m128d vb0 = _mm_load_sd(b0 + p);
+			const __m128d vb1 = _mm_load_sd(b1 + p);
+			const __m128d vb2 = _mm_load_sd(b2 + p);
+			const __m128d vb3 = _mm_load_sd(b3 + p);
+
+			c00 = _mm_add_pd(c00, _mm_mul_pd(va0, vb0)); c01 = _mm_add_pd(c01, _mm_mul_pd(va0, vb1));
+			c02 = _mm_add_pd(c02, _mm_mul_pd(va0, vb2)); c03 = _mm_add_pd(c03, _mm_mul_pd(va0, vb3));
+			c10 = _mm_add_pd(c10, _mm_mul_pd(va1, vb0)); c11 = _mm_add_pd(c11, _mm_mul_pd(va1, vb1));
+			c12 = _mm_add_pd(c12, _mm_mul_pd(va1, vb2)); c13 = _mm_add_pd(c13, _mm_mul_pd(va1, vb3));
+		}
+
+		_mm_storeu_pd(c, _mm_add_pd(_mm_loadu_pd(c), _Reduce2(c00, c01)));
+		_mm_storeu_pd(c + 2, _mm_add_pd(_mm_loadu_pd(c + 2), _Reduce2(c02, c03)));
+		_mm_storeu_pd(c + ldc, _mm_add_pd(_mm_loadu_pd(c + ldc), _Reduce2(c10, c11)));
+		_mm_storeu_pd(c + ldc + 2, _mm_add_pd(_mm_loadu_pd(c + ldc + 2), _Reduce2(c12, c13)));
+	}
+
+	void _TileABt4x4(const double* a, const double* b, double* c, size_t ldc, size_t k, size_t kc)
+	{
+		_TileABt2x4(a, b, c, ldc, k, kc);
+		_TileABt2x4(a + 2 * k, b, c + 2 * ldc, ldc, k, kc);
+	}
+
+	void _ApplyGradient(double* values, double* pdC, double factor, size_t count)
+	{
+		const __m128d vf = _mm_set1_pd(factor);
+		const __m128d zero = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			_mm_storeu_pd(values + i, _mm_sub_pd(_mm_loadu_pd(values + i), _mm_mul_pd(vf, _mm_loadu_pd(pdC + i))));
+			_mm_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			values[i] -= factor * pdC[i];
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyMomentum(double* values, double* pdC, double* velocity, double gradientScale, double momentum, double gradientRate, double velocityRate, size_t count)
+	{
+		const __m128d vs = _mm_set1_pd(gradientScale);
+		const __m128d vm = _mm_set1_pd(momentum);
+		const __m128d vgr = _mm_set1_pd(gradientRate);
+		const __m128d vvr = _mm_set1_pd(velocityRate);
+		const __m128d zero = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d g = _mm_mul_pd(vs, _mm_loadu_pd(pdC + i));
+			const __m128d v = _mm_add_pd(_mm_mul_pd(vm, _mm_loadu_pd(velocity + i)), g);
+
+			_mm_storeu_pd(velocity + i, v);
+			_mm_storeu_pd(values + i, _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(values + i), _mm_mul_pd(vvr, v)), _mm_mul_pd(vgr, g)));
+			_mm_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			velocity[i] = momentum * velocity[i] + g;
+			values[i] -= gradientRate * g + velocityRate * velocity[i];
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyRMSProp(double* values, double* pdC, double* meanSquare, double gradientScale, double decay, double rate, double epsilon, size_t count)
+	{
+		const __m128d vs = _mm_set1_pd(gradientScale);
+		const __m128d vd = _mm_set1_pd(decay);
+		const __m128d vd1 = _mm_set1_pd(1.0 - decay);
+		const __m128d vr = _mm_set1_pd(rate);
+		const __m128d ve = _mm_set1_pd(epsilon);
+		const __m128d zero = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d g = _mm_mul_pd(vs, _mm_loadu_pd(pdC + i));
+			const __m128d r = _mm_add_pd(_mm_mul_pd(vd, _mm_loadu_pd(meanSquare + i)), _mm_mul_pd(vd1, _mm_mul_pd(g, g)));
+
+			_mm_storeu_pd(meanSquare + i, r);
+			_mm_storeu_pd(values + i, _mm_sub_pd(_mm_loadu_pd(values + i), _mm_mul_pd(vr, _mm_div_pd(g, _mm_add_pd(_mm_sqrt_pd(r), ve)))));
+			_mm_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			meanSquare[i] = decay * meanSquare[i] + (1.0 - decay) * g * g;
+			values[i] -= rate * g / (std::sqrt(meanSquare[i]) + epsilon);
+			pdC[i] = 0.0;
+		}
+	}
+
+	void _ApplyAdam(double* values, double* pdC, double* firstMoment, double* secondMoment, double gradientScale, double beta1, double beta2, double rate, double epsilon, size_t count)
+	{
+		const __m128d vs = _mm_set1_pd(gradientScale);
+		const __m128d vb1 = _mm_set1_pd(beta1);
+		const __m128d vc1 = _mm_set1_pd(1.0 - beta1);
+		const __m128d vb2 = _mm_set1_pd(beta2);
+		const __m128d vc2 = _mm_set1_pd(1.0 - beta2);
+		const __m128d vr = _mm_set1_pd(rate);
+		const __m128d ve = _mm_set1_pd(epsilon);
+		const __m128d zero = _mm_setzero_pd();
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d g = _mm_mul_pd(vs, _mm_loadu_pd(pdC + i));
+			const __m128d m = _mm_add_pd(_mm_mul_pd(vb1, _mm_loadu_pd(firstMoment + i)), _mm_mul_pd(vc1, g));
+			const __m128d v = _mm_add_pd(_mm_mul_pd(vb2, _mm_loadu_pd(secondMoment + i)), _mm_mul_pd(vc2, _mm_mul_pd(g, g)));
+
+			_mm_storeu_pd(firstMoment + i, m);
+			_mm_storeu_pd(secondMoment + i, v);
+			_mm_storeu_pd(values + i, _mm_sub_pd(_mm_loadu_pd(values + i), _mm_mul_pd(vr, _mm_div_pd(m, _mm_add_pd(_mm_sqrt_pd(v), ve)))));
+			_mm_storeu_pd(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const double g = gradientScale * pdC[i];
+			firstMoment[i] = beta1 * firstMoment[i] + (1.0 - beta1) * g;
+			secondMoment[i] = beta2 * secondMoment[i] + (1.0 - beta2) * g * g;
+			values[i] -= rate * firstMoment[i] / (std::sqrt(secondMoment[i]) + epsilon);
+			pdC[i] = 0.0;
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(double* z, const double* bias, double* a, size_t count, const ExpPolynomial& exp)
+	{
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d vz = _mm_add_pd(_mm_loadu_pd(z + i), _mm_loadu_pd(bias + i));
+			_mm_storeu_pd(z + i, vz);
+			_mm_storeu_pd(a + i, ACTIVATION::Activate(vz, exp));
+		}
+
+		if (i < count)
+		{
+			z[i] += bias[i];
+			_mm_store_sd(a + i, ACTIVATION::Activate(_mm_load_sd(z + i), exp));
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(double* error, const double* a, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d va = _mm_loadu_pd(a + i);
+			_mm_storeu_pd(error + i, _mm_mul_pd(_mm_loadu_pd(error + i), ACTIVATION::Prime(va)));
+		}
+
+		for (; i < count; ++i)
+			error[i] *= ACTIVATION::Prime(a[i]);
+	}
+
+	//Single precision, 4 floats per register
+
+	//{ sum(v0), sum(v1), sum(v2), sum(v3) }
+	__forceinline __m128 _Reduce4(__m128 v0, __m128 v1, __m128 v2, __m128 v3)
+	{
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+		return _mm_add_ps(_mm_add_ps(v0, v1), _mm_add_ps(v2, v3));
+	}
+
+	__forceinline __m128 _Sigmoid(__m128 z, const ExpPolynomial& exp)
+	{
+		const __m128 range = _mm_set1_ps((float)ExpPolynomial::SIGMOID_RANGE);
+		const __m128 bias = _mm_set1_ps(ExpPolynomial::ROUNDING_BIAS_F32);
+		const __m128 one = _mm_set1_ps(1.f);
+
+		const __m128 x = _mm_min_ps(_mm_max_ps(z, _mm_sub_ps(_mm_setzero_ps(), range)), range);
+		const __m128 v = _mm_mul_ps(x, _mm_set1_ps((float)-ExpPolynomial::LOG2E));
+		const __m128 rounded = _mm_add_ps(v, bias);
+		const __m128 f = _mm_sub_ps(v, _mm_sub_ps(rounded, bias));
+
+		__m128 p = _mm_set1_ps((float)exp.coefficients[exp.degree]);
+		for (int i = exp.degree - 1; i >= 0; --i)
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps((float)exp.coefficients[i]));
+
+		const __m128i n = _mm_sub_epi32(_mm_castps_si128(rounded), _mm_castps_si128(bias));
+		const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+
+		return _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(p, scale), one));
+	}
+
+	float _Dot(const float* a, const float* b, size_t count)
+	{
+		__m128 s0 = _mm_setzero_ps();
+		__m128 s1 = _mm_setzero_ps();
+		__m128 s2 = _mm_setzero_ps();
+		__m128 s3 = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+			s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+			s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+		}
+
+		for (; i + 4 <= count; i += 4)
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+		const __m128 s = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+		const __m128 h = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		float sum = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+
+		for (; i < count; ++i)
+			sum += a[i] * b[i];
+
+		return sum;
+	}
+
+	void _Axpy(float alpha, const float* x, float* y, size_t count)
+	{
+		const __m128 va = _mm_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+			_mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(va, _mm_loadu_ps(x + i + 4))));
+		}
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[i];
+	}
+
+	float _SparseDot(const float* values, const uint32_t* indices, const float* x, size_t count)
+	{
+		__m128 s0 = _mm_setzero_ps();
+		__m128 s1 = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(values + i), _mm_set_ps(x[indices[i + 3]], x[indices[i + 2]], x[indices[i + 1]], x[indices[i]])));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(values + i + 4), _mm_set_ps(x[indices[i + 7]], x[indices[i + 6]], x[indices[i + 5]], x[indices[i + 4]])));
+		}
+
+		const __m128 s = _mm_add_ps(s0, s1);
+		const __m128 h = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		float sum = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+
+		for (; i < count; ++i)
+			sum += values[i] * x[indices[i]];
+
+		return sum;
+	}
+
+	void _SparseAxpy(float alpha, const float* x, const uint32_t* indices, float* y, size_t count)
+	{
+		const __m128 va = _mm_set1_ps(alpha);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_set_ps(x[indices[i + 3]], x[indices[i + 2]], x[indices[i + 1]], x[indices[i]]))));
+
+		for (; i < count; ++i)
+			y[i] += alpha * x[indices[i]];
+	}
+
+	void _Axpy4(const float* a, const float* const* b, float* c, size_t count)
+	{
+		const __m128 a0 = _mm_set1_ps(a[0]);
+		const __m128 a1 = _mm_set1_ps(a[1]);
+		const __m128 a2 = _mm_set1_ps(a[2]);
+		const __m128 a3 = _mm_set1_ps(a[3]);
+		const float* b0 = b[0];
+		const float* b1 = b[1];
+		const float* b2 = b[2];
+		const float* b3 = b[3];
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 s01 = _mm_add_ps(_mm_mul_ps(a0, _mm_loadu_ps(b0 + i)), _mm_mul_ps(a1, _mm_loadu_ps(b1 + i)));
+			const __m128 s23 = _mm_add_ps(_mm_mul_ps(a2, _mm_loadu_ps(b2 + i)), _mm_mul_ps(a3, _mm_loadu_ps(b3 + i)));
+			_mm_storeu_ps(c + i, _mm_add_ps(_mm_loadu_ps(c + i), _mm_add_ps(s01, s23)));
+		}
+
+		for (; i < count; ++i)
+			c[i] += a[0] * b0[i] + a[1] * b1[i] + a[2] * b2[i] + a[3] * b3[i];
+	}
+
+	__forceinline void _TileABt2x4(const float* a, const float* b, float* c, size_t ldc, size_t k, size_t kc)
+	{
+		const float* a0 = a;
+		const float* a1 = a + k;
+		const float* b0 = b;
+		const float* b1 = b + k;
+		const float* b2 = b + 2 * k;
+		const float* b3 = b + 3 * k;
+
+		__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c02 = _mm_setzero_ps(), c03 = _mm_setzero_ps();
+		__m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps(), c12 = _mm_setzero_ps(), c13 = _mm_setzero_ps();
+
+		size_t p = 0;
+		for (; p + 4 <= kc; p += 4)
+		{
+			const __m128 va0 = _mm_loadu_ps(a0 + p);
+			const __m128 va1 = _mm_loadu_ps(a1 + p);
+			const __m128 vb0 = _mm_loadu_ps(b0 + p);
+			const __m128 vb1 = _mm_loadu_ps(b1 + p);
+			const __m128 vb2 = _mm_loadu_ps(b2 + p);
+			const __m128 vb3 = _mm_loadu_ps(b3 + p);
+
+			c00 = _mm_add_ps(c00, _mm_mul_ps(va0, vb0)); c01 = _mm_add_ps(c01, _mm_mul_ps(va0, vb1));
+			c02 = _mm_add_ps(c02, _mm_mul_ps(va0, vb2)); c03 = _mm_add_ps(c03, _mm_mul_ps(va0, vb3));
+			c10 = _mm_add_ps(c10, _mm_mul_ps(va1, vb0)); c11 = _mm_add_ps(c11, _mm_mul_ps(va1, vb1));
+			c12 = _mm_add_ps(c12, _mm_mul_ps(va1, vb2)); c13 = _mm_add_ps(c13, _mm_mul_ps(va1, vb3));
+		}
+
+		alignas(16) float r0[4];
+		alignas(16) float r1[4];
+		_mm_store_ps(r0, _Reduce4(c00, c01, c02, c03));
+		_mm_store_ps(r1, _Reduce4(c10, c11, c12, c13));
+
+		for (; p < kc; ++p)
+		{
+			r0[0] += a0[p] * b0[p]; r0[1] += a0[p] * b1[p]; r0[2] += a0[p] * b2[p]; r0[3] += a0[p] * b3[p];
+			r1[0] += a1[p] * b0[p]; r1[1] += a1[p] * b1[p]; r1[2] += a1[p] * b2[p]; r1[3] += a1[p] * b3[p];
+		}
+
+		_mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), _mm_load_ps(r0)));
+		_mm_storeu_ps(c + ldc, _mm_add_ps(_mm_loadu_ps(c + ldc), _mm_load_ps(r1)));
+	}
+
+	void _TileABt4x4(const float* a, const float* b, float* c, size_t ldc, size_t k, size_t kc)
+	{
+		_TileABt2x4(a, b, c, ldc, k, kc);
+		_TileABt2x4(a + 2 * k, b, c + 2 * ldc, ldc, k, kc);
+	}
+
+	void _ApplyGradient(float* values, float* pdC, float factor, size_t count)
+	{
+		const __m128 vf = _mm_set1_ps(factor);
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(values + i, _mm_sub_ps(_mm_loadu_ps(values + i), _mm_mul_ps(vf, _mm_loadu_ps(pdC + i))));
+			_mm_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			values[i] -= factor * pdC[i];
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyMomentum(float* values, float* pdC, float* velocity, float gradientScale, float momentum, float gradientRate, float velocityRate, size_t count)
+	{
+		const __m128 vs = _mm_set1_ps(gradientScale);
+		const __m128 vm = _mm_set1_ps(momentum);
+		const __m128 vgr = _mm_set1_ps(gradientRate);
+		const __m128 vvr = _mm_set1_ps(velocityRate);
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 g = _mm_mul_ps(vs, _mm_loadu_ps(pdC + i));
+			const __m128 v = _mm_add_ps(_mm_mul_ps(vm, _mm_loadu_ps(velocity + i)), g);
+
+			_mm_storeu_ps(velocity + i, v);
+			_mm_storeu_ps(values + i, _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(values + i), _mm_mul_ps(vvr, v)), _mm_mul_ps(vgr, g)));
+			_mm_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			velocity[i] = momentum * velocity[i] + g;
+			values[i] -= gradientRate * g + velocityRate * velocity[i];
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyRMSProp(float* values, float* pdC, float* meanSquare, float gradientScale, float decay, float rate, float epsilon, size_t count)
+	{
+		const __m128 vs = _mm_set1_ps(gradientScale);
+		const __m128 vd = _mm_set1_ps(decay);
+		const __m128 vd1 = _mm_set1_ps(1.f - decay);
+		const __m128 vr = _mm_set1_ps(rate);
+		const __m128 ve = _mm_set1_ps(epsilon);
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 g = _mm_mul_ps(vs, _mm_loadu_ps(pdC + i));
+			const __m128 r = _mm_add_ps(_mm_mul_ps(vd, _mm_loadu_ps(meanSquare + i)), _mm_mul_ps(vd1, _mm_mul_ps(g, g)));
+
+			_mm_storeu_ps(meanSquare + i, r);
+			_mm_storeu_ps(values + i, _mm_sub_ps(_mm_loadu_ps(values + i), _mm_mul_ps(vr, _mm_div_ps(g, _mm_add_ps(_mm_sqrt_ps(r), ve)))));
+			_mm_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			meanSquare[i] = decay * meanSquare[i] + (1.f - decay) * g * g;
+			values[i] -= rate * g / (std::sqrt(meanSquare[i]) + epsilon);
+			pdC[i] = 0.f;
+		}
+	}
+
+	void _ApplyAdam(float* values, float* pdC, float* firstMoment, float* secondMoment, float gradientScale, float beta1, float beta2, float rate, float epsilon, size_t count)
+	{
+		const __m128 vs = _mm_set1_ps(gradientScale);
+		const __m128 vb1 = _mm_set1_ps(beta1);
+		const __m128 vc1 = _mm_set1_ps(1.f - beta1);
+		const __m128 vb2 = _mm_set1_ps(beta2);
+		const __m128 vc2 = _mm_set1_ps(1.f - beta2);
+		const __m128 vr = _mm_set1_ps(rate);
+		const __m128 ve = _mm_set1_ps(epsilon);
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 g = _mm_mul_ps(vs, _mm_loadu_ps(pdC + i));
+			const __m128 m = _mm_add_ps(_mm_mul_ps(vb1, _mm_loadu_ps(firstMoment + i)), _mm_mul_ps(vc1, g));
+			const __m128 v = _mm_add_ps(_mm_mul_ps(vb2, _mm_loadu_ps(secondMoment + i)), _mm_mul_ps(vc2, _mm_mul_ps(g, g)));
+
+			_mm_storeu_ps(firstMoment + i, m);
+			_mm_storeu_ps(secondMoment + i, v);
+			_mm_storeu_ps(values + i, _mm_sub_ps(_mm_loadu_ps(values + i), _mm_mul_ps(vr, _mm_div_ps(m, _mm_add_ps(_mm_sqrt_ps(v), ve)))));
+			_mm_storeu_ps(pdC + i, zero);
+		}
+
+		for (; i < count; ++i)
+		{
+			const float g = gradientScale * pdC[i];
+			firstMoment[i] = beta1 * firstMoment[i] + (1.f - beta1) * g;
+			secondMoment[i] = beta2 * secondMoment[i] + (1.f - beta2) * g * g;
+			values[i] -= rate * firstMoment[i] / (std::sqrt(secondMoment[i]) + epsilon);
+			pdC[i] = 0.f;
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _BiasActivate(float* z, const float* bias, float* a, size_t count, const ExpPolynomial& exp)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 vz = _mm_add_ps(_mm_loadu_ps(z + i), _mm_loadu_ps(bias + i));
+			_mm_storeu_ps(z + i, vz);
+			_mm_storeu_ps(a + i, ACTIVATION::Activate(vz, exp));
+		}
+
+		if (i < count)
+		{
+			alignas(16) float tail[4] = {};
+			for (size_t j = i; j < count; ++j)
+				tail[j - i] = z[j] += bias[j];
+
+			_mm_store_ps(tail, ACTIVATION::Activate(_mm_load_ps(tail), exp));
+
+			for (size_t j = i; j < count; ++j)
+				a[j] = tail[j - i];
+		}
+	}
+
+	template <typename ACTIVATION>
+	void _MulActivationPrime(float* error, const float* a, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 va = _mm_loadu_ps(a + i);
+			_mm_storeu_ps(error + i, _mm_mul_ps(_mm_loadu_ps(error + i), ACTIVATION::Prime(va)));
+		}
+
+		for (; i < count; ++i)
+			error[i] *= ACTIVATION::Prime(a[i]);
+	}
+
+	//Int8, widened to int16 so that pmaddwd can multiply and add pairs into int32
+
+	//sign extends the low/high 8 bytes of v to int16
+	__forceinline __m128i _WidenLo(__m128i v) { return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8); }
+	__forceinline __m128i _WidenHi(__m128i v) { return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8); }
+
+	void _MatVecInt8(const int8_t* a, const int8_t* x, int32_t* y, size_t rows, size_t cols)
+	{
+		for (size_t r = 0; r < rows; ++r)
+		{
+			const int8_t* row = a + r * cols;
+			__m128i acc0 = _mm_setzero_si128();
+			__m128i acc1 = _mm_setzero_si128();
+
+			size_t i = 0;
+			for (; i + 16 <= cols; i += 16)
+			{
+				const __m128i va = _mm_loadu_si128((const __m128i*)(row + i));
+				const __m128i vx = _mm_loadu_si128((const __m128i*)(x + i));
+				acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_WidenLo(va), _WidenLo(vx)));
+				acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_WidenHi(va), _WidenHi(vx)));
+			}
+
+			__m128i acc = _mm_add_epi32(acc0, acc1);
+			acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4E));
+			acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xB1));
+			int32_t sum = _mm_cvtsi128_si32(acc);
+
+			for (; i < cols; ++i)
+				sum += (int32_t)row[i] * x[i];
+
+			y[r] = sum;
+		}
+	}
+
+	//Activation policies, _BiasActivate and _MulActivationPrime are instantiated once per policy so the activation is fixed at compile time
+	//Prime is the derivative in terms of the activation's output a, with scalar versions for the tails
+	struct _SigmoidActivation
+	{
+		static __forceinline __m128d Activate(__m128d z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+		static __forceinline __m128 Activate(__m128 z, const ExpPolynomial& exp) { return _Sigmoid(z, exp); }
+
+		static __forceinline __m128d Prime(__m128d a) { return _mm_mul_pd(a, _mm_sub_pd(_mm_set1_pd(1.0), a)); }
+		static __forceinline __m128 Prime(__m128 a) { return _mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.f), a)); }
+		static __forceinline double Prime(double a) { return a * (1.0 - a); }
+		static __forceinline float Prime(float a) { return a * (1.f - a); }
+	};
+
+	struct _ReluActivation
+	{
+		static __forceinline __m128d Activate(__m128d z, const ExpPolynomial&) { return _mm_max_pd(z, _mm_setzero_pd()); }
+		static __forceinline __m128 Activate(__m128 z, const ExpPolynomial&) { return _mm_max_ps(z, _mm_setzero_ps()); }
+
+		static __forceinline __m128d Prime(__m128d a) { return _mm_and_pd(_mm_cmpgt_pd(a, _mm_setzero_pd()), _mm_set1_pd(1.0)); }
+		static __forceinline __m128 Prime(__m128 a) { return _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), _mm_set1_ps(1.f)); }
+		static __forceinline double Prime(double a) { return a > 0.0 ? 1.0 : 0.0; }
+		static __forceinline float Prime(float a) { return a > 0.f ? 1.f : 0.f; }
+	};
+
+	struct _LeakyReluActivation
+	{
+		static __forceinline __m128d Activate(__m128d z, const ExpPolynomial&) { return _mm_max_pd(z, _mm_mul_pd(z, _mm_set1_pd(LEAKY_RELU_SLOPE))); }
+		static __forceinline __m128 Activate(__m128 z, const ExpPolynomial&) { return _mm_max_ps(z, _mm_mul_ps(z, _mm_set1_ps((float)LEAKY_RELU_SLOPE))); }
+
+		//no blendv before SSE4.1, select with and/andnot
+		static __forceinline __m128d Prime(__m128d a)
+		{
+			const __m128d positive = _mm_cmpgt_pd(a, _mm_setzero_pd());
+			return _mm_or_pd(_mm_and_pd(positive, _mm_set1_pd(1.0)), _mm_andnot_pd(positive, _mm_set1_pd(LEAKY_RELU_SLOPE)));
+		}
+
+		static __forceinline __m128 Prime(__m128 a)
+		{
+			const __m128 positive = _mm_cmpgt_ps(a, _mm_setzero_ps());
+			return _mm_or_ps(_mm_and_ps(positive, _mm_set1_ps(1.f)), _mm_andnot_ps(positive, _mm_set1_ps((float)LEAKY_RELU_SLOPE)));
+		}
+
+		static __forceinline double Prime(double a) { return a > 0.0 ? 1.0 : LEAKY_RELU_SLOPE; }
+		static __forceinline float Prime(float a) { return a > 0.f ? 1.f : (float)LEAKY_RELU_SLOPE; }
+	};
+
+	//tanh(z) = 2 * sigmoid(2z) - 1
+	struct _TanhActivation
+	{
+		static __forceinline __m128d Activate(__m128d z, const ExpPolynomial& exp) { return _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(2.0), _Sigmoid(_mm_add_pd(z, z), exp)), _mm_set1_pd(1.0)); }
+		static __forceinline __m128 Activate(__m128 z, const ExpPolynomial& exp) { return _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.f), _Sigmoid(_mm_add_ps(z, z), exp)), _mm_set1_ps(1.f)); }
+
+		static __forceinline __m128d Prime(__m128d a) { return _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(a, a)); }
+		static __forceinline __m128 Prime(__m128 a) { return _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(a, a)); }
+		static __forceinline double Prime(double a) { return 1.0 - a * a; }
+		static __forceinline float Prime(float a) { return 1.f - a * a; }
+	};
+}
+
+const KernelTable kernelsSSE2 =
+{
+	"SSE2",
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	{
+		_Dot, _Axpy, _Axpy4, _SparseDot, _SparseAxpy, _TileABt4x4, _ApplyGradient, _ApplyMomentum, _ApplyRMSProp, _ApplyAdam,
+		{ _BiasActivate<_SigmoidActivation>, _BiasActivate<_ReluActivation>, _BiasActivate<_LeakyReluActivation>, _BiasActivate<_TanhActivation> },
+		{ _MulActivationPrime<_SigmoidActivation>, _MulActivationPrime<_ReluActivation>, _MulActivationPrime<_LeakyReluActivation>, _MulActivationPrime<_TanhActivation> }
+	},
+	_MatVecInt8,
+	0.07
+};
@@ -1,17 +1,23 @@
 #include "LabelsIDX1.hpp"
+#include "IDXHeader.hpp"
 #include <ELCore/ByteReader.hpp>
 #include <ELCore/ByteWriter.hpp>
 #include <ELSys/Debug.hpp>
 
 bool LabelsIDX1::Read(ByteReader& reader)
 {
-	if (reader.Read_uint32() != 2049)
+	if (reader.Read_uint32() != IDX::LABELS_MAGIC)
 	{
 		Debug::Error("IDX1 magic number incorrect!");
 		return false;
 	}
 
+	_file.Close();
+
 	_labels.SetSize(reader.Read_uint32());
+	_data = _labels.Data();
+	_count = (uint32)_labels.GetSize();
+
 	if (reader.Read(_labels.Data(), _labels.GetSize()) != _labels.GetSize())
 	{
 		Debug::Error("Bad IDX1 file");
@@ -21,10 +27,46 @@ bool LabelsIDX1::Read(ByteReader& reader)
 	return true;
 }
 
+bool LabelsIDX1::Map(const char* filename, MappedFile::Access access)
+{
+	MappedFile file;
+	if (!file.Open(filename, access))
+	{
+		Debug::Error("Could not map IDX1 file");
+		return false;
+	}
+
+	uint32 count;
+	if (!IDX::ParseLabels(file.GetData(), file.GetSize(), count))
+		return false;
+
+	_labels.Clear();
+	_file = std::move(file);
+	_data = _file.GetData() + IDX::LABELS_HEADER_SIZE;
+	_count = count;
+	return true;
+}
+
+void LabelsIDX1::AddLabel(byte label)
+{
+	if (_file.IsOpen())
+	{
+		_labels.SetSize(_count);
+		for (uint32 i = 0; i < _count; ++i)
+			_labels[i] = _data[i];
+
+		_file.Close();
+	}
+
+	_labels.Emplace(label);
+	_data = _labels.Data();
+	_count = (uint32)_labels.GetSize();
+}
+
 void LabelsIDX1::Write(ByteWriter& writer)
 {
-	writer.EnsureSpace(2 * 4 + _labels.GetSize());
+	writer.EnsureSpace(2 * 4 + _count);
 	writer.Write_uint32(2049);
-	writer.Write_uint32(_labels.GetSize());
-	writer.Write(_labels.Data(), _labels.GetSize());
+	writer.Write_uint32(_count);
+	writer.Write(_data, _count);
 }
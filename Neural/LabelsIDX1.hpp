@@ -1,16 +1,27 @@
 #pragma once
+#include "MappedFile.hpp"
 #include <ELCore/Buffer.hpp>
 
 class LabelsIDX1
 {
-	Buffer<byte> _labels;
+	Buffer<byte> _labels;		//Copied in by Read, and any added
+
+	MappedFile _file;			//Or served straight from the file by Map, until a label is added
+	const byte* _data;			//[_count], into one of the above
+	uint32 _count;
 
 public:
+	LabelsIDX1() : _data(nullptr), _count(0) {}
+
 	bool Read(class ByteReader&);
 	void Write(class ByteWriter&);
 
-	uint32 GetCount() const { return _labels.GetSize(); }
-	byte GetLabel(uint32 index) const { return _labels[index]; }
+	//Maps filename instead of reading it, see ImagesIDX3::Map
+	bool Map(const char* filename, MappedFile::Access access);
+
+	uint32 GetCount() const { return _count; }
+	byte GetLabel(uint32 index) const { return _data[index]; }
 
-	void AddLabel(byte label) { _labels.Emplace(label); }
+	//Copies mapped labels into memory first
+	void AddLabel(byte label);
 };
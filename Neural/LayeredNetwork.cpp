@@ -1,351 +1,1901 @@
 #include "LayeredNetwork.hpp"
+#include "Kernels.hpp"
+#include "TaskScheduler.hpp"
 #include <ELCore/ByteReader.hpp>
 #include <ELCore/ByteWriter.hpp>
 #include <ELMaths/Maths.hpp>
 #include <ELMaths/Random.hpp>
 #include <ELSys/Debug.hpp>
+#include <algorithm>
+#include <cmath>
 
-__forceinline double Activate(double x)
+template <typename T>
+T _ReadScalar(ByteReader& reader, uint32 scalarSize)
 {
-	//sigmoid 
-	return 1.0 / (1.0 + Maths::Exp(-x));
+	return scalarSize == sizeof(float) ? (T)reader.Read_float() : (T)reader.Read_double();
 }
 
-double ActivatePrime(double x)
+void _WriteScalar(ByteWriter& writer, float value) { writer.Write_float(value); }
+void _WriteScalar(ByteWriter& writer, double value) { writer.Write_double(value); }
+
+template <typename T>
+bool LayeredNetworkT<T>::Layer::_GetWindowShape(LinkingType linkType, const Shape& input, const Window& window, Shape& output)
+{
+	if (!_IsWindowed(linkType) || window.size == 0 || window.stride == 0 || (linkType == LinkingType::CONV ? window.channels == 0 : window.padding != 0))
+		return false;
+
+	if (input.width + 2 * window.padding < window.size || input.height + 2 * window.padding < window.size)
+		return false;
+
+	output.width = (input.width + 2 * window.padding - window.size) / window.stride + 1;
+	output.height = (input.height + 2 * window.padding - window.size) / window.stride + 1;
+	output.channels = linkType == LinkingType::CONV ? window.channels : input.channels;
+	return true;
+}
+
+template <typename T>
+int LayeredNetworkT<T>::Layer::_GetPreviousLayer() const
+{
+	int prevLayer = -1;
+
+	for (int i = 0; i < _network->_layers.GetSize() - 1; ++i)
+		if (&_network->_layers[i + 1] == this)
+		{
+			prevLayer = i;
+			break;
+		}
+
+	if (prevLayer == 0)
+	{
+		//we are the output layer
+
+		if (_network->_layers.GetSize() > 2)
+			return _network->_layers.GetSize() - 1;
+	}
+	else if (prevLayer == 1)
+	{
+		//we are the first mid layer
+
+		return 0;
+	}
+	else if (prevLayer > 1)
+		return prevLayer;
+
+	return -1;
+}
+
+template <typename T>
+size_t LayeredNetworkT<T>::Layer::_GetKernelSize() const
 {
-	//first derivative of sigmoid
-	double sig = Activate(x);
-	return sig * (1.0 - sig);
+	return _inputs.GetSize() ? _window.size * _window.size * _network->_layers[_inputs[0].layer]._shape.channels : 0;
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::_SetInputs(const int* layers, size_t count)
+{
+	_inputs.SetSize(count);
+	_inputCount = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		Input& input = _inputs[i];
+		input.layer = layers[i];
+		input.count = _network->_layers[layers[i]]._size;
+		input.offset = _size * _inputCount;
+		input.rows.Clear();
+		input.columns.Clear();
+
+		_inputCount += input.count;
+	}
+
+	//CONV layers share one kernel and bias per channel over the whole plane, pooling layers have no parameters
+	const bool windowed = count && _IsWindowed(_linkType);
+
+	_weights.Clear();
+	_weights.SetSize(windowed ? (_linkType == LinkingType::CONV ? _window.channels * _GetKernelSize() : 0) : _size * _inputCount);
+
+	_biases.Clear();
+	_biases.SetSize(windowed ? (_linkType == LinkingType::CONV ? _window.channels : 0) : _size);
+
+	_network->_CompilePlan();
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::Generate(const Shape& shape)
+{
+	_shape = shape;
+	_size = shape.GetSize();
+
+	if (_IsWindowed(_linkType))
+		_linkType = LinkingType::ALL;
+
+	if (_inputs.GetSize() == 0 && _linkType != LinkingType::NONE)
+	{
+		SetInputLinkType(_linkType);
+		return;
+	}
+
+	//keep the same inputs, reshaped for the new size
+	Buffer<int> inputs;
+	inputs.SetSize(_inputs.GetSize());
+	for (size_t i = 0; i < _inputs.GetSize(); ++i)
+		inputs[i] = _inputs[i].layer;
+
+	_SetInputs(inputs.Data(), inputs.GetSize());
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::SetInputLinkType(LinkingType linkType)
+{
+	//a window that does not fit leaves the layer unlinked
+	if (_IsWindowed(linkType))
+	{
+		if (!SetInputWindow(linkType, _window))
+		{
+			_linkType = LinkingType::NONE;
+			_SetInputs(nullptr, 0);
+		}
+
+		return;
+	}
+
+	_linkType = linkType;
+
+	if (linkType == LinkingType::ALL)
+	{
+		const int inputLayer = _GetPreviousLayer();
+
+		if (inputLayer >= 0)
+		{
+			_SetInputs(&inputLayer, 1);
+			return;
+		}
+	}
+		
+	_SetInputs(nullptr, 0);
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::Layer::SetInputWindow(LinkingType linkType, const Window& window)
+{
+	const int inputLayer = _GetPreviousLayer();
+
+	Shape shape;
+	if (inputLayer < 0 || !_GetWindowShape(linkType, _network->_layers[inputLayer]._shape, window, shape))
+		return false;
+
+	_linkType = linkType;
+	_window = window;
+	_shape = shape;
+	_size = shape.GetSize();
+
+	_SetInputs(&inputLayer, 1);
+	return true;
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::Layer::AddInput(size_t layer)
+{
+	if (layer >= _network->_layers.GetSize() || _IsWindowed(_linkType))
+		return false;
+
+	for (const Input& input : _inputs)
+		if (input.layer == (int)layer)
+			return false;
+
+	const size_t index = _inputs.GetSize();
+	_inputs.SetSize(index + 1);
+
+	Input& input = _inputs[index];
+	input.layer = (int)layer;
+	input.count = _network->_layers[layer]._size;
+	input.offset = _weights.GetSize();
+	input.rows.Clear();
+	input.columns.Clear();
+
+	//blocks are stored one after another, so the existing weights stay where they are
+	_inputCount += input.count;
+	_weights.SetSize(input.offset + _size * input.count);
+	_linkType = LinkingType::ALL;
+
+	if (!_network->_CompilePlan())
+	{
+		_inputCount -= _inputs[index].count;
+		_weights.SetSize(_inputs[index].offset);
+		_inputs.SetSize(index);
+
+		_network->_CompilePlan();
+		return false;
+	}
+
+	return true;
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::Layer::SetResidualLayer(int layer)
+{
+	if (layer >= (int)_network->_layers.GetSize() || (layer >= 0 && _network->_layers[layer]._size != _size))
+		return false;
+
+	const int previous = _residualLayer;
+	_residualLayer = layer < 0 ? -1 : layer;
+
+	if (!_network->_CompilePlan())
+	{
+		_residualLayer = previous;
+		_network->_CompilePlan();
+		return false;
+	}
+
+	return true;
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::Layer::IsSparse() const
+{
+	for (const Input& input : _inputs)
+		if (input.IsSparse())
+			return true;
+
+	return false;
+}
+
+template <typename T>
+size_t LayeredNetworkT<T>::Layer::_Prune(T threshold, size_t& ties)
+{
+	//pruning only ever shrinks the blocks, so the new weights fit in the old size
+	AlignedBuffer<T> weights;
+	weights.SetSize(_weights.GetSize());
+
+	size_t count = 0;
+	size_t dropped = 0;
+
+	for (Input& input : _inputs)
+	{
+		const T* block = _weights.Data() + input.offset;
+		const size_t begin = count;
+		size_t blockDropped = 0;
+
+		AlignedBuffer<uint32> rows;
+		AlignedBuffer<uint32> columns;
+		rows.SetSize(_size + 1);
+		columns.SetSize(_GetBlockWeightCount(input));
+
+		for (size_t n = 0; n < _size; ++n)
+		{
+			rows[n] = (uint32)(count - begin);
+
+			const size_t first = input.IsSparse() ? input.rows[n] : n * input.count;
+			const size_t last = input.IsSparse() ? input.rows[n + 1] : (n + 1) * input.count;
+
+			for (size_t j = first; j < last; ++j)
+			{
+				const T magnitude = block[j] < 0 ? -block[j] : block[j];
+
+				bool drop = magnitude < threshold;
+				if (magnitude == threshold && ties > 0)
+				{
+					drop = true;
+					--ties;
+				}
+
+				if (drop)
+				{
+					++blockDropped;
+					continue;
+				}
+
+				columns[count - begin] = input.IsSparse() ? input.columns[j] : (uint32)(j - first);
+				weights[count++] = block[j];
+			}
+		}
+
+		rows[_size] = (uint32)(count - begin);
+		input.offset = begin;
+
+		//a dense block that lost nothing was copied as it was and stays dense
+		if (blockDropped || input.IsSparse())
+		{
+			columns.SetSize(count - begin);
+			input.rows = std::move(rows);
+			input.columns = std::move(columns);
+		}
+
+		dropped += blockDropped;
+	}
+
+	weights.SetSize(count);
+	_weights = std::move(weights);
+	return dropped;
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::_RemoveNeurons(const Buffer<bool>& keep)
+{
+	size_t kept = 0;
+	for (size_t n = 0; n < _size; ++n)
+		kept += keep[n] ? 1 : 0;
+
+	AlignedBuffer<T> weights;
+	weights.SetSize(_weights.GetSize());
+	size_t count = 0;
+
+	for (Input& input : _inputs)
+	{
+		const T* block = _weights.Data() + input.offset;
+		const size_t begin = count;
+
+		if (input.IsSparse())
+		{
+			AlignedBuffer<uint32> rows;
+			AlignedBuffer<uint32> columns;
+			rows.SetSize(kept + 1);
+			columns.SetSize(input.columns.GetSize());
+
+			size_t row = 0;
+			for (size_t n = 0; n < _size; ++n)
+			{
+				if (!keep[n]) continue;
+
+				rows[row++] = (uint32)(count - begin);
+				for (size_t j = input.rows[n]; j < input.rows[n + 1]; ++j)
+				{
+					columns[count - begin] = input.columns[j];
+					weights[count++] = block[j];
+				}
+			}
+
+			rows[kept] = (uint32)(count - begin);
+			columns.SetSize(count - begin);
+			input.rows = std::move(rows);
+			input.columns = std::move(columns);
+		}
+		else
+		{
+			for (size_t n = 0; n < _size; ++n)
+				if (keep[n])
+					for (size_t i = 0; i < input.count; ++i)
+						weights[count++] = block[n * input.count + i];
+		}
+
+		input.offset = begin;
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < _size; ++i)
+		if (keep[i])
+			_biases[n++] = _biases[i];
+
+	weights.SetSize(count);
+	_weights = std::move(weights);
+	_biases.SetSize(kept);
+
+	_size = kept;
+	_shape = Shape(kept);
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::_RemoveInputNeurons(size_t input, const Buffer<bool>& keep)
+{
+	Input& target = _inputs[input];
+
+	//new index of each kept input neuron
+	Buffer<uint32> remap;
+	remap.SetSize(target.count);
+
+	size_t kept = 0;
+	for (size_t i = 0; i < target.count; ++i)
+	{
+		remap[i] = (uint32)kept;
+		kept += keep[i] ? 1 : 0;
+	}
+
+	AlignedBuffer<T> weights;
+	weights.SetSize(_weights.GetSize());
+	size_t count = 0;
+
+	for (Input& in : _inputs)
+	{
+		const T* block = _weights.Data() + in.offset;
+		const size_t begin = count;
+
+		if (&in != &target)
+		{
+			for (size_t j = 0; j < _GetBlockWeightCount(in); ++j)
+				weights[count++] = block[j];
+		}
+		else if (in.IsSparse())
+		{
+			//rows and columns are rewritten in place, an entry never moves later than where it was
+			for (size_t n = 0; n < _size; ++n)
+			{
+				const size_t first = in.rows[n];
+				in.rows[n] = (uint32)(count - begin);
+
+				for (size_t j = first; j < in.rows[n + 1]; ++j)
+					if (keep[in.columns[j]])
+					{
+						in.columns[count - begin] = remap[in.columns[j]];
+						weights[count++] = block[j];
+					}
+			}
+
+			in.rows[_size] = (uint32)(count - begin);
+			in.columns.SetSize(count - begin);
+		}
+		else
+		{
+			for (size_t n = 0; n < _size; ++n)
+				for (size_t i = 0; i < in.count; ++i)
+					if (keep[i])
+						weights[count++] = block[n * in.count + i];
+		}
+
+		in.offset = begin;
+	}
+
+	_inputCount -= target.count - kept;
+	target.count = kept;
+
+	weights.SetSize(count);
+	_weights = std::move(weights);
+}
+
+template <typename T>
+void LayeredNetworkT<T>::Layer::RandomiseWeightsAndBiases(Random& random)
+{
+	//Sigmoid layers keep weights and biases in [-1, 1]
+	//The unsaturating activations would blow up with that over a wide input, so their weights are scaled to the fan in
+	//(uniform He for the ReLUs, LeCun for tanh) and their biases start at 0
+	//A CONV neuron only sees one kernel's worth of inputs
+	const size_t fanIn = _linkType == LinkingType::CONV ? _GetKernelSize() : _inputCount;
+
+	double weightRange = 1.0;
+	double biasRange = 1.0;
+
+	if (_activation != Activation::SIGMOID && fanIn > 0)
+	{
+		weightRange = std::sqrt((_activation == Activation::TANH ? 3.0 : 6.0) / (double)fanIn);
+		biasRange = 0.0;
+	}
+
+	if (_IsWindowed(_linkType))
+	{
+		//one bias and kernel per channel, nothing at all for pooling
+		for (size_t c = 0; c < _biases.GetSize(); ++c)
+		{
+			_biases[c] = (T)((random.NextDouble() * 2.0 - 1.0) * biasRange);
+
+			T* w = _weights.Data() + c * fanIn;
+			for (size_t i = 0; i < fanIn; ++i)
+				w[i] = (T)((random.NextDouble() * 2.0 - 1.0) * weightRange);
+		}
+
+		return;
+	}
+
+	for (size_t n = 0; n < _size; ++n)
+	{
+		_biases[n] = (T)((random.NextDouble() * 2.0 - 1.0) * biasRange);
+
+		//sparse blocks keep their pruned weights at 0
+		for (const Input& input : _inputs)
+		{
+			T* w = _weights.Data() + input.offset + (input.IsSparse() ? input.rows[n] : n * input.count);
+			const size_t count = input.IsSparse() ? input.rows[n + 1] - input.rows[n] : input.count;
+
+			for (size_t i = 0; i < count; ++i)
+				w[i] = (T)((random.NextDouble() * 2.0 - 1.0) * weightRange);
+		}
+	}
+}
+
+template <typename T>
+LayeredNetworkT<T>::LayeredNetworkT() : _cost(Cost::QUADRATIC), _optimizerSteps(0), _scheduler(nullptr)
+{
+	//todo jank
+	_layers.SetSize(2);
+
+	_layers[0]._network = this;
+	_layers[1]._network = this;
+
+	_CompilePlan();
+}
+
+template <typename T>
+LayeredNetworkT<T>::LayeredNetworkT(ByteReader& reader) : _cost(Cost::QUADRATIC), _optimizerSteps(0), _scheduler(nullptr)
+{
+	uint32 version = reader.Read_uint32();
+
+	std::cout << "Reading netfile...\n";
+
+	if (version < 1 || version > 7)
+	{
+		Debug::Error("Invalid netfile");
+		throw 1;
+	}
+
+	//version 1 files are always double precision
+	const uint32 scalarSize = version >= 2 ? reader.Read_uint16() : (uint32)sizeof(double);
+	if (scalarSize != sizeof(float) && scalarSize != sizeof(double))
+	{
+		Debug::Error("Invalid netfile (unknown precision)");
+		throw 5;
+	}
+
+	std::cout << "Precision: " << (scalarSize == sizeof(float) ? "float" : "double") << '\n';
+
+	uint32 layerCount = reader.Read_uint32();
+	std::cout << "LayerCount: " << layerCount << '\n';
+
+	if (layerCount < 2)
+	{
+		Debug::Error("Invalid netfile (degenerate layer count)");
+		throw 2;
+	}
+
+	//versions before 4 only had the quadratic cost
+	if (version >= 4)
+	{
+		_cost = (Cost)reader.Read_uint16();
+		if (_cost != Cost::QUADRATIC && _cost != Cost::SOFTMAX_CROSS_ENTROPY)
+		{
+			Debug::Error("Invalid netfile (unknown cost function)");
+			throw 7;
+		}
+
+		std::cout << "Cost: " << (_cost == Cost::QUADRATIC ? "quadratic" : "softmax cross-entropy") << '\n';
+	}
+
+	_layers.SetSize(layerCount);
+
+	for (uint32 i = 0; i < layerCount; ++i)
+	{
+		_layers[i]._network = this;
+
+		//version 6 stores the shape, older versions only the size
+		if (version >= 6)
+		{
+			Shape shape;
+			shape.width = reader.Read_uint32();
+			shape.height = reader.Read_uint32();
+			shape.channels = reader.Read_uint32();
+			_layers[i].Generate(shape);
+		}
+		else
+			_layers[i].Generate(reader.Read_uint32());
+		
+		std::cout << "Layer " << i << ": " << _layers[i]._size << " neurons\n";
+	}
+
+	if (version >= 3)
+	{
+		//per layer: link type, activation (version 5), window (version 6, CONV and pooling), inputs, residual layer, then biases and weight blocks
+		//From version 7 each block of a fully connected layer starts with its storage, dense or CSR
+		for (Layer& layer : _layers)
+		{
+			layer._linkType = (LinkingType)reader.Read_uint16();
+			if (layer._linkType > LinkingType::AVG_POOL || (version < 6 && Layer::_IsWindowed(layer._linkType)))
+			{
+				Debug::Error("Invalid netfile (unknown link type)");
+				throw 9;
+			}
+
+			if (version >= 5)
+			{
+				layer._activation = (Activation)reader.Read_uint16();
+				if ((size_t)layer._activation >= ACTIVATION_COUNT)
+				{
+					Debug::Error("Invalid netfile (unknown activation)");
+					throw 8;
+				}
+			}
+
+			if (Layer::_IsWindowed(layer._linkType))
+			{
+				layer._window.size = reader.Read_uint32();
+				layer._window.stride = reader.Read_uint32();
+				layer._window.padding = reader.Read_uint32();
+				layer._window.channels = reader.Read_uint32();
+			}
+
+			Buffer<int> inputs;
+			inputs.SetSize(reader.Read_uint32());
+
+			for (size_t i = 0; i < inputs.GetSize(); ++i)
+			{
+				inputs[i] = (int)reader.Read_uint32() - 1;
+
+				bool duplicate = false;
+				for (size_t j = 0; j < i; ++j)
+					duplicate |= inputs[j] == inputs[i];
+
+				if (inputs[i] < 0 || inputs[i] >= (int)layerCount || duplicate)
+				{
+					Debug::Error("Invalid netfile (bad input layer)");
+					throw 3;
+				}
+			}
+
+			//the stored shape has to be the one the window makes
+			if (Layer::_IsWindowed(layer._linkType))
+			{
+				Shape shape;
+				if (inputs.GetSize() != 1 || !Layer::_GetWindowShape(layer._linkType, _layers[inputs[0]]._shape, layer._window, shape) || !(shape == layer._shape))
+				{
+					Debug::Error("Invalid netfile (bad window)");
+					throw 10;
+				}
+			}
+
+			layer._SetInputs(inputs.Data(), inputs.GetSize());
+
+			const int residualLayer = (int)reader.Read_uint32() - 1;
+			if (residualLayer >= (int)layerCount || (residualLayer >= 0 && _layers[residualLayer]._size != layer._size))
+			{
+				Debug::Error("Invalid netfile (bad residual layer)");
+				throw 3;
+			}
+
+			layer._residualLayer = residualLayer;
+
+			for (size_t n = 0; n < layer._biases.GetSize(); ++n)
+				layer._biases[n] = _ReadScalar<T>(reader, scalarSize);
+
+			if (version < 7 || Layer::_IsWindowed(layer._linkType))
+			{
+				for (size_t i = 0; i < layer._weights.GetSize(); ++i)
+					layer._weights[i] = _ReadScalar<T>(reader, scalarSize);
+
+				continue;
+			}
+
+			//sparse blocks are smaller than the dense ones _SetInputs made room for, so they are packed again as they are read
+			size_t weightCount = 0;
+			for (typename Layer::Input& input : layer._inputs)
+			{
+				input.offset = weightCount;
+
+				const uint16 storage = reader.Read_uint16();
+				if (storage > 1)
+				{
+					Debug::Error("Invalid netfile (bad sparse block)");
+					throw 11;
+				}
+
+				if (storage == 1)
+				{
+					input.rows.SetSize(layer._size + 1);
+					for (size_t n = 0; n <= layer._size; ++n)
+					{
+						input.rows[n] = reader.Read_uint32();
+
+						if ((n == 0 && input.rows[n] != 0) || (n > 0 && input.rows[n] < input.rows[n - 1]) || input.rows[n] > layer._size * input.count)
+						{
+							Debug::Error("Invalid netfile (bad sparse block)");
+							throw 11;
+						}
+					}
+
+					input.columns.SetSize(input.rows[layer._size]);
+					for (size_t n = 0; n < layer._size; ++n)
+						for (size_t j = input.rows[n]; j < input.rows[n + 1]; ++j)
+						{
+							input.columns[j] = reader.Read_uint32();
+
+							//columns ascend within a row
+							if (input.columns[j] >= input.count || (j > input.rows[n] && input.columns[j] <= input.columns[j - 1]))
+							{
+								Debug::Error("Invalid netfile (bad sparse block)");
+								throw 11;
+							}
+						}
+				}
+
+				const size_t count = layer._GetBlockWeightCount(input);
+				for (size_t i = 0; i < count; ++i)
+					layer._weights[weightCount + i] = _ReadScalar<T>(reader, scalarSize);
+
+				weightCount += count;
+			}
+
+			layer._weights.SetSize(weightCount);
+		}
+	}
+	else for (Layer& layer : _layers)
+		for (size_t n = 0; n < layer._size; ++n)
+		{
+			layer._biases[n] = _ReadScalar<T>(reader, scalarSize);
+			LinkingType linkType = (LinkingType)reader.Read_uint16();
+
+			if (linkType == LinkingType::ALL)
+			{
+				int inputLayer = reader.Read_uint32() - 1;
+				uint32 inputCount = reader.Read_uint32();
+
+				if (n == 0)
+				{
+					if (inputLayer < 0 || inputLayer >= (int)layerCount || inputCount != _layers[inputLayer]._size)
+					{
+						Debug::Error("Invalid netfile (bad input layer)");
+						throw 3;
+					}
+
+					layer._linkType = LinkingType::ALL;
+					layer._SetInputs(&inputLayer, 1);
+				}
+				else if (layer._linkType != LinkingType::ALL || inputLayer != layer.GetInputLayer() || inputCount != layer._inputCount)
+				{
+					Debug::Error("Invalid netfile (neurons within a layer must share the same inputs)");
+					throw 4;
+				}
+
+				T* w = layer._weights.Data() + n * inputCount;
+				for (uint32 i = 0; i < inputCount; ++i)
+					w[i] = _ReadScalar<T>(reader, scalarSize);
+			}
+			else if (layer._linkType != LinkingType::NONE)
+			{
+				Debug::Error("Invalid netfile (neurons within a layer must share the same inputs)");
+				throw 4;
+			}
+		}
+
+	if (!_CompilePlan())
+	{
+		Debug::Error("Invalid netfile (cyclic layer links)");
+		throw 6;
+	}
+
+	std::cout << "Done\n";
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::Write(ByteWriter& writer)
+{
+	writer.Write_uint32(7);
+	writer.Write_uint16((uint16)sizeof(T));
+
+	uint32 layerCount = _layers.GetSize();
+	writer.Write_uint32(layerCount); //Layer count (incl input and output)
+	writer.Write_uint16((uint16)_cost);
+
+	std::cout << "Writing netfile...\nLayerCount: " << layerCount << "\n";
+
+	int i = 0;
+	for (Layer& layer : _layers)
+	{
+		writer.Write_uint32(layer._shape.width);
+		writer.Write_uint32(layer._shape.height);
+		writer.Write_uint32(layer._shape.channels);
+
+		std::cout << "Layer " << i++ << ": " << layer._size << " neurons\n";
+	}
+
+	std::cout << "Writing neuron info...\n";
+	
+	int li = 0;
+	for (Layer& layer : _layers)
+	{
+		const bool windowed = layer._inputs.GetSize() && Layer::_IsWindowed(layer._linkType);
+
+		size_t ensure = 2 * 2 + (windowed ? 4 * 4 : 0) + 4 * (layer._inputs.GetSize() + 2) + sizeof(T) * (layer._biases.GetSize() + layer._weights.GetSize());
+		if (!windowed)
+			for (const typename Layer::Input& input : layer._inputs)
+				ensure += 2 + (input.IsSparse() ? 4 * (input.rows.GetSize() + input.columns.GetSize()) : 0);
+		
+		writer.EnsureSpace(ensure);
+		std::cout << "LAYER " << li++ << ": " << ensure << " bytes...\n";
+
+		writer.Write_uint16((uint16)(layer._inputs.GetSize() ? (windowed ? layer._linkType : LinkingType::ALL) : LinkingType::NONE));
+		writer.Write_uint16((uint16)layer._activation);
+
+		if (windowed)
+		{
+			writer.Write_uint32(layer._window.size);
+			writer.Write_uint32(layer._window.stride);
+			writer.Write_uint32(layer._window.padding);
+			writer.Write_uint32(layer._window.channels);
+		}
+
+		writer.Write_uint32(layer._inputs.GetSize());
+		for (const typename Layer::Input& input : layer._inputs)
+			writer.Write_uint32(input.layer + 1);
+
+		writer.Write_uint32(layer._residualLayer + 1);
+
+		for (size_t n = 0; n < layer._biases.GetSize(); ++n)
+			_WriteScalar(writer, layer._biases[n]);
+
+		if (windowed)
+		{
+			for (size_t w = 0; w < layer._weights.GetSize(); ++w)
+				_WriteScalar(writer, layer._weights[w]);
+
+			continue;
+		}
+
+		for (const typename Layer::Input& input : layer._inputs)
+		{
+			writer.Write_uint16(input.IsSparse() ? 1 : 0);
+
+			if (input.IsSparse())
+			{
+				for (uint32 row : input.rows)
+					writer.Write_uint32(row);
+
+				for (uint32 column : input.columns)
+					writer.Write_uint32(column);
+			}
+
+			const T* block = layer._weights.Data() + input.offset;
+			for (size_t w = 0; w < layer._GetBlockWeightCount(input); ++w)
+				_WriteScalar(writer, block[w]);
+		}
+	}
+
+	std::cout << "Done\n";
+	return true;
+}
+
+template <typename T>
+void LayeredNetworkT<T>::_Prepare(Workspace& workspace, size_t batch) const
+{
+	workspace._layers.SetSize(_layers.GetSize());
+
+	for (size_t i = 0; i < _layers.GetSize(); ++i)
+	{
+		const Layer& layer = _layers[i];
+		typename Workspace::LayerState& state = workspace._layers[i];
+
+		if (state.outputs.GetSize() < batch * layer._size)
+		{
+			state.inputs.SetSize(batch * layer._size);
+			state.outputs.SetSize(batch * layer._size);
+			state.errors.SetSize(batch * layer._size);
+		}
+
+		//PDs are only reshaped when the layer itself has been, which discards them
+		if (state.weights_pdC.GetSize() != layer._weights.GetSize())
+		{
+			state.weights_pdC.Clear();
+			state.weights_pdC.SetSize(layer._weights.GetSize());
+		}
+
+		if (state.biases_pdC.GetSize() != layer._biases.GetSize())
+		{
+			state.biases_pdC.Clear();
+			state.biases_pdC.SetSize(layer._biases.GetSize());
+		}
+
+		if (layer._linkType == LinkingType::CONV && layer._inputs.GetSize())
+		{
+			state.columns.SetSize(layer._GetKernelSize() * layer._shape.width * layer._shape.height);
+			state.biases.SetSize(layer._size);
+		}
+	}
+}
+
+template <typename T>
+bool LayeredNetworkT<T>::_CompilePlan()
+{
+	_plan.SetSize(0);
+	_levels.SetSize(0);
+
+	const size_t layerCount = _layers.GetSize();
+
+	//Find every layer the output depends on
+	Buffer<bool> needed;
+	needed.SetSize(layerCount);
+	for (size_t i = 0; i < layerCount; ++i)
+		needed[i] = false;
+
+	Buffer<int> stack;
+	stack.SetSize(layerCount);
+
+	size_t stackSize = 0;
+	needed[1] = true;
+	stack[stackSize++] = 1;
+
+	auto visit = [&](int layer)
+	{
+		if (layer >= 0 && !needed[layer])
+		{
+			needed[layer] = true;
+			stack[stackSize++] = layer;
+		}
+	};
+
+	while (stackSize)
+	{
+		const Layer& layer = _layers[stack[--stackSize]];
+		if (&layer == &_layers[0]) continue;
+
+		for (const typename Layer::Input& input : layer._inputs)
+			visit(input.layer);
+
+		visit(layer._residualLayer);
+	}
+
+	//A layer's level is one more than that of its deepest dependency, the input layer is level 0
+	Buffer<int> levels;
+	levels.SetSize(layerCount);
+	for (size_t i = 0; i < layerCount; ++i)
+		levels[i] = -1;
+
+	levels[0] = 0;
+
+	int maxLevel = 0;
+	size_t remaining = 0;
+	for (size_t i = 1; i < layerCount; ++i)
+		if (needed[i]) ++remaining;
+
+	while (remaining)
+	{
+		size_t resolved = 0;
+
+		for (size_t i = 1; i < layerCount; ++i)
+		{
+			if (!needed[i] || levels[i] >= 0) continue;
+
+			const Layer& layer = _layers[i];
+
+			int level = 0;
+			bool ready = true;
+
+			for (const typename Layer::Input& input : layer._inputs)
+			{
+				ready &= levels[input.layer] >= 0;
+				level = Maths::Max(level, levels[input.layer]);
+			}
+
+			if (layer._residualLayer >= 0)
+			{
+				ready &= levels[layer._residualLayer] >= 0;
+				level = Maths::Max(level, levels[layer._residualLayer]);
+			}
+
+			if (ready)
+			{
+				levels[i] = level + 1;
+				maxLevel = Maths::Max(maxLevel, level + 1);
+				++resolved;
+			}
+		}
+
+		//whatever is left depends on itself
+		if (resolved == 0) return false;
+		remaining -= resolved;
+	}
+
+	//Steps in level order
+	size_t stepCount = 0;
+	for (size_t i = 1; i < layerCount; ++i)
+		if (needed[i]) ++stepCount;
+
+	_plan.SetSize(stepCount);
+	_levels.SetSize(maxLevel);
+
+	size_t step = 0;
+	for (int level = 1; level <= maxLevel; ++level)
+	{
+		_levels[level - 1].begin = step;
+
+		for (size_t i = 1; i < layerCount; ++i)
+			if (needed[i] && levels[i] == level)
+			{
+				PlanStep& s = _plan[step++];
+				s.layer = (int)i;
+				s.accumulateInputErrors.SetSize(_layers[i]._inputs.GetSize());
+			}
+
+		_levels[level - 1].end = step;
+	}
+
+	//Backpropagation runs the levels in reverse, writing the errors of each layer's residual then its inputs
+	//The first write into a layer's errors overwrites, later ones add. The output layer's errors are set directly
+	Buffer<bool> written;
+	Buffer<int> writerLevel;
+	Buffer<int> writerStep;
+	written.SetSize(layerCount);
+	writerLevel.SetSize(layerCount);
+	writerStep.SetSize(layerCount);
+
+	for (size_t i = 0; i < layerCount; ++i)
+	{
+		written[i] = i == 1;
+		writerLevel[i] = -1;
+		writerStep[i] = -1;
+	}
+
+	for (size_t l = _levels.GetSize(); l-- > 0;)
+	{
+		PlanLevel& level = _levels[l];
+		level.parallelBackward = true;
+
+		auto write = [&](int target, size_t step)
+		{
+			const bool accumulate = written[target];
+			written[target] = true;
+
+			//two steps of the same level writing one layer would race
+			if (writerLevel[target] == (int)l && writerStep[target] != (int)step)
+				level.parallelBackward = false;
+
+			writerLevel[target] = (int)l;
+			writerStep[target] = (int)step;
+			return accumulate;
+		};
+
+		//steps within a level are run in plan order both ways
+		for (size_t i = level.begin; i < level.end; ++i)
+		{
+			PlanStep& s = _plan[i];
+			const Layer& layer = _layers[s.layer];
+
+			s.accumulateResidualErrors = layer._residualLayer > 0 ? write(layer._residualLayer, i) : false;
+
+			for (size_t input = 0; input < layer._inputs.GetSize(); ++input)
+				s.accumulateInputErrors[input] = layer._inputs[input].layer > 0 ? write(layer._inputs[input].layer, i) : false;
+		}
+	}
+
+	return true;
+}
+
+template <typename T>
+template <typename STEP>
+void LayeredNetworkT<T>::_RunLevel(const PlanLevel& level, bool parallel, const STEP& step) const
+{
+	if (parallel && _scheduler && level.end - level.begin > 1)
+	{
+		TaskGroup group(*_scheduler);
+		for (size_t i = level.begin + 1; i < level.end; ++i)
+			group.Run([this, &step, i]() { step(_plan[i]); });
+
+		step(_plan[level.begin]);
+		group.Wait();
+	}
+	else
+	{
+		for (size_t i = level.begin; i < level.end; ++i)
+			step(_plan[i]);
+	}
+}
+
+template <typename T>
+void LayeredNetworkT<T>::_Forward(Workspace& workspace, const PlanStep& step, size_t batch) const
+{
+	const Layer& layer = _layers[step.layer];
+	typename Workspace::LayerState& state = workspace._layers[step.layer];
+	const bool windowed = layer._inputs.GetSize() && Layer::_IsWindowed(layer._linkType);
+
+	if (windowed && Layer::_IsPooling(layer._linkType))
+	{
+		//pooling outputs are the pooled values as they are
+		_ForwardPooling(workspace, layer, batch);
+	}
+	else
+	{
+		const T* biases = layer._biases.Data();
+
+		if (windowed)
+		{
+			_ForwardConvolution(workspace, layer, batch);
+			biases = state.biases.Data();
+		}
+		else
+		{
+			//z = x * transpose(W) for every sample at once, one block per input
+			for (size_t i = 0; i < layer._inputs.GetSize(); ++i)
+			{
+				const typename Layer::Input& input = layer._inputs[i];
+				const T* x = workspace._layers[input.layer].outputs.Data();
+
+				if (input.IsSparse())
+					Kernels::SparseMatMulABt(x, input.rows.Data(), input.columns.Data(), layer._weights.Data() + input.offset, state.inputs.Data(), batch, layer._size, input.count, i > 0);
+				else if (input.layer == 0 && workspace._sparseInputs)
+					Kernels::SparseAMatMulABt(workspace._inputRows.Data(), workspace._inputColumns.Data(), workspace._inputValues.Data(), layer._weights.Data() + input.offset, state.inputs.Data(), batch, layer._size, input.count, i > 0);
+				else
+					Kernels::MatMulABt(x, layer._weights.Data() + input.offset, state.inputs.Data(), batch, layer._size, input.count, i > 0);
+			}
+
+			if (layer._inputs.GetSize() == 0)
+				for (size_t i = 0; i < batch * layer._size; ++i)
+					state.inputs[i] = 0;
+		}
+
+		//bias + activation epilogue
+		if (step.layer == 1 && _cost == Cost::SOFTMAX_CROSS_ENTROPY)
+		{
+			for (size_t b = 0; b < batch; ++b)
+				Kernels::BiasSoftmax(state.inputs.Data() + b * layer._size, biases, state.outputs.Data() + b * layer._size, layer._size);
+		}
+		else
+		{
+			for (size_t b = 0; b < batch; ++b)
+				Kernels::BiasActivate(layer._activation, state.inputs.Data() + b * layer._size, biases, state.outputs.Data() + b * layer._size, layer._size);
+		}
+	}
+
+	if (layer._residualLayer >= 0)
+	{
+		//z is not needed again, so it keeps the activation for backpropagation
+		for (size_t i = 0; i < batch * layer._size; ++i)
+			state.inputs[i] = state.outputs[i];
+
+		Kernels::Axpy((T)1, workspace._layers[layer._residualLayer].outputs.Data(), state.outputs.Data(), batch * layer._size);
+	}
 }
 
-double LayeredNetwork::Neuron::Evaluate(LayeredNetwork& network, size_t layer)
+template <typename T>
+void LayeredNetworkT<T>::_ForwardConvolution(Workspace& workspace, const Layer& layer, size_t batch) const
 {
-	if (_valid) return _output;
+	typename Workspace::LayerState& state = workspace._layers[layer.GetIndex()];
+	const Layer& input = _layers[layer._inputs[0].layer];
+	const T* x = workspace._layers[input.GetIndex()].outputs.Data();
 
-	_input = _bias;
+	const Window& window = layer._window;
+	const size_t positions = layer._shape.width * layer._shape.height;
+	const size_t kernelSize = layer._GetKernelSize();
 
-	if (_linkType == LinkingType::ALL)
+	//the epilogue adds biases per neuron
+	for (size_t c = 0; c < window.channels; ++c)
+		for (size_t p = 0; p < positions; ++p)
+			state.biases[c * positions + p] = layer._biases[c];
+
+	//z[channels x positions] = W[channels x kernel size] * columns[kernel size x positions], one sample at a time
+	for (size_t b = 0; b < batch; ++b)
 	{
-		if (layer > 0)
-		{
-			Buffer<Neuron>& inputNeurons = network._layers[_inputLayer]._neurons;
-			for (int i = 0; i < _inputWeights.GetSize(); ++i)
-				_input += _inputWeights[i].value * inputNeurons[i].Evaluate(network, _inputLayer);
-		}
+		Kernels::Im2Col(x + b * input._size, state.columns.Data(), input._shape.width, input._shape.height, input._shape.channels, window.size, window.stride, window.padding);
+		Kernels::MatMulAB(layer._weights.Data(), state.columns.Data(), state.inputs.Data() + b * layer._size, window.channels, positions, kernelSize);
 	}
+}
+
+template <typename T>
+void LayeredNetworkT<T>::_ForwardPooling(Workspace& workspace, const Layer& layer, size_t batch) const
+{
+	typename Workspace::LayerState& state = workspace._layers[layer.GetIndex()];
+	const Layer& input = _layers[layer._inputs[0].layer];
+	const T* x = workspace._layers[input.GetIndex()].outputs.Data();
 
-	if (layer == 0) Debug::PrintLine("LayeredNetwork Warning: input layer being evaluated while invalid!");
+	const Window& window = layer._window;
+	const Shape& in = input._shape;
 
-	_valid = true;
-	return _output = Activate(_input);
+	for (size_t b = 0; b < batch; ++b)
+		Kernels::Pool(layer._linkType == LinkingType::MAX_POOL, x + b * input._size, state.outputs.Data() + b * layer._size, in.width, in.height, in.channels, window.size, window.stride);
 }
 
-void LayeredNetwork::Layer::SetInputLinkType(LinkingType linkType)
+template <typename T>
+void LayeredNetworkT<T>::_BackwardWindow(Workspace& workspace, const PlanStep& step, size_t batch) const
 {
-	_linkType = linkType;
+	const Layer& layer = _layers[step.layer];
+	typename Workspace::LayerState& state = workspace._layers[step.layer];
 
-	if (linkType == LinkingType::ALL)
+	const int inputLayer = layer._inputs[0].layer;
+	const Layer& input = _layers[inputLayer];
+	typename Workspace::LayerState& inputState = workspace._layers[inputLayer];
+
+	const Window& window = layer._window;
+	const Shape& in = input._shape;
+	const Shape& out = layer._shape;
+	const size_t positions = out.width * out.height;
+
+	//the first layer to write the input errors overwrites them, the col2im / pooling scatter below only adds
+	if (inputLayer > 0 && !step.accumulateInputErrors[0])
+		for (size_t i = 0; i < batch * input._size; ++i)
+			inputState.errors[i] = 0;
+
+	if (layer._linkType == LinkingType::CONV)
 	{
-		int prevLayer = -1;
-		
-		for (int i = 0; i < _network->_layers.GetSize() - 1; ++i)
-			if (&_network->_layers[i + 1] == this)
-			{
-				prevLayer = i;
-				break;
-			}
+		const size_t kernelSize = layer._GetKernelSize();
 
-		if (prevLayer >= 0)
+		for (size_t b = 0; b < batch; ++b)
 		{
-			int inputLayer = -1;
+			const T* errors = state.errors.Data() + b * layer._size;
 
-			if (prevLayer == 0)
+			//bias PD = sum of the errors over each plane
+			for (size_t c = 0; c < window.channels; ++c)
 			{
-				//we are the output layer
-
-				if (_network->_layers.GetSize() > 2)
-					inputLayer = _network->_layers.GetSize() - 1;
+				T sum = 0;
+				for (size_t p = 0; p < positions; ++p)
+					sum += errors[c * positions + p];
 
+				state.biases_pdC[c] += sum;
 			}
-			else if (prevLayer == 1)
-			{
-				//we are the first mid layer
 
-				inputLayer = 0;
-			}
-			else
-				inputLayer = prevLayer;
+			//weight PD = errors * transpose(columns)
+			Kernels::Im2Col(inputState.outputs.Data() + b * input._size, state.columns.Data(), in.width, in.height, in.channels, window.size, window.stride, window.padding);
+			Kernels::MatMulABt(errors, state.columns.Data(), state.weights_pdC.Data(), window.channels, kernelSize, positions, true);
 
-			if (inputLayer >= 0)
+			//input errors = transpose(W) * errors, scattered back onto the pixels they came from
+			if (inputLayer > 0)
 			{
-				uint32 inputCount = _network->_layers[inputLayer]._neurons.GetSize();
+				Kernels::MatMulAtB(layer._weights.Data(), errors, state.columns.Data(), kernelSize, positions, window.channels);
+				Kernels::Col2Im(state.columns.Data(), inputState.errors.Data() + b * input._size, in.width, in.height, in.channels, window.size, window.stride, window.padding);
+			}
+		}
+
+		return;
+	}
+
+	if (inputLayer == 0) return;
 
-				for (Neuron& neuron : _neurons)
+	//pooling, a max passes its error to the (first) largest input of its window, a mean shares it equally
+	const T invArea = (T)1 / (T)(window.size * window.size);
+
+	for (size_t b = 0; b < batch; ++b)
+		for (size_t c = 0; c < out.channels; ++c)
+		{
+			const size_t planeOffset = b * input._size + c * in.width * in.height;
+			const T* plane = inputState.outputs.Data() + planeOffset;
+			T* planeErrors = inputState.errors.Data() + planeOffset;
+
+			//a residual is added after pooling, the pooled values themselves are then kept in inputs
+			const T* pooled = (layer._residualLayer >= 0 ? state.inputs : state.outputs).Data() + b * layer._size + c * positions;
+			const T* errors = state.errors.Data() + b * layer._size + c * positions;
+
+			for (size_t oy = 0; oy < out.height; ++oy)
+				for (size_t ox = 0; ox < out.width; ++ox)
 				{
-					neuron._linkType = _linkType;
-					neuron._inputLayer = inputLayer;
-					neuron._inputWeights.Clear();
-					neuron._inputWeights.SetSize(inputCount);
+					const size_t o = oy * out.width + ox;
+					const size_t corner = oy * window.stride * in.width + ox * window.stride;
+
+					if (layer._linkType == LinkingType::MAX_POOL)
+					{
+						//the pooled value is a copy of the largest input, so the scan stops at the first one equal to it
+						size_t largest = corner;
+						bool found = false;
+						for (size_t ky = 0; ky < window.size && !found; ++ky)
+							for (size_t kx = 0; kx < window.size && !found; ++kx)
+								if (plane[corner + ky * in.width + kx] == pooled[o])
+								{
+									largest = corner + ky * in.width + kx;
+									found = true;
+								}
+
+						planeErrors[largest] += errors[o];
+					}
+					else
+					{
+						const T error = errors[o] * invArea;
+						for (size_t ky = 0; ky < window.size; ++ky)
+							for (size_t kx = 0; kx < window.size; ++kx)
+								planeErrors[corner + ky * in.width + kx] += error;
+					}
 				}
-
-				return;
-			}
 		}
+}
+
+template <typename T>
+void LayeredNetworkT<T>::_Backward(Workspace& workspace, const PlanStep& step, size_t batch) const
+{
+	const Layer& l = _layers[step.layer];
+	typename Workspace::LayerState& state = workspace._layers[step.layer];
+	const size_t count = batch * l._size;
+
+	//the residual is added after the activation, so it gets the errors as they are
+	if (l._residualLayer > 0)
+	{
+		T* residualErrors = workspace._layers[l._residualLayer].errors.Data();
+
+		if (step.accumulateResidualErrors)
+			Kernels::Axpy((T)1, state.errors.Data(), residualErrors, count);
+		else
+			for (size_t i = 0; i < count; ++i)
+				residualErrors[i] = state.errors[i];
 	}
-		
-	for (Neuron& neuron : _neurons)
+
+	//activation' from the outputs stored by the forward pass, no second exp
+	//softmax + cross-entropy output errors are already dC/dz, pooling has no activation
+	if ((step.layer != 1 || _cost != Cost::SOFTMAX_CROSS_ENTROPY) && !Layer::_IsPooling(l._linkType))
+		Kernels::MulActivationPrime(l._activation, state.errors.Data(), (l._residualLayer >= 0 ? state.inputs : state.outputs).Data(), count);
+
+	if (Layer::_IsWindowed(l._linkType))
 	{
-		neuron._linkType = LinkingType::NONE;
-		neuron._inputLayer = -1;
-		neuron._inputWeights.Clear();
+		_BackwardWindow(workspace, step, batch);
+		return;
 	}
-}
 
-void LayeredNetwork::Layer::RandomiseWeightsAndBiases(Random& random)
-{
-	for (Neuron& neuron : _neurons)
+	//bias PD = sum of errors over the batch, all a layer without inputs has to train
+	Kernels::AddColumnSums(state.errors.Data(), state.biases_pdC.Data(), batch, l._size);
+
+	for (size_t i = 0; i < l._inputs.GetSize(); ++i)
 	{
-		neuron._bias = random.NextDouble() * 2.0 - 1.0;
+		const typename Layer::Input& input = l._inputs[i];
+		typename Workspace::LayerState& inputState = workspace._layers[input.layer];
+
+		//weight PD = transpose(errors) * input activations, only at the nonzeros of a sparse block
+		//input errors = errors * weights
+		if (input.IsSparse())
+		{
+			Kernels::SparseAddAtB(state.errors.Data(), inputState.outputs.Data(), input.rows.Data(), input.columns.Data(), state.weights_pdC.Data() + input.offset, l._size, input.count, batch);
+
+			if (input.layer > 0)
+				Kernels::SparseMatMulAB(state.errors.Data(), input.rows.Data(), input.columns.Data(), l._weights.Data() + input.offset, inputState.errors.Data(), batch, input.count, l._size, step.accumulateInputErrors[i]);
+		}
+		else if (input.layer == 0 && workspace._sparseInputs)
+		{
+			//the network inputs have no errors to pass back
+			Kernels::SparseBAddAtB(state.errors.Data(), workspace._inputRows.Data(), workspace._inputColumns.Data(), workspace._inputValues.Data(), state.weights_pdC.Data() + input.offset, l._size, input.count, batch);
+		}
+		else
+		{
+			Kernels::MatMulAtB(state.errors.Data(), inputState.outputs.Data(), state.weights_pdC.Data() + input.offset, l._size, input.count, batch, true);
 
-		for (size_t i = 0; i < neuron._inputWeights.GetSize(); ++i)
-			neuron._inputWeights[i].value = random.NextDouble() * 2.0 - 1.0;
+			if (input.layer > 0)
+				Kernels::MatMulAB(state.errors.Data(), l._weights.Data() + input.offset, inputState.errors.Data(), batch, input.count, l._size, step.accumulateInputErrors[i]);
+		}
 	}
 }
 
-LayeredNetwork::LayeredNetwork() : _trainSamples(0)
+template <typename T>
+bool LayeredNetworkT<T>::Evaluate(const T* inputs, size_t inputCount, T* outputs, size_t outputCount)
 {
-	//todo jank
-	_layers.SetSize(2);
+	if (inputCount != _layers[0]._size || outputCount != _layers[1]._size)
+		return false;
 
-	_layers[0]._network = this;
-	_layers[1]._network = this;
+	EvaluateBatch(inputs, 1, outputs);
+	return true;
 }
 
-LayeredNetwork::LayeredNetwork(ByteReader& reader) : _trainSamples(0)
+template <typename T>
+template <typename INPUT>
+void LayeredNetworkT<T>::_EvaluateBatch(Workspace& workspace, const INPUT* inputs, T inputScale, size_t batch, T* outputs) const
 {
-	uint32 version = reader.Read_uint32();
+	_Prepare(workspace, batch);
 
-	std::cout << "Reading netfile...\n";
+	typename Workspace::LayerState& inputState = workspace._layers[0];
+	for (size_t i = 0; i < batch * _layers[0]._size; ++i)
+		inputState.outputs[i] = (T)inputs[i] * inputScale;
 
-	if (version != 1)
-	{
-		Debug::Error("Invalid netfile");
-		throw 1;
-	}
+	_FindSparseInputs(workspace, batch);
 
-	uint32 layerCount = reader.Read_uint32();
-	std::cout << "LayerCount: " << layerCount << '\n';
+	for (const PlanLevel& level : _levels)
+		_RunLevel(level, true, [&](const PlanStep& step) { _Forward(workspace, step, batch); });
 
-	if (layerCount < 2)
+	const typename Workspace::LayerState& outputState = workspace._layers[1];
+	for (size_t i = 0; i < batch * _layers[1]._size; ++i)
+		outputs[i] = outputState.outputs[i];
+}
+
+template <typename T>
+void LayeredNetworkT<T>::_FindSparseInputs(Workspace& workspace, size_t batch) const
+{
+	const size_t count = batch * _layers[0]._size;
+	const T* x = workspace._layers[0].outputs.Data();
+
+	size_t nonzero = 0;
+	for (size_t i = 0; i < count; ++i)
+		nonzero += x[i] != 0 ? 1 : 0;
+
+	workspace._sparseInputs = count > 0 && (double)nonzero <= Kernels::GetSparseInputDensity() * (double)count;
+	if (!workspace._sparseInputs) return;
+
+	if (workspace._inputRows.GetSize() < batch + 1)
+		workspace._inputRows.SetSize(batch + 1);
+
+	if (workspace._inputColumns.GetSize() < nonzero)
 	{
-		Debug::Error("Invalid netfile (degenerate layer count)");
-		throw 2;
+		workspace._inputColumns.SetSize(nonzero);
+		workspace._inputValues.SetSize(nonzero);
 	}
 
-	_layers.SetSize(layerCount);
+	//one row per sample, its nonzeros are found once and shared by every block the inputs feed
+	const size_t size = _layers[0]._size;
+	size_t n = 0;
 
-	for (uint32 i = 0; i < layerCount; ++i)
+	for (size_t b = 0; b < batch; ++b)
 	{
-		_layers[i]._network = this;
-		_layers[i]._neurons.SetSize(reader.Read_uint32());
-		
-		std::cout << "Layer " << i << ": " << _layers[i]._neurons.GetSize() << " neurons\n";
+		workspace._inputRows[b] = (uint32)n;
+
+		for (size_t i = 0; i < size; ++i)
+			if (x[b * size + i] != 0)
+			{
+				workspace._inputColumns[n] = (uint32)i;
+				workspace._inputValues[n++] = x[b * size + i];
+			}
 	}
 
-	for (Layer& layer : _layers)
-		for (Neuron& neuron : layer._neurons)
-		{
-			neuron._bias = reader.Read_double();
-			neuron._linkType = (LinkingType)reader.Read_uint16();
+	workspace._inputRows[batch] = (uint32)n;
+}
 
-			if (neuron._linkType == LinkingType::ALL)
-			{
-				neuron._inputLayer = reader.Read_uint32() - 1;
+template <typename T>
+void LayeredNetworkT<T>::BeginTraining(Workspace& workspace) const
+{
+	_Prepare(workspace, 1);
 
-				neuron._inputWeights.SetSize(reader.Read_uint32());
-				for (uint32 i = 0; i < neuron._inputWeights.GetSize(); ++i)
-					neuron._inputWeights[i].value = reader.Read_double();
-			}
+	//ApplyTraining leaves the PDs zeroed, they only need clearing if the last batch was never applied (or was merged into another workspace)
+	if (workspace._trainSamples != 0)
+	{
+		for (typename Workspace::LayerState& state : workspace._layers)
+		{
+			state.biases_pdC.Zero();
+			state.weights_pdC.Zero();
 		}
+	}
 
-	std::cout << "Done\n";
+	workspace._trainSamples = 0;
 }
 
-bool LayeredNetwork::Write(ByteWriter& writer)
+template <typename T>
+bool LayeredNetworkT<T>::Train(const T* inputs, size_t inputCount, const T* desiredOutputs, T* outputs, size_t outputCount)
 {
-	writer.Write_uint32(1);
+	if (inputCount != _layers[0]._size || outputCount != _layers[1]._size)
+		return false;
 
-	uint32 layerCount = _layers.GetSize();
-	writer.Write_uint32(layerCount); //Layer count (incl input and output)
+	TrainBatch(inputs, 1, desiredOutputs, outputs);
+	return true;
+}
 
-	std::cout << "Writing netfile...\nLayerCount: " << layerCount << "\n";
+template <typename T>
+void LayeredNetworkT<T>::_SetOutputErrors(Workspace& workspace, size_t batch, const T* desiredOutputs, const uint32* labels) const
+{
+	//Both costs give errors = a - y, for quadratic that is dC/da and is multiplied by activation' later,
+	//for softmax + cross-entropy the softmax Jacobian cancels against the log, leaving dC/dz directly
+	typename Workspace::LayerState& outputState = workspace._layers[1];
+	const size_t size = _layers[1]._size;
 
-	int i = 0;
-	for (Layer& layer : _layers)
+	if (desiredOutputs)
 	{
-		writer.Write_uint32(layer._neurons.GetSize());
+		for (size_t i = 0; i < batch * size; ++i)
+			outputState.errors[i] = outputState.outputs[i] - desiredOutputs[i];
+	}
+	else
+	{
+		for (size_t i = 0; i < batch * size; ++i)
+			outputState.errors[i] = outputState.outputs[i];
 
-		std::cout << "Layer " << i++ << ": " << layer._neurons.GetSize() << " neurons\n";
+		for (size_t b = 0; b < batch; ++b)
+			outputState.errors[b * size + labels[b]] -= 1;
 	}
+}
 
-	std::cout << "Writing neuron info...\n";
-	
-	int li = 0;
-	for (Layer& layer : _layers)
-	{
-		size_t ensure = layer._neurons.GetSize() * (8 + 2);
-		
-		for (const Neuron& neuron : layer._neurons)
-		{
-			if (neuron._linkType == LinkingType::ALL)
-			{
-				ensure += (4 * 2) + 8 * neuron._inputWeights.GetSize();
-			}
-		}
-		
-		writer.EnsureSpace(ensure);
-		std::cout << "LAYER " << li++ << ": " << ensure << " bytes...\n";
+template <typename T>
+template <typename INPUT>
+void LayeredNetworkT<T>::_TrainBatch(Workspace& workspace, const INPUT* inputs, T inputScale, size_t batch, const T* desiredOutputs, const uint32* labels, T* outputs) const
+{
+	_EvaluateBatch(workspace, inputs, inputScale, batch, outputs);
 
-		for (const Neuron& neuron : layer._neurons)
-		{
-			writer.Write_double(neuron._bias);
-			writer.Write_uint16((uint16)neuron._linkType);
+	_SetOutputErrors(workspace, batch, desiredOutputs, labels);
 
-			if (neuron._linkType == LinkingType::ALL)
-			{
-				if (neuron._inputLayer < -1)
-				{
-					Debug::Error("Invalid network: neuron has invalid inputLayer");
-					return false;
-				}
+	//Calculate weight and bias PDs for each layer except input, in reverse plan order so errors are complete before they are used
+	for (size_t l = _levels.GetSize(); l-- > 0;)
+		_RunLevel(_levels[l], _levels[l].parallelBackward, [&](const PlanStep& step) { _Backward(workspace, step, batch); });
 
-				writer.Write_uint32(neuron._inputLayer + 1);
+	workspace._trainSamples += (int)batch;
+}
 
-				writer.Write_uint32(neuron._inputWeights.GetSize());
-				for (uint32 i = 0; i < neuron._inputWeights.GetSize(); ++i)
-					writer.Write_double(neuron._inputWeights[i].value);
-			}
-		}
+template <typename T>
+void LayeredNetworkT<T>::MergeTraining(Workspace& into, const Workspace& from) const
+{
+	for (size_t layer = 1; layer < _layers.GetSize(); ++layer)
+	{
+		typename Workspace::LayerState& a = into._layers[layer];
+		const typename Workspace::LayerState& b = from._layers[layer];
+
+		Kernels::Axpy((T)1, b.biases_pdC.Data(), a.biases_pdC.Data(), a.biases_pdC.GetSize());
+		Kernels::Axpy((T)1, b.weights_pdC.Data(), a.weights_pdC.Data(), a.weights_pdC.GetSize());
 	}
 
-	std::cout << "Done\n";
-	return true;
+	into._trainSamples += from._trainSamples;
 }
 
-bool LayeredNetwork::Evaluate(const double* inputs, size_t inputCount, double* outputs, size_t outputCount)
+template <typename T>
+void LayeredNetworkT<T>::ApplyTraining(Workspace& workspace, double learningRate)
 {
-	if (inputCount != _layers[0]._neurons.GetSize() || outputCount != _layers[1]._neurons.GetSize())
-		return false;
+	if (workspace._trainSamples <= 0) return;
 
-	for (Layer& layer : _layers)
-		for (Neuron& neuron : layer._neurons)
-			neuron._valid = false;
+	const double gradientScale = 1.0 / (double)workspace._trainSamples;
+	++_optimizerSteps;
 
-	for (size_t i = 0; i < inputCount; ++i)
+	for (size_t layer = 1; layer < _layers.GetSize(); ++layer)
 	{
-		_layers[0]._neurons[i]._output = inputs[i];
-		_layers[0]._neurons[i]._valid = true;
-	}
+		Layer& l = _layers[layer];
+		typename Workspace::LayerState& state = workspace._layers[layer];
 
-	for (size_t i = 0; i < outputCount; ++i)
-		outputs[i] = OutputLayer()._neurons[i].Evaluate(*this, 1);
+		_ApplyOptimizer(l._biases, state.biases_pdC, l._biasesState, gradientScale, learningRate);
+		_ApplyOptimizer(l._weights, state.weights_pdC, l._weightsState, gradientScale, learningRate);
+	}
 
-	return true;
+	workspace._trainSamples = 0;
 }
 
-void LayeredNetwork::BeginTraining()
+template <typename T>
+void LayeredNetworkT<T>::_ApplyOptimizer(AlignedBuffer<T>& values, AlignedBuffer<T>& pdC, AlignedBuffer<T>* state, double gradientScale, double learningRate)
 {
-	for (Layer& layer : _layers)
-		for (Neuron& neuron : layer._neurons)
+	const size_t count = values.GetSize();
+
+	//Layers reshaped since the last step start again from no history
+	const size_t stateCount = _optimizer.type == Optimizer::Type::SGD ? 0 : (_optimizer.type == Optimizer::Type::ADAM ? 2 : 1);
+	for (size_t i = 0; i < stateCount; ++i)
+	{
+		if (state[i].GetSize() != count)
 		{
-			neuron._bias_pdC = 0.0;
-			for (size_t i = 0; i < neuron._inputWeights.GetSize(); ++i)
-				neuron._inputWeights[i].pd_C = 0.0;
+			state[i].Clear();
+			state[i].SetSize(count);
 		}
+	}
 
-	_trainSamples = 0;
+	const T scale = (T)gradientScale;
+	const double mu = _optimizer.momentum;
+
+	switch (_optimizer.type)
+	{
+	case Optimizer::Type::SGD:
+		Kernels::ApplyGradient(values.Data(), pdC.Data(), (T)(learningRate * gradientScale), count);
+		break;
+	case Optimizer::Type::MOMENTUM:
+		Kernels::ApplyMomentum(values.Data(), pdC.Data(), state[0].Data(), scale, (T)mu, (T)0, (T)learningRate, count);
+		break;
+	case Optimizer::Type::NESTEROV:
+		Kernels::ApplyMomentum(values.Data(), pdC.Data(), state[0].Data(), scale, (T)mu, (T)learningRate, (T)(learningRate * mu), count);
+		break;
+	case Optimizer::Type::RMSPROP:
+		Kernels::ApplyRMSProp(values.Data(), pdC.Data(), state[0].Data(), scale, (T)_optimizer.decay, (T)learningRate, (T)_optimizer.epsilon, count);
+		break;
+	case Optimizer::Type::ADAM:
+	{
+		//The moments start at 0 and are biased towards it early on, undo that in the rate
+		const double rate = learningRate * std::sqrt(1.0 - std::pow(_optimizer.decay, _optimizerSteps)) / (1.0 - std::pow(mu, _optimizerSteps));
+		Kernels::ApplyAdam(values.Data(), pdC.Data(), state[0].Data(), state[1].Data(), scale, (T)mu, (T)_optimizer.decay, (T)rate, (T)_optimizer.epsilon, count);
+		break;
+	}
+	}
 }
 
-bool LayeredNetwork::Train(const double* inputs, size_t inputCount, const double* desiredOutputs, double* outputs, size_t outputCount)
+template <typename T>
+void LayeredNetworkT<T>::SetOptimizer(const Optimizer& optimizer)
 {
-	if (inputCount != _layers[0]._neurons.GetSize() || outputCount != _layers[1]._neurons.GetSize())
-		return false;
+	_optimizer = optimizer;
+	_optimizerSteps = 0;
 
 	for (Layer& layer : _layers)
-		for (Neuron& neuron : layer._neurons)
+	{
+		for (size_t i = 0; i < 2; ++i)
 		{
-			neuron._valid = false;
-			neuron._error = 0.0;
+			layer._weightsState[i].Clear();
+			layer._biasesState[i].Clear();
 		}
-
-	for (size_t i = 0; i < inputCount; ++i)
-	{
-		_layers[0]._neurons[i]._output = inputs[i];
-		_layers[0]._neurons[i]._valid = true;
 	}
+}
+
+template <typename T>
+void LayeredNetworkT<T>::PruneWeights(double fraction, bool global)
+{
+	fraction = Maths::Max(0.0, Maths::Min(fraction, 1.0));
 
-	for (size_t i = 0; i < outputCount; ++i)
+	auto prunable = [](const Layer& layer) { return layer._linkType == LinkingType::ALL && layer._inputs.GetSize() > 0; };
+
+	//prunes layers [begin, end) together
+	auto prune = [&](size_t begin, size_t end)
 	{
-		Neuron& oNeuron = _layers[1]._neurons[i];
-		outputs[i] = oNeuron.Evaluate(*this, 1);
+		size_t dense = 0;
+		size_t stored = 0;
 
-		//error on the output layer = partial derivative of cost function in terms of the input * derivative of activation function
-		//This will be multiplied by activation prime later
-		oNeuron._error = oNeuron._output - desiredOutputs[i];
-	}
+		for (size_t l = begin; l < end; ++l)
+			if (prunable(_layers[l]))
+			{
+				dense += _layers[l]._size * _layers[l]._inputCount;
+				stored += _layers[l]._weights.GetSize();
+			}
+
+		//weights pruned before count towards the target
+		const size_t target = (size_t)(fraction * (double)dense + 0.5);
+		if (target <= dense - stored) return;
+
+		const size_t remove = target - (dense - stored);
+
+		Buffer<T> magnitudes;
+		magnitudes.SetSize(stored);
+
+		size_t m = 0;
+		for (size_t l = begin; l < end; ++l)
+			if (prunable(_layers[l]))
+				for (T w : _layers[l]._weights)
+					magnitudes[m++] = w < 0 ? -w : w;
+
+		std::nth_element(magnitudes.Data(), magnitudes.Data() + remove - 1, magnitudes.Data() + stored);
+		const T threshold = magnitudes[remove - 1];
+
+		//everything below the threshold goes, then as many of the weights at it as make up the count
+		size_t ties = remove;
+		for (size_t i = 0; i < stored; ++i)
+			if (magnitudes[i] < threshold)
+				--ties;
+
+		for (size_t l = begin; l < end; ++l)
+			if (prunable(_layers[l]))
+				_layers[l]._Prune(threshold, ties);
+	};
+
+	if (global)
+		prune(0, _layers.GetSize());
+	else
+		for (size_t l = 0; l < _layers.GetSize(); ++l)
+			prune(l, l + 1);
+
+	SetOptimizer(_optimizer);
+}
+
+template <typename T>
+size_t LayeredNetworkT<T>::PruneNeurons(double fraction)
+{
+	fraction = Maths::Max(0.0, Maths::Min(fraction, 1.0));
 
-	//Calculate weight and bias PDs for each layer except input
-	int layer = 1;
-	while (layer > 0)
+	size_t removed = 0;
+
+	for (size_t l = 2; l < _layers.GetSize(); ++l)
 	{
-		int nextLayer = -1;
+		Layer& layer = _layers[l];
+		if (layer._linkType != LinkingType::ALL || layer._inputs.GetSize() == 0 || layer._residualLayer >= 0)
+			continue;
+
+		const size_t count = Maths::Min((size_t)(fraction * (double)layer._size + 0.5), layer._size - 1);
+		if (count == 0) continue;
 
-		for (Neuron& neuron : _layers[layer]._neurons)
+		//a neuron's importance is the total magnitude of its outgoing weights, over every layer it feeds
+		Buffer<T> scores;
+		scores.SetSize(layer._size);
+		for (T& score : scores)
+			score = 0;
+
+		bool eligible = true;
+		for (const Layer& consumer : _layers)
 		{
-			if (neuron._inputLayer != nextLayer)
+			//a residual or windowed consumer depends on the shape of the layer
+			if (consumer._residualLayer == (int)l)
+				eligible = false;
+
+			for (const typename Layer::Input& input : consumer._inputs)
 			{
-				if (nextLayer >= 0)
+				if (input.layer != (int)l) continue;
+
+				if (consumer._linkType != LinkingType::ALL)
 				{
-					Debug::Error("Training does not support layers which take input from more than one layer!");
-					return false;
+					eligible = false;
+					continue;
 				}
 
-				nextLayer = neuron._inputLayer;
+				const T* block = consumer._weights.Data() + input.offset;
+				for (size_t n = 0; n < consumer._size; ++n)
+				{
+					const size_t first = input.IsSparse() ? input.rows[n] : n * input.count;
+					const size_t last = input.IsSparse() ? input.rows[n + 1] : (n + 1) * input.count;
+
+					for (size_t j = first; j < last; ++j)
+						scores[input.IsSparse() ? input.columns[j] : j - first] += block[j] < 0 ? -block[j] : block[j];
+				}
 			}
+		}
 
-			neuron._error *= ActivatePrime(neuron._input);
-			neuron._bias_pdC += neuron._error;
+		if (!eligible) continue;
 
-			Buffer<Neuron>& inputNeurons = _layers[neuron._inputLayer]._neurons;
-			for (size_t input = 0; input < neuron._inputWeights.GetSize(); ++input)
-			{
-				//Add weighted error to input error
-				inputNeurons[input]._error += neuron._error * neuron._inputWeights[input].value;
+		Buffer<T> sorted;
+		sorted.SetSize(layer._size);
+		for (size_t n = 0; n < layer._size; ++n)
+			sorted[n] = scores[n];
 
-				//Weight PD
-				neuron._inputWeights[input].pd_C += inputNeurons[input]._output * neuron._error;
-			}
+		std::nth_element(sorted.Data(), sorted.Data() + count - 1, sorted.Data() + layer._size);
+		const T threshold = sorted[count - 1];
+
+		size_t ties = count;
+		for (T score : scores)
+			if (score < threshold)
+				--ties;
+
+		Buffer<bool> keep;
+		keep.SetSize(layer._size);
+		for (size_t n = 0; n < layer._size; ++n)
+		{
+			keep[n] = scores[n] > threshold || (scores[n] == threshold && ties == 0);
+			if (scores[n] == threshold && ties > 0)
+				--ties;
 		}
 
-		layer = nextLayer;
+		for (Layer& consumer : _layers)
+			for (size_t i = 0; i < consumer._inputs.GetSize(); ++i)
+				if (consumer._inputs[i].layer == (int)l)
+					consumer._RemoveInputNeurons(i, keep);
+
+		layer._RemoveNeurons(keep);
+		removed += count;
 	}
 
-	++_trainSamples;
-	return true;
+	if (removed)
+		SetOptimizer(_optimizer);
+
+	return removed;
 }
 
-void LayeredNetwork::ApplyTraining(double learningRate)
+template <typename T>
+template <typename INPUT>
+void LayeredNetworkT<T>::_TrainSample(Workspace& workspace, const INPUT* inputs, T inputScale, const T* desiredOutputs, const uint32* label, T* outputs, double learningRate)
 {
-	if (_trainSamples <= 0) return;
+	_EvaluateBatch(workspace, inputs, inputScale, 1, outputs);
 
-	double f = learningRate / (double)_trainSamples;
+	_SetOutputErrors(workspace, 1, desiredOutputs, label);
 
-	for (size_t layer = 1; layer < _layers.GetSize(); ++layer)
-		for (Neuron& neuron : _layers[layer]._neurons)
+	const T rate = (T)learningRate;
+
+	for (size_t level = _levels.GetSize(); level-- > 0;)
+		for (size_t i = _levels[level].begin; i < _levels[level].end; ++i)
+		{
+			const PlanStep& step = _plan[i];
+
+			Layer& l = _layers[step.layer];
+			typename Workspace::LayerState& state = workspace._layers[step.layer];
+
+			if (l._residualLayer > 0)
+			{
+				T* residualErrors = workspace._layers[l._residualLayer].errors.Data();
+
+				if (step.accumulateResidualErrors)
+					Kernels::Axpy((T)1, state.errors.Data(), residualErrors, l._size);
+				else
+					for (size_t n = 0; n < l._size; ++n)
+						residualErrors[n] = state.errors[n];
+			}
+
+			if ((step.layer != 1 || _cost != Cost::SOFTMAX_CROSS_ENTROPY) && !Layer::_IsPooling(l._linkType))
+				Kernels::MulActivationPrime(l._activation, state.errors.Data(), (l._residualLayer >= 0 ? state.inputs : state.outputs).Data(), l._size);
+
+			if (Layer::_IsWindowed(l._linkType))
+			{
+				//every weight of a kernel is used all over the plane, so its PD is summed before it is applied
+				//(the workspace may hold an unapplied batch's PDs, clear them first)
+				state.weights_pdC.Zero();
+				state.biases_pdC.Zero();
+
+				_BackwardWindow(workspace, step, 1);
+
+				Kernels::ApplyGradient(l._weights.Data(), state.weights_pdC.Data(), rate, l._weights.GetSize());
+				Kernels::ApplyGradient(l._biases.Data(), state.biases_pdC.Data(), rate, l._biases.GetSize());
+				continue;
+			}
+
+			for (size_t n = 0; n < l._size; ++n)
+				l._biases[n] -= rate * state.errors[n];
+
+			for (size_t input = 0; input < l._inputs.GetSize(); ++input)
+			{
+				const typename Layer::Input& in = l._inputs[input];
+				typename Workspace::LayerState& inputState = workspace._layers[in.layer];
+				T* blockWeights = l._weights.Data() + in.offset;
+
+				const T* activations = inputState.outputs.Data();
+
+				if (in.IsSparse())
+				{
+					//input errors use the weights from before this sample's update
+					if (in.layer > 0)
+						Kernels::SparseMatMulAB(state.errors.Data(), in.rows.Data(), in.columns.Data(), blockWeights, inputState.errors.Data(), 1, in.count, l._size, step.accumulateInputErrors[input]);
+
+					for (size_t n = 0; n < l._size; ++n)
+						Kernels::SparseAxpy(-rate * state.errors[n], activations, in.columns.Data() + in.rows[n], blockWeights + in.rows[n], in.rows[n + 1] - in.rows[n]);
+
+					continue;
+				}
+
+				//input errors use the weights from before this sample's update
+				if (in.layer > 0)
+					Kernels::MatMulAB(state.errors.Data(), blockWeights, inputState.errors.Data(), 1, in.count, l._size, step.accumulateInputErrors[input]);
+
+				const uint32* active;
+				size_t activeCount = 0;
+
+				if (in.layer == 0 && workspace._sparseInputs)
+				{
+					//the evaluation has already found the network inputs' nonzeros
+					active = workspace._inputColumns.Data();
+					activeCount = workspace._inputRows[1];
+				}
+				else
+				{
+					if (workspace._activeInputs.GetSize() < in.count)
+						workspace._activeInputs.SetSize(in.count);
+
+					uint32* indices = workspace._activeInputs.Data();
+					for (size_t j = 0; j < in.count; ++j)
+						if (activations[j] != 0)
+							indices[activeCount++] = (uint32)j;
+
+					active = indices;
+				}
+
+				//scattered writes only pay off while most of the row is left alone
+				const bool sparse = activeCount * 2 < in.count;
+
+				for (size_t n = 0; n < l._size; ++n)
+				{
+					const T delta = -rate * state.errors[n];
+
+					T* weights = blockWeights + n * in.count;
+					if (sparse)
+					{
+						for (size_t k = 0; k < activeCount; ++k)
+							weights[active[k]] += delta * activations[active[k]];
+					}
+					else
+						Kernels::Axpy(delta, activations, weights, in.count);
+				}
+			}
+		}
+}
+
+template <typename T>
+double LayeredNetworkT<T>::_CheckGradients(const T* inputs, size_t batch, const T* desiredOutputs, const uint32* labels, double step)
+{
+	const size_t outputSize = _layers[1]._size;
+
+	AlignedBuffer<T> outputs;
+	outputs.SetSize(batch * outputSize);
+
+	Workspace workspace;
+	BeginTraining(workspace);
+	_TrainBatch(workspace, inputs, (T)1, batch, desiredOutputs, labels, outputs.Data());
+
+	//summed over the batch like the PDs, with the targets _SetOutputErrors uses
+	Workspace evaluation;
+	auto cost = [&]() -> double
+	{
+		_EvaluateBatch(evaluation, inputs, (T)1, batch, outputs.Data());
+
+		double sum = 0.0;
+		for (size_t b = 0; b < batch; ++b)
+			for (size_t i = 0; i < outputSize; ++i)
+			{
+				const double a = outputs[b * outputSize + i];
+				const double y = desiredOutputs ? desiredOutputs[b * outputSize + i] : labels[b] == i ? 1.0 : 0.0;
+
+				sum += _cost == Cost::SOFTMAX_CROSS_ENTROPY ? (y != 0.0 ? -y * std::log(a) : 0.0) : 0.5 * (a - y) * (a - y);
+			}
+
+		return sum;
+	};
+
+	double worst = 0.0;
+
+	auto check = [&](AlignedBuffer<T>& values, const AlignedBuffer<T>& pdC)
+	{
+		for (size_t i = 0; i < values.GetSize(); ++i)
 		{
-			neuron._bias -= f * neuron._bias_pdC;
+			const T value = values[i];
+			const T above = (T)(value + step);
+			const T below = (T)(value - step);
+
+			values[i] = above;
+			const double costAbove = cost();
+			values[i] = below;
+			const double costBelow = cost();
+			values[i] = value;
+
+			//divided by the step T actually took
+			const double numeric = (costAbove - costBelow) / ((double)above - (double)below);
+			const double analytic = pdC[i];
 
-			for (size_t i = 0; i < neuron._inputWeights.GetSize(); ++i)
-				neuron._inputWeights[i].value -= f * neuron._inputWeights[i].pd_C;
+			worst = Maths::Max(worst, std::abs(numeric - analytic) / Maths::Max(1e-3, Maths::Max(std::abs(numeric), std::abs(analytic))));
 		}
+	};
+
+	for (size_t layer = 1; layer < _layers.GetSize(); ++layer)
+	{
+		check(_layers[layer]._weights, workspace._layers[layer].weights_pdC);
+		check(_layers[layer]._biases, workspace._layers[layer].biases_pdC);
+	}
+
+	return worst;
 }
+
+#define INSTANTIATE_INPUTS(T, INPUT) \
+	template void LayeredNetworkT<T>::_EvaluateBatch(Workspace&, const INPUT*, T, size_t, T*) const; \
+	template void LayeredNetworkT<T>::_TrainBatch(Workspace&, const INPUT*, T, size_t, const T*, const uint32*, T*) const; \
+	template void LayeredNetworkT<T>::_TrainSample(Workspace&, const INPUT*, T, const T*, const uint32*, T*, double);
+
+template class LayeredNetworkT<float>;
+template class LayeredNetworkT<double>;
+
+INSTANTIATE_INPUTS(float, float)
+INSTANTIATE_INPUTS(float, byte)
+INSTANTIATE_INPUTS(double, double)
+INSTANTIATE_INPUTS(double, byte)
@@ -1,116 +1,448 @@
 #pragma once
+#include "Activation.hpp"
+#include "AlignedBuffer.hpp"
 #include <ELCore/Buffer.hpp>
 #include <ELCore/Concepts.hpp>
 #include <ELCore/List.hpp>
 
-/*
-	Currently intended for use as a shallow network only!
+class TaskScheduler;
 
-	Uses the quadratic cost function & the sigmoid activation function
+/*
+	Each layer has its own Activation (sigmoid by default), the cost is either quadratic or cross-entropy over a softmax output layer (see Cost)
 	Training is done by solving the weights and biases partial derivatives in terms of the cost function via backpropogation
+
+	Each layer stores its parameters as flat arrays:
+	weights are a row-major [neurons x inputs] matrix, so neuron n's weights are the contiguous row at n * inputs
+	cost partial derivatives live in a separate matrix of the same shape so that evaluation only touches the weights
+
+	A layer may take input from several earlier layers, their activations are concatenated
+	Each input has its own [neurons x input size] block of weights, stored one after another
+	A layer may also add the activations of another layer of the same size to its own (a residual / skip connection)
+
+	PruneWeights zeroes the smallest weights and stores the blocks that lost any in CSR form: only the nonzeros, with per row offsets
+	and column indices alongside. Sparse blocks are evaluated and trained with the Kernels::Sparse products, pruned weights stay 0
+	PruneNeurons removes whole hidden neurons instead, shrinking the dense products
+
+	Neurons can also be laid out as planes (see Shape) for image data. A CONV layer slides small kernels shared by every position
+	over the planes of its input, lowered to the same matrix products as above with Kernels::Im2Col. Pooling layers (MAX_POOL, AVG_POOL)
+	downsample each plane and have no parameters. Both kinds take exactly one input, their shape follows from its shape and their Window
+
+	Inputs that are mostly 0 (eg. the blank background of an image) are multiplied through only their nonzeros by the dense blocks they feed,
+	both when evaluating and for the weight PDs, once few enough are nonzero for that to beat the dense products
+
+	Layers the output depends on are run in a precompiled order, grouped into levels of layers that do not depend on each other
+	With a TaskScheduler set, the layers of a level are run in parallel
+
+	ApplyTraining steps the parameters with the selected Optimizer, whose state (velocity or moments) is kept in buffers parallel to them
+	Every optimizer update is a single fused pass that also zeroes the cost PDs, ready for the next batch
+
+	Everything that changes during evaluation and training (activations, errors, cost PDs) lives in a Workspace
+	The network itself is only read until ApplyTraining, so several threads can train it at once, each with its own workspace
+	The overloads without a workspace use one owned by the network
+
+	TrainSample is the exception, it writes the weights directly (Hogwild SGD) and is meant to be raced by several threads
+
+	T is the scalar type of all parameters and state, float or double (instantiated in LayeredNetwork.cpp)
+	The netfile records which one it was written with and converts when loaded into the other
 */
 
-class LayeredNetwork
+template <typename T>
+class LayeredNetworkT
 {
 public:
 	class Layer;
+	class Workspace;
 
 	enum class LinkingType
 	{
 		NONE = 0,
-		ALL = 1 //Link to every node in previous layer
+		ALL = 1, //Link to every node in previous layer
+		CONV = 2, //Kernels slid over the planes of the previous layer, see Window
+		MAX_POOL = 3, //Largest value in each window of each plane of the previous layer, no activation or parameters
+		AVG_POOL = 4 //Mean of each window
 	};
 
-private:
-	class Neuron
+	//Neurons of a layer as channels planes of width x height, stored plane after plane and row after row within a plane
+	//Only CONV and pooling layers look at it, a layer generated with just a size is one plane of size x 1
+	struct Shape
 	{
-		friend LayeredNetwork;
-		friend Layer;
-
-	public:
-		struct Weight
-		{
-			double value;
+		size_t width;
+		size_t height;
+		size_t channels;
 
-			double pd_C; //Partial derivative with respect to cost
-		};
+		Shape(size_t width = 0, size_t height = 1, size_t channels = 1) : width(width), height(height), channels(channels) {}
 
-	private:
-		bool _valid;
+		size_t GetSize() const { return width * height * channels; }
+		bool operator==(const Shape& other) const { return width == other.width && height == other.height && channels == other.channels; }
+	};
 
-		double _bias;
-		double _output;
+	//Kernel of a CONV layer or window of a pooling layer
+	struct Window
+	{
+		size_t size;		//size x size neurons of each input plane
+		size_t stride;		//between neighbouring outputs
+		size_t padding;		//zeros around each input plane, CONV only
+		size_t channels;	//planes out of a CONV layer, each with one kernel over every input plane and one bias. Pooling keeps the input's planes
 
-		LinkingType _linkType;
+		Window(size_t size = 1, size_t stride = 1, size_t padding = 0, size_t channels = 1) : size(size), stride(stride), padding(padding), channels(channels) {}
+	};
 
-		int _inputLayer;
-		Buffer<Weight> _inputWeights;
+	//Cost function, with the output activation it is paired with
+	enum class Cost
+	{
+		QUADRATIC = 0,				//output layer's own activation, C = |a - y|^2 / 2
+		SOFTMAX_CROSS_ENTROPY = 1	//softmax outputs, C = -ln(a[label]), so dC/dz = a - y without the sigmoid' that slows learning
+	};
 
-		double _input;
+	//How ApplyTraining turns the accumulated cost PDs into a step
+	struct Optimizer
+	{
+		enum class Type
+		{
+			SGD = 0,
+			MOMENTUM = 1,	//velocity = momentum * velocity + g, step along velocity
+			NESTEROV = 2,	//as MOMENTUM, but steps along g + momentum * velocity (looks ahead)
+			RMSPROP = 3,	//g / sqrt(running mean of g^2), decay sets how long the mean is
+			ADAM = 4		//bias corrected running mean of g (decay momentum) over sqrt(running mean of g^2) (decay decay)
+		};
 
-		double _error;
-		double _bias_pdC; //nabla bias / nabla cost
+		Type type;
+		double momentum;	//MOMENTUM, NESTEROV and ADAM (beta1)
+		double decay;		//RMSPROP and ADAM (beta2)
+		double epsilon;		//RMSPROP and ADAM, keeps the step finite where g has stayed ~0
 
-	public:
-		Neuron() : 
-			_valid(false), 
-			_bias(0.0), 
-			_output(0.0), 
-			_inputLayer(-1),
-			_linkType(LinkingType::NONE), 
-			_input(0.0),
-			_error(0.0),
-			_bias_pdC(0.0) {}
-
-		double Evaluate(LayeredNetwork&, size_t layer);
+		Optimizer(Type type = Type::SGD, double momentum = 0.9, double decay = 0.999, double epsilon = 1e-8) :
+			type(type), momentum(momentum), decay(decay), epsilon(epsilon) {}
 	};
 
-public:
 	class Layer
 	{
-		friend LayeredNetwork;
+		friend LayeredNetworkT;
 		friend Buffer<Layer>; //EW!
 
+		struct Input
+		{
+			int layer;
+			size_t count;
+			size_t offset;		//of this input's [_size x count] weight block in _weights
+
+			//Empty for a dense block, otherwise the block is CSR and only its nonzero weights are in _weights
+			AlignedBuffer<uint32> rows;			//[_size + 1] offsets of each neuron's nonzeros from offset
+			AlignedBuffer<uint32> columns;		//input neuron of each nonzero
+
+			bool IsSparse() const { return rows.GetSize() != 0; }
+		};
+
 	private:
-		LayeredNetwork* _network;
+		LayeredNetworkT* _network;
 
 		LinkingType _linkType;
-		Buffer<Neuron> _neurons;
+		Activation _activation;
+		Buffer<Input> _inputs;
+		int _residualLayer;
+
+		size_t _size;
+		size_t _inputCount;				//Sum of the sizes of all inputs
+
+		Shape _shape;
+		Window _window;					//CONV and pooling layers only
+
+		AlignedBuffer<T> _weights;		//One [_size x count] block per input, CONV layers one [channels x kernel size] block
+		AlignedBuffer<T> _biases;		//[_size], CONV layers one per channel, pooling layers none
+
+		//Optimizer state parallel to _weights and _biases, velocity or mean square in [0], Adam's second moment in [1]
+		//Sized (and zeroed) by ApplyTraining when the optimizer first needs them
+		AlignedBuffer<T> _weightsState[2];
+		AlignedBuffer<T> _biasesState[2];
+
+		Layer() :
+			_network(nullptr),
+			_linkType(LinkingType::NONE),
+			_activation(Activation::SIGMOID),
+			_residualLayer(-1),
+			_size(0),
+			_inputCount(0) {}
+
+		static bool _IsWindowed(LinkingType linkType) { return linkType == LinkingType::CONV || _IsPooling(linkType); }
+		static bool _IsPooling(LinkingType linkType) { return linkType == LinkingType::MAX_POOL || linkType == LinkingType::AVG_POOL; }
+
+		//Shape of the outputs of window over input, false if it does not fit
+		static bool _GetWindowShape(LinkingType, const Shape& input, const Window&, Shape& output);
+
+		//The layer SetInputLinkType links to, -1 if there is none
+		int _GetPreviousLayer() const;
+
+		//Weights of one CONV kernel, size x size over every input plane
+		size_t _GetKernelSize() const;
+
+		//Replaces the inputs and zeroes the weights and biases
+		void _SetInputs(const int* layers, size_t count);
+
+		//Entries of input's block in _weights
+		size_t _GetBlockWeightCount(const Input& input) const { return input.IsSparse() ? input.rows[_size] : _size * input.count; }
+
+		//Drops the weights below threshold (and the first ties at it) from every block, storing those that lose any as CSR
+		//Returns the number dropped
+		size_t _Prune(T threshold, size_t& ties);
+
+		//Keeps only the neurons with keep[n] set, with their weights and biases
+		void _RemoveNeurons(const Buffer<bool>& keep);
+
+		//Keeps only the weights from the input neurons of _inputs[input] with keep[i] set
+		void _RemoveInputNeurons(size_t input, const Buffer<bool>& keep);
 
-		Layer() : _network(nullptr), _linkType(LinkingType::NONE) {}
 	public:
-		size_t GetSize() const { return _neurons.GetSize(); }
+		size_t GetIndex() const { return (size_t)(this - _network->_layers.Data()); }
 
-		void Generate(size_t size) 
-		{
-			_neurons.Clear();
-			_neurons.SetSize(size);
+		size_t GetSize() const { return _size; }
+		const Shape& GetShape() const { return _shape; }
+
+		LinkingType GetInputLinkType() const { return _linkType; }
+		const Window& GetWindow() const { return _window; }
+
+		//-1 if unlinked, otherwise the first input
+		int GetInputLayer() const { return _inputs.GetSize() ? _inputs[0].layer : -1; }
+
+		size_t GetInputLayerCount() const { return _inputs.GetSize(); }
+		int GetInputLayer(size_t input) const { return _inputs[input].layer; }
+
+		//Total of all inputs
+		size_t GetInputCount() const { return _inputCount; }
+
+		//-1 if none
+		int GetResidualLayer() const { return _residualLayer; }
+
+		//The full [_size x count] blocks of a dense layer, only the nonzeros of its sparse blocks otherwise
+		const T* GetWeights() const { return _weights.Data(); }
+		const T* GetBiases() const { return _biases.Data(); }
+
+		size_t GetWeightCount() const { return _weights.GetSize(); }
+
+		//Weights of one input's block, [size x input layer size] if dense
+		const T* GetInputWeights(size_t input) const { return _weights.Data() + _inputs[input].offset; }
+
+		//CSR row offsets ([size + 1], into GetInputWeights) and columns of a sparse input block, nullptr if it is dense
+		const uint32* GetInputRows(size_t input) const { return _inputs[input].IsSparse() ? _inputs[input].rows.Data() : nullptr; }
+		const uint32* GetInputColumns(size_t input) const { return _inputs[input].IsSparse() ? _inputs[input].columns.Data() : nullptr; }
+
+		//True if any weight block has been pruned into CSR form
+		bool IsSparse() const;
+
+		//Ignored by the output layer when the cost is SOFTMAX_CROSS_ENTROPY
+		Activation GetActivation() const { return _activation; }
+		void SetActivation(Activation activation) { _activation = activation; }
 
-			if (_linkType != LinkingType::NONE)
-				SetInputLinkType(_linkType);
-		}
+		//A CONV or pooling layer given a shape of its own is fully connected (ALL) to the same input instead
+		void Generate(size_t size) { Generate(Shape(size)); }
+		void Generate(const Shape& shape);
 
+		//CONV and pooling layers are linked with the current window, see SetInputWindow
 		void SetInputLinkType(LinkingType linkType);
+
+		//Links to the previous layer like SetInputLinkType(ALL), as a CONV or pooling layer with window
+		//The layer is reshaped to the window's output, so the weights and biases are zeroed
+		//Returns false, leaving the layer as it was, if linkType is not CONV or a pooling type, there is no previous layer,
+		//or window does not fit in its planes (pooling windows cannot be padded)
+		bool SetInputWindow(LinkingType linkType, const Window& window);
+
+		//Concatenates the activations of another layer onto this layer's inputs, the new weights are 0
+		//Returns false if layer is already an input, this is a CONV or pooling layer, or the link would form a cycle
+		bool AddInput(size_t layer);
+
+		//a = activation(z + b) + activations of layer, -1 to remove
+		//Returns false if layer is a different size or the link would form a cycle
+		bool SetResidualLayer(int layer);
+
 		void RandomiseWeightsAndBiases(class Random&);
 	};
 
+	class Workspace
+	{
+		friend LayeredNetworkT;
+
+		struct LayerState
+		{
+			//Per sample state, [batch x size] (row 0 is used for single sample evaluation)
+			AlignedBuffer<T> inputs;		//Weighted input of each neuron
+			AlignedBuffer<T> outputs;		//Activation of each neuron
+			AlignedBuffer<T> errors;
+
+			AlignedBuffer<T> weights_pdC;	//Partial derivatives with respect to cost, same shape as the weights
+			AlignedBuffer<T> biases_pdC;	//Same shape as the biases
+
+			//CONV layers only
+			AlignedBuffer<T> columns;		//Im2Col of one sample's input, [kernel size x output positions], reused for the input errors
+			AlignedBuffer<T> biases;		//The per channel biases repeated over each plane, [size]
+		};
+
+		Buffer<LayerState> _layers;
+
+		AlignedBuffer<uint32> _activeInputs;		//TrainSample scratch, indices of the nonzero inputs of a layer
+
+		//Nonzeros of the network inputs of the last evaluation as a [batch x input size] CSR matrix
+		//Only built when few enough are nonzero, see Kernels::GetSparseInputDensity
+		bool _sparseInputs;
+		AlignedBuffer<uint32> _inputRows;
+		AlignedBuffer<uint32> _inputColumns;
+		AlignedBuffer<T> _inputValues;
+
+		int _trainSamples;
+
+	public:
+		Workspace() : _sparseInputs(false), _trainSamples(0) {}
+
+		//[batch x size] activations of a layer from the most recent evaluation
+		const T* GetOutputs(size_t layer) const { return _layers[layer].outputs.Data(); }
+	};
+
 private:
+	//One layer operation, z = x * transpose(W) then a = activation(z + b) (+ residual)
+	struct PlanStep
+	{
+		int layer;
+
+		//A step after this one has already written errors back into the input / residual layer
+		Buffer<bool> accumulateInputErrors;		//per input
+		bool accumulateResidualErrors;
+	};
+
+	//Steps [begin, end) of _plan only depend on earlier levels
+	struct PlanLevel
+	{
+		size_t begin;
+		size_t end;
+		bool parallelBackward;		//no two steps write errors into the same layer
+	};
+
 	Buffer<Layer> _layers;
 
-	int _trainSamples;
+	//Every layer the output depends on, inputs before the layers they feed, excluding the input layer
+	//Run forwards to evaluate and backwards to backpropagate
+	Buffer<PlanStep> _plan;
+	Buffer<PlanLevel> _levels;
+
+	Cost _cost;
+
+	Optimizer _optimizer;
+	uint32 _optimizerSteps;		//ApplyTraining calls since the optimizer was set, for Adam's bias correction
+
+	TaskScheduler* _scheduler;
+
+	Workspace _workspace;
+
+	//Rebuilds the plan from the layer links, returns false (leaving the plan empty) if the links form a cycle
+	bool _CompilePlan();
+
+	//Sizes the workspace for the current layer shapes and batch size
+	void _Prepare(Workspace&, size_t batch) const;
+
+	//Finds the nonzero network inputs, so the blocks they feed can skip the rest
+	void _FindSparseInputs(Workspace&, size_t batch) const;
+
+	//Runs step(i) for every plan step of a level, in parallel if allowed and a scheduler is set
+	template <typename STEP>
+	void _RunLevel(const PlanLevel&, bool parallel, const STEP& step) const;
+
+	//errors = dC/da, or dC/dz when the cost already includes the output activation's derivative
+	//Targets are either desiredOutputs ([batch x output neuron count]) or labels (the index of the output that should be 1)
+	void _SetOutputErrors(Workspace&, size_t batch, const T* desiredOutputs, const uint32* labels) const;
+
+	//INPUT is T or byte, inputs are multiplied by inputScale as they are copied into the input layer
+	template <typename INPUT>
+	void _EvaluateBatch(Workspace&, const INPUT* inputs, T inputScale, size_t batch, T* outputs) const;
+	template <typename INPUT>
+	void _TrainBatch(Workspace&, const INPUT* inputs, T inputScale, size_t batch, const T* desiredOutputs, const uint32* labels, T* outputs) const;
+	template <typename INPUT>
+	void _TrainSample(Workspace&, const INPUT* inputs, T inputScale, const T* desiredOutputs, const uint32* label, T* outputs, double learningRate);
+
+	double _CheckGradients(const T* inputs, size_t batch, const T* desiredOutputs, const uint32* labels, double step);
+
+	//values -= the optimizer's step for the mean gradient gradientScale * pdC, then pdC = 0
+	void _ApplyOptimizer(AlignedBuffer<T>& values, AlignedBuffer<T>& pdC, AlignedBuffer<T>* state, double gradientScale, double learningRate);
+
+	void _Forward(Workspace&, const PlanStep&, size_t batch) const;
+	void _Backward(Workspace&, const PlanStep&, size_t batch) const;
+
+	//CONV layers write z into their state's inputs, pooling layers write their outputs
+	void _ForwardConvolution(Workspace&, const Layer&, size_t batch) const;
+	void _ForwardPooling(Workspace&, const Layer&, size_t batch) const;
+
+	//Cost PDs and input errors of a CONV or pooling layer from its errors (as dC/dz)
+	void _BackwardWindow(Workspace&, const PlanStep&, size_t batch) const;
+
+	void _RelinkLayers()
+	{
+		for (Layer& layer : _layers)
+			layer._network = this;
+	}
 
 public:
-	LayeredNetwork();
-	LayeredNetwork(ByteReader&);
+	LayeredNetworkT();
+	LayeredNetworkT(ByteReader&);
+
+	LayeredNetworkT(LayeredNetworkT&& other) noexcept :
+		_layers(std::move(other._layers)),
+		_plan(std::move(other._plan)),
+		_levels(std::move(other._levels)),
+		_cost(other._cost),
+		_optimizer(other._optimizer),
+		_optimizerSteps(other._optimizerSteps),
+		_scheduler(other._scheduler),
+		_workspace(std::move(other._workspace))
+	{
+		_RelinkLayers();
+	}
+
+	LayeredNetworkT& operator=(LayeredNetworkT&& other) noexcept
+	{
+		_layers = std::move(other._layers);
+		_plan = std::move(other._plan);
+		_levels = std::move(other._levels);
+		_cost = other._cost;
+		_optimizer = other._optimizer;
+		_optimizerSteps = other._optimizerSteps;
+		_scheduler = other._scheduler;
+		_workspace = std::move(other._workspace);
+		_RelinkLayers();
+		other._RelinkLayers();
+		return *this;
+	}
 
 	bool Write(ByteWriter&);
 
 	Layer& CreateLayer() { 
 		Layer& l = _layers.Emplace();
 		l._network = this;
-		return l; 
+		return l;
 	}
 
+	size_t GetLayerCount() const { return _layers.GetSize(); }
+	Layer& GetLayer(size_t index) { return _layers[index]; }
+	const Layer& GetLayer(size_t index) const { return _layers[index]; }
+
+	Workspace& GetWorkspace() { return _workspace; }
+
+	//Independent layers are run on scheduler if set, nullptr to run everything on the calling thread
+	void SetScheduler(TaskScheduler* scheduler) { _scheduler = scheduler; }
+
+	Cost GetCost() const { return _cost; }
+	void SetCost(Cost cost) { _cost = cost; }
+
+	//Replaces the optimizer and discards its state
+	//TrainSample ignores it, Hogwild updates are always plain SGD
+	const Optimizer& GetOptimizer() const { return _optimizer; }
+	void SetOptimizer(const Optimizer&);
+
+	//Zeroes the fraction of the weights of the fully connected layers with the smallest magnitudes
+	//The fraction counts weights already pruned, global ranks every layer's weights together, otherwise each layer is pruned by fraction on its own
+	//Blocks that lose weights are stored sparse from then on, training keeps their zeros. The optimizer state is discarded
+	void PruneWeights(double fraction, bool global);
+
+	//Removes the fraction of the neurons of each hidden layer whose outgoing weights have the smallest total magnitude, at least one is kept
+	//Only fully connected layers that are not part of a residual link and only feed fully connected layers are pruned
+	//Returns the number of neurons removed. The optimizer state is discarded
+	size_t PruneNeurons(double fraction);
+
 	Layer& InputLayer() { return _layers[0]; }
 	Layer& OutputLayer() { return _layers[1]; }
 	Layer& MidLayer(uint32 index) { return _layers[2 + index]; }
@@ -118,14 +450,61 @@ public:
 	//inputCount must equal input neuron count
 	//outputCount must equal output neuron count
 	bool Evaluate(
-		const double* inputs, size_t inputCount, 
-		double* outputs, size_t outputCount);
+		const T* inputs, size_t inputCount,
+		T* outputs, size_t outputCount);
 
-	void BeginTraining();
+	//inputs is a [batch x input neuron count] matrix, one sample per row
+	//outputs receives a [batch x output neuron count] matrix
+	void EvaluateBatch(const T* inputs, size_t batch, T* outputs) { EvaluateBatch(_workspace, inputs, batch, outputs); }
+	void EvaluateBatch(Workspace& workspace, const T* inputs, size_t batch, T* outputs) const { _EvaluateBatch(workspace, inputs, (T)1, batch, outputs); }
 
-	bool Train(
-		const double* inputs, size_t inputCount,
-		const double* desiredOutputs, double* outputs, size_t outputCount);
+	//The overloads taking an inputScale accept inputs stored as INPUT, T or byte (eg. 8 bit pixels)
+	//Each input is multiplied by inputScale as it is copied into the input layer, so the data never needs converting to T first
+	template <typename INPUT>
+	void EvaluateBatch(Workspace& workspace, const INPUT* inputs, T inputScale, size_t batch, T* outputs) const { _EvaluateBatch(workspace, inputs, inputScale, batch, outputs); }
 
-	void ApplyTraining(double learningRate);
+	void BeginTraining() { BeginTraining(_workspace); }
+	void BeginTraining(Workspace&) const;
+
+	bool Train(
+		const T* inputs, size_t inputCount,
+		const T* desiredOutputs, T* outputs, size_t outputCount);
+
+	//Accumulates cost PDs for a whole minibatch
+	//inputs, desiredOutputs and outputs are [batch x neuron count] matrices as in EvaluateBatch
+	void TrainBatch(const T* inputs, size_t batch, const T* desiredOutputs, T* outputs) { TrainBatch(_workspace, inputs, batch, desiredOutputs, outputs); }
+	void TrainBatch(Workspace& workspace, const T* inputs, size_t batch, const T* desiredOutputs, T* outputs) const { _TrainBatch(workspace, inputs, (T)1, batch, desiredOutputs, nullptr, outputs); }
+	template <typename INPUT>
+	void TrainBatch(Workspace& workspace, const INPUT* inputs, T inputScale, size_t batch, const T* desiredOutputs, T* outputs) const { _TrainBatch(workspace, inputs, inputScale, batch, desiredOutputs, nullptr, outputs); }
+
+	//As above for classification, labels[batch] holds the index of the output that should be 1 (the rest 0)
+	void TrainBatch(const T* inputs, size_t batch, const uint32* labels, T* outputs) { TrainBatch(_workspace, inputs, batch, labels, outputs); }
+	void TrainBatch(Workspace& workspace, const T* inputs, size_t batch, const uint32* labels, T* outputs) const { _TrainBatch(workspace, inputs, (T)1, batch, nullptr, labels, outputs); }
+	template <typename INPUT>
+	void TrainBatch(Workspace& workspace, const INPUT* inputs, T inputScale, size_t batch, const uint32* labels, T* outputs) const { _TrainBatch(workspace, inputs, inputScale, batch, nullptr, labels, outputs); }
+
+	//Adds the cost PDs and sample count accumulated in from to those in into
+	void MergeTraining(Workspace& into, const Workspace& from) const;
+
+	void ApplyTraining(double learningRate) { ApplyTraining(_workspace, learningRate); }
+	void ApplyTraining(Workspace&, double learningRate);
+
+	//Backpropagates one sample and applies it to the weights straight away, without locking
+	//Any number of threads may call this at once with their own workspaces, updates racing on the same weight may be lost
+	//Weights whose input activation is 0 are skipped, so sparse inputs touch (and contend on) few weights
+	void TrainSample(Workspace& workspace, const T* inputs, const T* desiredOutputs, T* outputs, double learningRate) { _TrainSample(workspace, inputs, (T)1, desiredOutputs, nullptr, outputs, learningRate); }
+	void TrainSample(Workspace& workspace, const T* inputs, uint32 label, T* outputs, double learningRate) { _TrainSample(workspace, inputs, (T)1, nullptr, &label, outputs, learningRate); }
+	template <typename INPUT>
+	void TrainSample(Workspace& workspace, const INPUT* inputs, T inputScale, const T* desiredOutputs, T* outputs, double learningRate) { _TrainSample(workspace, inputs, inputScale, desiredOutputs, nullptr, outputs, learningRate); }
+	template <typename INPUT>
+	void TrainSample(Workspace& workspace, const INPUT* inputs, T inputScale, uint32 label, T* outputs, double learningRate) { _TrainSample(workspace, inputs, inputScale, nullptr, &label, outputs, learningRate); }
+
+	//Compares the cost PDs backpropagation finds for a batch against central differences of the cost, (C(p + step) - C(p - step)) / 2step,
+	//for every weight and bias. Returns the largest difference relative to the larger PD (PDs below 1e-3 are compared absolutely)
+	//Only meaningful for double networks, float rounding swamps the differences. The network is left as it was
+	double CheckGradients(const T* inputs, size_t batch, const T* desiredOutputs, double step = 1e-5) { return _CheckGradients(inputs, batch, desiredOutputs, nullptr, step); }
+	double CheckGradients(const T* inputs, size_t batch, const uint32* labels, double step = 1e-5) { return _CheckGradients(inputs, batch, nullptr, labels, step); }
 };
+
+using LayeredNetwork = LayeredNetworkT<double>;
+using LayeredNetworkF32 = LayeredNetworkT<float>;
@@ -0,0 +1,93 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Open(const char* filename, Access access)
+{
+	Close();
+
+#ifdef _WIN32
+	//the cache manager takes its read ahead policy from the open flags
+	const DWORD flags = access == Access::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : (access == Access::RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL);
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	CloseHandle(file);
+	if (mapping == nullptr)
+		return false;
+
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (data == nullptr)
+		return false;
+
+	_size = (size_t)size.QuadPart;
+#else
+	const int file = open(filename, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	void* data = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+		data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	close(file);
+	if (data == MAP_FAILED)
+		return false;
+
+	_size = (size_t)status.st_size;
+#endif
+
+	_data = (const byte*)data;
+	Advise(access);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data == nullptr) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+#else
+	munmap((void*)_data, _size);
+#endif
+
+	_data = nullptr;
+	_size = 0;
+}
+
+void MappedFile::Advise(Access access)
+{
+	if (_data == nullptr) return;
+
+#ifdef _WIN32
+	//random access is left to the open flags, there is no way to discourage read ahead on a view
+	if (access == Access::SEQUENTIAL)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range = { (void*)_data, _size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	const int advice = access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : (access == Access::RANDOM ? MADV_RANDOM : MADV_NORMAL);
+	madvise((void*)_data, _size, advice);
+#endif
+}
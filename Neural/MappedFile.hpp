@@ -0,0 +1,65 @@
+#pragma once
+#include <ELCore/Buffer.hpp>
+#include <cstddef>
+
+/*
+	Read only view of a whole file through the OS's memory mapping, pages are read in on first touch and shared with the file cache
+	so nothing is copied up front and untouched parts of the file never take any memory
+
+	The access hint tells the OS how the pages will be touched, so it can read ahead (SEQUENTIAL) or not bother (RANDOM)
+*/
+
+class MappedFile
+{
+public:
+	enum class Access
+	{
+		NORMAL = 0,
+		SEQUENTIAL = 1,		//front to back, possibly once, read ahead aggressively
+		RANDOM = 2			//scattered, no read ahead
+	};
+
+private:
+	//The view keeps the file open, so nothing else needs to be held
+	const byte* _data;
+	size_t _size;
+
+public:
+	MappedFile() : _data(nullptr), _size(0) {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept : _data(other._data), _size(other._size)
+	{
+		other._data = nullptr;
+		other._size = 0;
+	}
+
+	~MappedFile() { Close(); }
+
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			_data = other._data;
+			_size = other._size;
+			other._data = nullptr;
+			other._size = 0;
+		}
+
+		return *this;
+	}
+
+	//Maps the whole of filename, closing any file already mapped
+	//Returns false if it cannot be opened or is empty
+	bool Open(const char* filename, Access access = Access::NORMAL);
+	void Close();
+
+	bool IsOpen() const { return _data != nullptr; }
+
+	//Changes the access hint for the whole mapping
+	void Advise(Access access);
+
+	const byte* GetData() const { return _data; }
+	size_t GetSize() const { return _size; }
+};
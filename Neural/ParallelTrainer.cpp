@@ -0,0 +1,121 @@
+#include "ParallelTrainer.hpp"
+#include <ELMaths/Maths.hpp>
+#include <atomic>
+
+template <typename T>
+void ParallelTrainer<T>::_ReserveWorkspaces()
+{
+	if (_workspaces.GetSize() != _scheduler.GetThreadCount())
+		_workspaces.SetSize(_scheduler.GetThreadCount());
+}
+
+template <typename T>
+size_t ParallelTrainer<T>::GetShardCount(size_t batch)
+{
+	_ReserveWorkspaces();
+
+	return Maths::Max((size_t)1, Maths::Min(batch, _workspaces.GetSize()));
+}
+
+template <typename T>
+void ParallelTrainer<T>::_RunShards(size_t count, const std::function<void(size_t)>& job)
+{
+	TaskGroup group(_scheduler);
+	for (size_t i = 1; i < count; ++i)
+		group.Run([&job, i]() { job(i); });
+
+	if (count > 0) job(0);
+	group.Wait();
+}
+
+template <typename T>
+template <typename INPUT>
+void ParallelTrainer<T>::_EvaluateBatch(const Network& network, const INPUT* inputs, T inputScale, size_t batch, T* outputs)
+{
+	const size_t inputSize = network.GetLayer(0).GetSize();
+	const size_t outputSize = network.GetLayer(1).GetSize();
+	const size_t shards = GetShardCount(batch);
+
+	_RunShards(shards, [&](size_t shard)
+	{
+		const size_t start = batch * shard / shards;
+		const size_t end = batch * (shard + 1) / shards;
+
+		network.EvaluateBatch(_workspaces[shard], inputs + start * inputSize, inputScale, end - start, outputs + start * outputSize);
+	});
+}
+
+template <typename T>
+template <typename INPUT>
+void ParallelTrainer<T>::_TrainBatch(Network& network, const INPUT* inputs, T inputScale, size_t batch, const T* desiredOutputs, const uint32* labels, T* outputs, double learningRate)
+{
+	const size_t inputSize = network.GetLayer(0).GetSize();
+	const size_t outputSize = network.GetLayer(1).GetSize();
+	const size_t shards = GetShardCount(batch);
+
+	_RunShards(shards, [&](size_t shard)
+	{
+		const size_t start = batch * shard / shards;
+		const size_t end = batch * (shard + 1) / shards;
+
+		network.BeginTraining(_workspaces[shard]);
+
+		if (labels)
+			network.TrainBatch(_workspaces[shard], inputs + start * inputSize, inputScale, end - start, labels + start, outputs + start * outputSize);
+		else
+			network.TrainBatch(_workspaces[shard], inputs + start * inputSize, inputScale, end - start, desiredOutputs + start * outputSize, outputs + start * outputSize);
+	});
+
+	//Pairwise reduction into shard 0, every merge at one level is independent
+	for (size_t stride = 1; stride < shards; stride *= 2)
+	{
+		const size_t pairs = (shards - stride + 2 * stride - 1) / (2 * stride);
+
+		_RunShards(pairs, [&](size_t pair)
+		{
+			const size_t into = pair * 2 * stride;
+			network.MergeTraining(_workspaces[into], _workspaces[into + stride]);
+		});
+	}
+
+	network.ApplyTraining(_workspaces[0], learningRate);
+}
+
+template <typename T>
+template <typename INPUT>
+void ParallelTrainer<T>::_TrainHogwild(Network& network, const INPUT* const* inputs, T inputScale, const T* const* desiredOutputs, const uint32* labels, size_t count, double learningRate)
+{
+	_ReserveWorkspaces();
+
+	std::atomic<size_t> nextSample(0);
+
+	//one task per thread, each pulling samples until there are none left
+	_RunShards(Maths::Min(count, _workspaces.GetSize()), [&](size_t thread)
+	{
+		Workspace& workspace = _workspaces[thread];
+
+		Buffer<T> outputs;
+		outputs.SetSize(network.GetLayer(1).GetSize());
+
+		for (size_t i = nextSample.fetch_add(1, std::memory_order_relaxed); i < count; i = nextSample.fetch_add(1, std::memory_order_relaxed))
+		{
+			if (labels)
+				network.TrainSample(workspace, inputs[i], inputScale, labels[i], outputs.Data(), learningRate);
+			else
+				network.TrainSample(workspace, inputs[i], inputScale, desiredOutputs[i], outputs.Data(), learningRate);
+		}
+	});
+}
+
+#define INSTANTIATE_INPUTS(T, INPUT) \
+	template void ParallelTrainer<T>::_EvaluateBatch(const Network&, const INPUT*, T, size_t, T*); \
+	template void ParallelTrainer<T>::_TrainBatch(Network&, const INPUT*, T, size_t, const T*, const uint32*, T*, double); \
+	template void ParallelTrainer<T>::_TrainHogwild(Network&, const INPUT* const*, T, const T* const*, const uint32*, size_t, double);
+
+template class ParallelTrainer<float>;
+template class ParallelTrainer<double>;
+
+INSTANTIATE_INPUTS(float, float)
+INSTANTIATE_INPUTS(float, byte)
+INSTANTIATE_INPUTS(double, double)
+INSTANTIATE_INPUTS(double, byte)
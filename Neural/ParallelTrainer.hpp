@@ -0,0 +1,63 @@
+#pragma once
+#include "LayeredNetwork.hpp"
+#include "TaskScheduler.hpp"
+#include <ELCore/Buffer.hpp>
+
+/*
+	Data parallel minibatch training of a LayeredNetwork
+
+	Each minibatch is cut into contiguous shards, one per scheduler thread, which are backpropagated into their own workspaces
+	The shard gradients are then summed pairwise in a fixed tree (0+1, 2+3, then 0+2...) and applied once
+	Shard boundaries only depend on the batch size and thread count, so for a given thread count training is deterministic
+
+	TrainHogwild is the asynchronous alternative: one task per scheduler thread takes the next sample from a shared counter and
+	updates the weights on its own with LayeredNetwork::TrainSample. There is no reduction or barrier, and no determinism
+*/
+
+template <typename T>
+class ParallelTrainer
+{
+	using Network = LayeredNetworkT<T>;
+	using Workspace = typename Network::Workspace;
+
+	TaskScheduler& _scheduler;
+	Buffer<Workspace> _workspaces;		//One per shard, resized if the scheduler's thread count changes
+
+	void _ReserveWorkspaces();
+
+	//Runs job(i) for i in [0, count) as tasks and waits for them
+	void _RunShards(size_t count, const std::function<void(size_t)>& job);
+
+	//INPUT is T or byte scaled by inputScale, targets are either desiredOutputs or labels, as in LayeredNetwork
+	template <typename INPUT>
+	void _EvaluateBatch(const Network& network, const INPUT* inputs, T inputScale, size_t batch, T* outputs);
+	template <typename INPUT>
+	void _TrainBatch(Network& network, const INPUT* inputs, T inputScale, size_t batch, const T* desiredOutputs, const uint32* labels, T* outputs, double learningRate);
+	template <typename INPUT>
+	void _TrainHogwild(Network& network, const INPUT* const* inputs, T inputScale, const T* const* desiredOutputs, const uint32* labels, size_t count, double learningRate);
+
+public:
+	ParallelTrainer(TaskScheduler& scheduler) : _scheduler(scheduler) {}
+
+	int GetThreadCount() const { return _scheduler.GetThreadCount(); }
+
+	//Shards a batch is split into: one per scheduler thread, as long as each gets at least one sample
+	//Small batches are still spread over every thread, a shard costs one merge of the gradients but leaves no thread idle
+	size_t GetShardCount(size_t batch);
+
+	//Same as LayeredNetwork::EvaluateBatch, byte inputs are multiplied by inputScale as they are read
+	void EvaluateBatch(const Network& network, const T* inputs, size_t batch, T* outputs) { _EvaluateBatch(network, inputs, (T)1, batch, outputs); }
+	void EvaluateBatch(const Network& network, const byte* inputs, T inputScale, size_t batch, T* outputs) { _EvaluateBatch(network, inputs, inputScale, batch, outputs); }
+
+	//Backpropagates the whole batch then applies the averaged gradient, like
+	//BeginTraining + TrainBatch + ApplyTraining on the network
+	void TrainBatch(Network& network, const T* inputs, size_t batch, const T* desiredOutputs, T* outputs, double learningRate) { _TrainBatch(network, inputs, (T)1, batch, desiredOutputs, nullptr, outputs, learningRate); }
+	void TrainBatch(Network& network, const T* inputs, size_t batch, const uint32* labels, T* outputs, double learningRate) { _TrainBatch(network, inputs, (T)1, batch, nullptr, labels, outputs, learningRate); }
+	void TrainBatch(Network& network, const byte* inputs, T inputScale, size_t batch, const uint32* labels, T* outputs, double learningRate) { _TrainBatch(network, inputs, inputScale, batch, nullptr, labels, outputs, learningRate); }
+
+	//Per sample SGD over count samples, inputs[i] and desiredOutputs[i] point to the i'th sample to train on
+	//learningRate is per sample, not averaged over a batch
+	void TrainHogwild(Network& network, const T* const* inputs, const T* const* desiredOutputs, size_t count, double learningRate) { _TrainHogwild(network, inputs, (T)1, desiredOutputs, nullptr, count, learningRate); }
+	void TrainHogwild(Network& network, const T* const* inputs, const uint32* labels, size_t count, double learningRate) { _TrainHogwild(network, inputs, (T)1, nullptr, labels, count, learningRate); }
+	void TrainHogwild(Network& network, const byte* const* inputs, T inputScale, const uint32* labels, size_t count, double learningRate) { _TrainHogwild(network, inputs, inputScale, nullptr, labels, count, learningRate); }
+};
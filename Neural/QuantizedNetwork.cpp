@@ -0,0 +1,164 @@
+#include "QuantizedNetwork.hpp"
+#include "Kernels.hpp"
+#include <ELMaths/Maths.hpp>
+
+namespace
+{
+	constexpr float INT8_RANGE = 127.f;
+
+	//Samples evaluated at once while calibrating
+	constexpr size_t CALIBRATION_BATCH = 256;
+
+	__forceinline float _Abs(float x) { return x < 0.f ? -x : x; }
+
+	__forceinline int8_t _Quantize(float value, float invScale)
+	{
+		const float q = value * invScale;
+		const int rounded = (int)(q < 0.f ? q - 0.5f : q + 0.5f);
+		return (int8_t)(rounded < -127 ? -127 : (rounded > 127 ? 127 : rounded));
+	}
+}
+
+template <typename T>
+bool QuantizedNetwork::Quantize(LayeredNetworkT<T>& network, const T* calibrationInputs, size_t calibrationCount)
+{
+	//Walk back from the output layer to find the layers that contribute to it
+	size_t chainLength = 0;
+	for (int layer = 1; layer != 0; layer = network.GetLayer(layer).GetInputLayer())
+	{
+		if (layer < 0 || chainLength >= network.GetLayerCount())
+			return false;
+
+		//only plain chains of single input, dense fully connected layers are supported
+		const auto& source = network.GetLayer(layer);
+		if (source.GetInputLayerCount() != 1 || source.GetResidualLayer() >= 0 || source.GetInputLinkType() != LayeredNetworkT<T>::LinkingType::ALL || source.IsSparse())
+			return false;
+
+		++chainLength;
+	}
+
+	//chain[i] is the network layer evaluated i'th
+	Buffer<int> chain;
+	chain.SetSize(chainLength);
+
+	size_t i = chainLength;
+	for (int layer = 1; layer != 0; layer = network.GetLayer(layer).GetInputLayer())
+		chain[--i] = layer;
+
+	//Largest activation feeding each layer over the calibration set
+	Buffer<float> maxInputs;
+	maxInputs.SetSize(chainLength);
+	for (float& m : maxInputs)
+		m = 0.f;
+
+	const size_t inputSize = network.InputLayer().GetSize();
+	const size_t outputSize = network.OutputLayer().GetSize();
+
+	Buffer<T> calibrationOutputs;
+	calibrationOutputs.SetSize(CALIBRATION_BATCH * outputSize);
+
+	for (size_t start = 0; start < calibrationCount; start += CALIBRATION_BATCH)
+	{
+		const size_t batch = Maths::Min(CALIBRATION_BATCH, calibrationCount - start);
+		network.EvaluateBatch(calibrationInputs + start * inputSize, batch, calibrationOutputs.Data());
+
+		for (size_t l = 0; l < chainLength; ++l)
+		{
+			const int inputLayer = network.GetLayer(chain[l]).GetInputLayer();
+			const auto& input = network.GetLayer(inputLayer);
+			const T* activations = network.GetWorkspace().GetOutputs(inputLayer);
+
+			for (size_t a = 0; a < batch * input.GetSize(); ++a)
+				maxInputs[l] = Maths::Max(maxInputs[l], _Abs((float)activations[a]));
+		}
+	}
+
+	_inputSize = inputSize;
+	_softmaxOutput = network.GetCost() == LayeredNetworkT<T>::Cost::SOFTMAX_CROSS_ENTROPY;
+	_layers.SetSize(chainLength);
+
+	for (size_t l = 0; l < chainLength; ++l)
+	{
+		const auto& source = network.GetLayer(chain[l]);
+		Layer& layer = _layers[l];
+
+		layer.input = (int)l - 1;
+		layer.size = source.GetSize();
+		layer.inputCount = source.GetInputCount();
+		layer.activation = source.GetActivation();
+
+		//with no calibration data fall back to the range of a sigmoid
+		layer.inputScale = (maxInputs[l] > 0.f ? maxInputs[l] : 1.f) / INT8_RANGE;
+
+		layer.weights.SetSize(layer.size * layer.inputCount);
+		layer.rowScales.SetSize(layer.size);
+		layer.biases.SetSize(layer.size);
+
+		for (size_t n = 0; n < layer.size; ++n)
+		{
+			const T* w = source.GetWeights() + n * layer.inputCount;
+			int8_t* wq = layer.weights.Data() + n * layer.inputCount;
+
+			float maxWeight = 0.f;
+			for (size_t j = 0; j < layer.inputCount; ++j)
+				maxWeight = Maths::Max(maxWeight, _Abs((float)w[j]));
+
+			const float weightScale = (maxWeight > 0.f ? maxWeight : 1.f) / INT8_RANGE;
+			for (size_t j = 0; j < layer.inputCount; ++j)
+				wq[j] = _Quantize((float)w[j], 1.f / weightScale);
+
+			layer.rowScales[n] = layer.inputScale * weightScale;
+			layer.biases[n] = (float)source.GetBiases()[n];
+		}
+
+		layer.quantizedInputs.SetSize(layer.inputCount);
+		layer.sums.SetSize(layer.size);
+		layer.z.SetSize(layer.size);
+		layer.outputs.SetSize(layer.size);
+	}
+
+	return true;
+}
+
+size_t QuantizedNetwork::GetParameterBytes() const
+{
+	size_t bytes = 0;
+	for (const Layer& layer : _layers)
+		bytes += layer.weights.GetSize() * sizeof(int8_t) + (layer.rowScales.GetSize() + layer.biases.GetSize()) * sizeof(float);
+
+	return bytes;
+}
+
+bool QuantizedNetwork::Evaluate(const float* inputs, size_t inputCount, float* outputs, size_t outputCount)
+{
+	if (_layers.GetSize() == 0 || inputCount != _inputSize || outputCount != GetOutputSize())
+		return false;
+
+	for (Layer& layer : _layers)
+	{
+		const float* x = layer.input < 0 ? inputs : _layers[layer.input].outputs.Data();
+
+		const float invScale = 1.f / layer.inputScale;
+		for (size_t i = 0; i < layer.inputCount; ++i)
+			layer.quantizedInputs[i] = _Quantize(x[i], invScale);
+
+		Kernels::MatVecInt8(layer.weights.Data(), layer.quantizedInputs.Data(), layer.sums.Data(), layer.size, layer.inputCount);
+
+		for (size_t n = 0; n < layer.size; ++n)
+			layer.z[n] = (float)layer.sums[n] * layer.rowScales[n];
+
+		if (_softmaxOutput && &layer == &_layers[_layers.GetSize() - 1])
+			Kernels::BiasSoftmax(layer.z.Data(), layer.biases.Data(), layer.outputs.Data(), layer.size);
+		else
+			Kernels::BiasActivate(layer.activation, layer.z.Data(), layer.biases.Data(), layer.outputs.Data(), layer.size);
+	}
+
+	const Layer& outputLayer = _layers[_layers.GetSize() - 1];
+	for (size_t i = 0; i < outputLayer.size; ++i)
+		outputs[i] = outputLayer.outputs[i];
+
+	return true;
+}
+
+template bool QuantizedNetwork::Quantize(LayeredNetworkT<float>&, const float*, size_t);
+template bool QuantizedNetwork::Quantize(LayeredNetworkT<double>&, const double*, size_t);
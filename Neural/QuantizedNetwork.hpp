@@ -0,0 +1,63 @@
+#pragma once
+#include "AlignedBuffer.hpp"
+#include "LayeredNetwork.hpp"
+#include <ELCore/Buffer.hpp>
+#include <cstdint>
+
+/*
+	Inference only copy of a trained LayeredNetwork with int8 weights and activations
+
+	Weights are quantized symmetrically per output row: w ~= weightScale[n] * wq, wq in [-127, 127]
+	The activations feeding each layer share one scale, calibrated from the largest activation seen on a sample of inputs
+	Products are accumulated in int32, then rescaled to float for the bias + activation (softmax on the output layer if the network uses it)
+*/
+
+class QuantizedNetwork
+{
+	struct Layer
+	{
+		int input;				//index into _layers of the layer feeding this one, -1 for the network inputs
+		size_t size;
+		size_t inputCount;
+		Activation activation;
+
+		float inputScale;		//activation ~= inputScale * quantized activation
+
+		AlignedBuffer<int8_t> weights;		//[size x inputCount]
+		AlignedBuffer<float> rowScales;		//inputScale * weight scale of each row, turns the int32 sums back into z
+		AlignedBuffer<float> biases;
+
+		//Per evaluation state
+		AlignedBuffer<int8_t> quantizedInputs;
+		AlignedBuffer<int32_t> sums;
+		AlignedBuffer<float> z;
+		AlignedBuffer<float> outputs;
+
+		Layer() : input(-1), size(0), inputCount(0), activation(Activation::SIGMOID), inputScale(1.f) {}
+	};
+
+	Buffer<Layer> _layers;		//In evaluation order, the last one is the output layer
+	size_t _inputSize;
+	bool _softmaxOutput;
+
+public:
+	QuantizedNetwork() : _inputSize(0), _softmaxOutput(false) {}
+
+	//Replaces this network with a quantized copy of network
+	//calibrationInputs is a [calibrationCount x input neuron count] matrix of representative samples
+	//Returns false if the output layer is not connected to the input layer through a chain of single input, non residual, dense fully connected layers
+	template <typename T>
+	bool Quantize(LayeredNetworkT<T>& network, const T* calibrationInputs, size_t calibrationCount);
+
+	size_t GetInputSize() const { return _inputSize; }
+	size_t GetOutputSize() const { return _layers.GetSize() ? _layers[_layers.GetSize() - 1].size : 0; }
+
+	//Bytes of weights, scales and biases
+	size_t GetParameterBytes() const;
+
+	//inputCount must equal input neuron count
+	//outputCount must equal output neuron count
+	bool Evaluate(
+		const float* inputs, size_t inputCount,
+		float* outputs, size_t outputCount);
+};
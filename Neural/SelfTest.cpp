@@ -0,0 +1,522 @@
+#include "SelfTest.hpp"
+#include "AlignedBuffer.hpp"
+#include "Kernels.hpp"
+#include "LayeredNetwork.hpp"
+#include "ParallelTrainer.hpp"
+#include "TaskScheduler.hpp"
+#include <ELCore/Buffer.hpp>
+#include <ELMaths/Maths.hpp>
+#include <ELMaths/Random.hpp>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	constexpr int KERNEL_TRIALS = 16;
+
+	//Largest vector and matrix dimensions tried
+	constexpr size_t MAX_COUNT = 517;
+	constexpr size_t MAX_ROWS = 37;
+	constexpr size_t MAX_DEPTH = 301;
+
+	//Sharded and whole batch training may only differ by the order the PDs are summed in
+	constexpr double SHARDING_TOLERANCE = 1e-12;
+
+	//Central differences this far from the backpropagated PDs (relative to the larger PD, see CheckGradients) fail
+	constexpr double GRADIENT_TOLERANCE = 1e-5;
+
+	//Odd, so never a multiple of any vector width and the remainder loops always run
+	size_t _OddSize(Random& random, size_t max)
+	{
+		return 1 + 2 * Maths::Min((size_t)(random.NextDouble() * (double)(max / 2 + 1)), max / 2);
+	}
+
+	template <typename T>
+	void _Fill(Random& random, T* values, size_t count, double min, double max)
+	{
+		for (size_t i = 0; i < count; ++i)
+			values[i] = (T)(min + random.NextDouble() * (max - min));
+	}
+
+	//Random CSR matrix of [rows x columns], about a third nonzero
+	void _FillSparse(Random& random, AlignedBuffer<uint32_t>& offsets, AlignedBuffer<uint32_t>& indices, size_t rows, size_t columns)
+	{
+		size_t n = 0;
+
+		for (size_t r = 0; r < rows; ++r)
+		{
+			offsets[r] = (uint32_t)n;
+
+			for (size_t c = 0; c < columns; ++c)
+				if (random.NextDouble() < 1.0 / 3.0)
+					indices[n++] = (uint32_t)c;
+		}
+
+		offsets[rows] = (uint32_t)n;
+	}
+
+	//Runs run(result) with the scalar kernels and then with instructionSet, on the same arguments
+	//Fails on the first element of the results further apart than bound(i, expected value)
+	template <typename T, typename RUN, typename BOUND>
+	bool _Compare(Kernels::InstructionSet instructionSet, const char* kernel, size_t size, size_t count, const RUN& run, const BOUND& bound)
+	{
+		AlignedBuffer<T> expected(count);
+		AlignedBuffer<T> result(count);
+
+		Kernels::SetInstructionSet(Kernels::InstructionSet::SCALAR);
+		run(expected.Data());
+
+		Kernels::SetInstructionSet(instructionSet);
+		run(result.Data());
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const double error = std::abs((double)result[i] - (double)expected[i]);
+			const double allowed = bound(i, (double)expected[i]);
+
+			//written so that NaN fails too
+			if (!(error <= allowed))
+			{
+				std::cout << "    " << kernel << " (size " << size << "): element " << i << " is " << result[i] << ", expected " << expected[i] <<
+					" (error " << error << " > " << allowed << ")\n";
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	template <typename T>
+	bool _CheckKernels(Kernels::InstructionSet instructionSet, Random& random)
+	{
+		const double epsilon = std::numeric_limits<T>::epsilon();
+
+		//Elementwise kernels only round a few times per element, on arguments of at most ~1
+		auto elementwise = [epsilon](size_t, double expected) { return 16.0 * epsilon * (1.0 + std::abs(expected)); };
+
+		AlignedBuffer<T> a(MAX_ROWS * MAX_DEPTH);
+		AlignedBuffer<T> b(MAX_ROWS * MAX_DEPTH);
+		AlignedBuffer<T> c(Maths::Max(MAX_COUNT, MAX_ROWS * MAX_ROWS));
+		AlignedBuffer<T> d(MAX_COUNT);
+		AlignedBuffer<T> scratch(MAX_COUNT);
+		AlignedBuffer<uint32_t> indices(MAX_ROWS * MAX_DEPTH);
+		AlignedBuffer<uint32_t> offsets(MAX_ROWS + 1);
+		Buffer<double> bounds;
+
+		for (int trial = 0; trial < KERNEL_TRIALS; ++trial)
+		{
+			const size_t n = _OddSize(random, MAX_COUNT);
+
+			_Fill(random, a.Data(), n, -1.0, 1.0);
+			_Fill(random, b.Data(), n, -1.0, 1.0);
+			_Fill(random, c.Data(), n, -1.0, 1.0);
+			_Fill(random, d.Data(), n, 0.01, 1.0);
+
+			const T alpha = (T)(random.NextDouble() * 2.0 - 1.0);
+
+			//a rounding error of at most epsilon per term, in either summation order
+			double magnitude = 0.0;
+			for (size_t i = 0; i < n; ++i)
+				magnitude += std::abs((double)a[i] * (double)b[i]);
+
+			const double dotBound = 2.0 * (double)(n + 2) * epsilon * magnitude;
+
+			if (!_Compare<T>(instructionSet, "Dot", n, 1,
+				[&](T* result) { result[0] = Kernels::Dot(a.Data(), b.Data(), n); },
+				[dotBound](size_t, double) { return dotBound; }))
+				return false;
+
+			if (!_Compare<T>(instructionSet, "Axpy", n, n,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					Kernels::Axpy(alpha, a.Data(), result, n);
+				}, elementwise))
+				return false;
+
+			for (size_t i = 0; i < n; ++i)
+				indices[i] = (uint32_t)Maths::Min((size_t)(random.NextDouble() * (double)n), n - 1);
+
+			if (!_Compare<T>(instructionSet, "SparseAxpy", n, n,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					Kernels::SparseAxpy(alpha, a.Data(), indices.Data(), result, n);
+				}, elementwise))
+				return false;
+
+			//the optimizer updates also zero pdC, so it is part of each result after the values and state
+			if (!_Compare<T>(instructionSet, "ApplyGradient", n, n * 2,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					std::memcpy(result + n, b.Data(), n * sizeof(T));
+					Kernels::ApplyGradient(result, result + n, (T)0.1, n);
+				}, elementwise))
+				return false;
+
+			if (!_Compare<T>(instructionSet, "ApplyMomentum", n, n * 3,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					std::memcpy(result + n, a.Data(), n * sizeof(T));
+					std::memcpy(result + n * 2, b.Data(), n * sizeof(T));
+					Kernels::ApplyMomentum(result, result + n * 2, result + n, (T)0.25, (T)0.9, (T)0.1, (T)0.09, n);
+				}, elementwise))
+				return false;
+
+			if (!_Compare<T>(instructionSet, "ApplyRMSProp", n, n * 3,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					std::memcpy(result + n, d.Data(), n * sizeof(T));
+					std::memcpy(result + n * 2, b.Data(), n * sizeof(T));
+					Kernels::ApplyRMSProp(result, result + n * 2, result + n, (T)0.25, (T)0.9, (T)0.01, (T)1e-8, n);
+				}, elementwise))
+				return false;
+
+			if (!_Compare<T>(instructionSet, "ApplyAdam", n, n * 4,
+				[&](T* result)
+				{
+					std::memcpy(result, c.Data(), n * sizeof(T));
+					std::memcpy(result + n, a.Data(), n * sizeof(T));
+					std::memcpy(result + n * 2, d.Data(), n * sizeof(T));
+					std::memcpy(result + n * 3, b.Data(), n * sizeof(T));
+					Kernels::ApplyAdam(result, result + n * 3, result + n, result + n * 2, (T)0.25, (T)0.9, (T)0.999, (T)0.001, (T)1e-8, n);
+				}, elementwise))
+				return false;
+
+			for (size_t i = 0; i < ACTIVATION_COUNT; ++i)
+			{
+				const Activation activation = (Activation)i;
+
+				//mostly where the activations curve, some far enough out that the sigmoid clamps
+				for (size_t j = 0; j < n; ++j)
+					scratch[j] = (T)((random.NextDouble() * 2.0 - 1.0) * (random.NextDouble() < 0.125 ? 50.0 : 8.0));
+
+				//z is a plain sum, a may differ by the sigmoid's approximation error (tanh's is twice it)
+				const double sigmoidError = Kernels::GetSigmoidMaxError<T>();
+				const double activationError = activation == Activation::SIGMOID ? sigmoidError : activation == Activation::TANH ? sigmoidError * 2.0 : 0.0;
+
+				if (!_Compare<T>(instructionSet, "BiasActivate", n, n * 2,
+					[&](T* result)
+					{
+						std::memcpy(result, scratch.Data(), n * sizeof(T));
+						Kernels::BiasActivate(activation, result, a.Data(), result + n, n);
+					},
+					[&](size_t j, double expected) { return elementwise(j, expected) + (j >= n ? activationError : 0.0); }))
+					return false;
+
+				//stored outputs in the activation's range
+				const bool signedOutputs = activation == Activation::TANH || activation == Activation::LEAKY_RELU;
+				_Fill(random, scratch.Data(), n, signedOutputs ? -1.0 : 0.0, 1.0);
+
+				if (!_Compare<T>(instructionSet, "MulActivationPrime", n, n,
+					[&](T* result)
+					{
+						std::memcpy(result, b.Data(), n * sizeof(T));
+						Kernels::MulActivationPrime(activation, result, scratch.Data(), n);
+					}, elementwise))
+					return false;
+			}
+
+			//Products, c[m x p] from a depth of k, so the 4 x 4 tiles and the rows and columns left over them all run
+			const size_t m = _OddSize(random, MAX_ROWS);
+			const size_t p = _OddSize(random, MAX_ROWS);
+			const size_t k = _OddSize(random, MAX_DEPTH);
+			const bool accumulate = random.NextDouble() < 0.5;
+
+			_Fill(random, a.Data(), m * k, -1.0, 1.0);
+			_Fill(random, b.Data(), p * k, -1.0, 1.0);
+			_Fill(random, c.Data(), m * p, -1.0, 1.0);
+
+			//element (i, j) of the product bounded by the sum of |a(i, q) * b(q, j)|, with a and b read through the given strides
+			auto productBounds = [&](size_t aRow, size_t aColumn, size_t bRow, size_t bColumn)
+			{
+				bounds.SetSize(m * p);
+
+				for (size_t i = 0; i < m; ++i)
+					for (size_t j = 0; j < p; ++j)
+					{
+						double sum = accumulate ? std::abs((double)c[i * p + j]) : 0.0;
+						for (size_t q = 0; q < k; ++q)
+							sum += std::abs((double)a[i * aRow + q * aColumn] * (double)b[q * bRow + j * bColumn]);
+
+						bounds[i * p + j] = 2.0 * (double)(k + 2) * epsilon * sum;
+					}
+			};
+
+			auto product = [&](auto multiply)
+			{
+				return [&, multiply](T* result)
+				{
+					std::memcpy(result, c.Data(), m * p * sizeof(T));
+					multiply(result);
+				};
+			};
+
+			auto productBound = [&bounds](size_t i, double) { return bounds[i]; };
+
+			productBounds(k, 1, 1, k);
+			if (!_Compare<T>(instructionSet, "MatMulABt", k, m * p,
+				product([&](T* result) { Kernels::MatMulABt(a.Data(), b.Data(), result, m, p, k, accumulate); }), productBound))
+				return false;
+
+			productBounds(k, 1, p, 1);
+			if (!_Compare<T>(instructionSet, "MatMulAB", k, m * p,
+				product([&](T* result) { Kernels::MatMulAB(a.Data(), b.Data(), result, m, p, k, accumulate); }), productBound))
+				return false;
+
+			productBounds(1, m, p, 1);
+			if (!_Compare<T>(instructionSet, "MatMulAtB", k, m * p,
+				product([&](T* result) { Kernels::MatMulAtB(a.Data(), b.Data(), result, m, p, k, accumulate); }), productBound))
+				return false;
+
+			//c = a * transpose(W), W a [p x k] CSR matrix with its values in b
+			_FillSparse(random, offsets, indices, p, k);
+
+			bounds.SetSize(m * p);
+			for (size_t i = 0; i < m; ++i)
+				for (size_t j = 0; j < p; ++j)
+				{
+					double sum = accumulate ? std::abs((double)c[i * p + j]) : 0.0;
+					for (size_t q = offsets[j]; q < offsets[j + 1]; ++q)
+						sum += std::abs((double)a[i * k + indices[q]] * (double)b[q]);
+
+					bounds[i * p + j] = 2.0 * (double)(k + 2) * epsilon * sum;
+				}
+
+			if (!_Compare<T>(instructionSet, "SparseMatMulABt", k, m * p,
+				product([&](T* result) { Kernels::SparseMatMulABt(a.Data(), offsets.Data(), indices.Data(), b.Data(), result, m, p, k, accumulate); }), productBound))
+				return false;
+		}
+
+		return true;
+	}
+
+	//int8 products are exact, so these must match bit for bit
+	bool _CheckMatVecInt8(Kernels::InstructionSet instructionSet, Random& random)
+	{
+		AlignedBuffer<int8_t> a(MAX_ROWS * MAX_COUNT);
+		AlignedBuffer<int8_t> x(MAX_COUNT);
+		AlignedBuffer<int32_t> expected(MAX_ROWS);
+		AlignedBuffer<int32_t> result(MAX_ROWS);
+
+		for (int trial = 0; trial < KERNEL_TRIALS; ++trial)
+		{
+			const size_t rows = _OddSize(random, MAX_ROWS);
+			const size_t columns = _OddSize(random, MAX_COUNT);
+
+			for (size_t i = 0; i < rows * columns; ++i)
+				a[i] = (int8_t)Maths::Min((int)(random.NextDouble() * 255.0) - 127, 127);
+
+			for (size_t i = 0; i < columns; ++i)
+				x[i] = (int8_t)Maths::Min((int)(random.NextDouble() * 255.0) - 127, 127);
+
+			Kernels::SetInstructionSet(Kernels::InstructionSet::SCALAR);
+			Kernels::MatVecInt8(a.Data(), x.Data(), expected.Data(), rows, columns);
+
+			Kernels::SetInstructionSet(instructionSet);
+			Kernels::MatVecInt8(a.Data(), x.Data(), result.Data(), rows, columns);
+
+			for (size_t i = 0; i < rows; ++i)
+			{
+				if (result[i] != expected[i])
+				{
+					std::cout << "    MatVecInt8 (size " << columns << "): row " << i << " is " << result[i] << ", expected " << expected[i] << '\n';
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//Small graph with every kind of link:
+	//input (2 planes of 6 x 6) -> CONV (3 kernels of 3 x 3, padded) -> MAX_POOL 2 x 2 -> 27 (+ the input, + the pool's activations as a residual)
+	//-> 9 (+ the CONV planes, + 4 bias only neurons) -> output (+ the pool)
+	//Mid layers alternate tanh and sigmoid, ReLUs are left out as their kink would show up in the differences
+	void _CreateGraph(LayeredNetwork& network, Random& random, LayeredNetwork::Cost cost, size_t outputs)
+	{
+		using Network = LayeredNetwork;
+
+		network.SetCost(cost);
+		network.InputLayer().Generate(Network::Shape(6, 6, 2));
+		network.OutputLayer().Generate(outputs);
+
+		Network::Layer& conv = network.CreateLayer();
+		conv.SetActivation(Activation::TANH);
+		conv.SetInputWindow(Network::LinkingType::CONV, Network::Window(3, 1, 1, 3));
+
+		network.CreateLayer().SetInputWindow(Network::LinkingType::MAX_POOL, Network::Window(2, 2));
+
+		Network::Layer& hidden = network.CreateLayer();
+		hidden.Generate(27);
+		hidden.SetInputLinkType(Network::LinkingType::ALL);
+		hidden.AddInput(0);
+		hidden.SetResidualLayer(3);
+
+		Network::Layer& narrow = network.CreateLayer();
+		narrow.SetActivation(Activation::TANH);
+		narrow.Generate(9);
+		narrow.SetInputLinkType(Network::LinkingType::ALL);
+		narrow.AddInput(2);
+
+		//no inputs, so only its biases train
+		Network::Layer& biasOnly = network.CreateLayer();
+		biasOnly.SetActivation(Activation::TANH);
+		biasOnly.Generate(4);
+
+		network.GetLayer(5).AddInput(6);
+
+		network.OutputLayer().SetInputLinkType(Network::LinkingType::ALL);
+		network.OutputLayer().AddInput(3);
+
+		//after linking, added inputs start with 0 weights
+		for (size_t i = 1; i < network.GetLayerCount(); ++i)
+			network.GetLayer(i).RandomiseWeightsAndBiases(random);
+	}
+}
+
+bool SelfTest::CheckKernels(uint32_t seed)
+{
+	const Kernels::InstructionSet current = Kernels::GetInstructionSet();
+	Random random(seed);
+	bool passed = true;
+
+	for (int i = (int)Kernels::InstructionSet::SSE2; i <= (int)Kernels::GetSupportedInstructionSet() && passed; ++i)
+	{
+		const Kernels::InstructionSet instructionSet = (Kernels::InstructionSet)i;
+
+		std::cout << "  " << Kernels::GetInstructionSetName(instructionSet) << " kernels against scalar...\n";
+
+		passed = _CheckKernels<float>(instructionSet, random) && _CheckKernels<double>(instructionSet, random) && _CheckMatVecInt8(instructionSet, random);
+	}
+
+	Kernels::SetInstructionSet(current);
+	std::cout << (passed ? "  Kernels OK\n" : "  KERNELS FAILED\n");
+	return passed;
+}
+
+bool SelfTest::CheckGradients(uint32_t seed, TaskScheduler* scheduler)
+{
+	//The exact exponential, the polynomial's error would show up in the differences
+	const Kernels::InstructionSet current = Kernels::GetInstructionSet();
+	Kernels::SetInstructionSet(Kernels::InstructionSet::SCALAR);
+
+	Random random(seed);
+	constexpr size_t BATCH = 3;
+	constexpr size_t OUTPUTS = 5;
+
+	bool passed = true;
+
+	for (int c = 0; c < 2 && passed; ++c)
+	{
+		const LayeredNetwork::Cost cost = c ? LayeredNetwork::Cost::SOFTMAX_CROSS_ENTROPY : LayeredNetwork::Cost::QUADRATIC;
+
+		LayeredNetwork network;
+		network.SetScheduler(scheduler);
+		_CreateGraph(network, random, cost, OUTPUTS);
+
+		//dense inputs for one cost, mostly 0 for the other so the sparse input products run too
+		const size_t inputSize = network.InputLayer().GetSize();
+		AlignedBuffer<double> inputs(BATCH * inputSize);
+
+		for (size_t i = 0; i < BATCH * inputSize; ++i)
+			inputs[i] = !c || random.NextDouble() < 0.1 ? random.NextDouble() : 0.0;
+
+		double error;
+		if (cost == LayeredNetwork::Cost::QUADRATIC)
+		{
+			AlignedBuffer<double> desiredOutputs(BATCH * OUTPUTS);
+			_Fill(random, desiredOutputs.Data(), BATCH * OUTPUTS, 0.0, 1.0);
+
+			error = network.CheckGradients(inputs.Data(), BATCH, desiredOutputs.Data());
+		}
+		else
+		{
+			uint32 labels[BATCH];
+			for (size_t i = 0; i < BATCH; ++i)
+				labels[i] = (uint32)Maths::Min((size_t)(random.NextDouble() * OUTPUTS), OUTPUTS - 1);
+
+			error = network.CheckGradients(inputs.Data(), BATCH, labels);
+		}
+
+		passed = error <= GRADIENT_TOLERANCE;
+
+		std::cout << "  " << (c ? "Softmax cross-entropy" : "Quadratic") << " cost gradients: largest relative error " << error <<
+			(passed ? "\n" : " (FAILED)\n");
+	}
+
+	Kernels::SetInstructionSet(current);
+	return passed;
+}
+
+bool SelfTest::CheckParallelTraining(uint32_t seed)
+{
+	constexpr int THREADS = 16;
+	constexpr size_t BATCH = 10;	//Digits' default
+	constexpr size_t OUTPUTS = 5;
+
+	TaskScheduler scheduler(THREADS);
+	ParallelTrainer<double> trainer(scheduler);
+
+	const size_t shards = trainer.GetShardCount(BATCH);
+	std::cout << "  Batch of " << BATCH << " over " << THREADS << " threads: " << shards << " shards";
+
+	if (shards != Maths::Min(BATCH, (size_t)THREADS))
+	{
+		std::cout << " (FAILED, expected " << Maths::Min(BATCH, (size_t)THREADS) << ")\n";
+		return false;
+	}
+
+	std::cout << '\n';
+
+	//the same network twice, one trained sharded and one in one piece
+	Random shardedRandom(seed);
+	Random wholeRandom(seed);
+	LayeredNetwork sharded;
+	LayeredNetwork whole;
+	_CreateGraph(sharded, shardedRandom, LayeredNetwork::Cost::SOFTMAX_CROSS_ENTROPY, OUTPUTS);
+	_CreateGraph(whole, wholeRandom, LayeredNetwork::Cost::SOFTMAX_CROSS_ENTROPY, OUTPUTS);
+
+	Random random(seed);
+	const size_t inputSize = whole.InputLayer().GetSize();
+	AlignedBuffer<double> inputs(BATCH * inputSize);
+	AlignedBuffer<double> outputs(BATCH * OUTPUTS);
+	_Fill(random, inputs.Data(), BATCH * inputSize, 0.0, 1.0);
+
+	uint32 labels[BATCH];
+	for (size_t i = 0; i < BATCH; ++i)
+		labels[i] = (uint32)Maths::Min((size_t)(random.NextDouble() * OUTPUTS), OUTPUTS - 1);
+
+	trainer.TrainBatch(sharded, inputs.Data(), BATCH, labels, outputs.Data(), 0.5);
+
+	whole.BeginTraining();
+	whole.TrainBatch(inputs.Data(), BATCH, labels, outputs.Data());
+	whole.ApplyTraining(0.5);
+
+	double difference = 0.0;
+	for (size_t l = 1; l < whole.GetLayerCount(); ++l)
+	{
+		const LayeredNetwork::Layer& a = sharded.GetLayer(l);
+		const LayeredNetwork::Layer& b = whole.GetLayer(l);
+
+		for (size_t i = 0; i < a.GetWeightCount(); ++i)
+			difference = Maths::Max(difference, std::abs(a.GetWeights()[i] - b.GetWeights()[i]));
+
+		//pooling layers have no biases, CONV layers one per channel
+		const LayeredNetwork::LinkingType linkType = a.GetInputLinkType();
+		const size_t biases = linkType == LayeredNetwork::LinkingType::CONV ? a.GetWindow().channels :
+			linkType == LayeredNetwork::LinkingType::MAX_POOL || linkType == LayeredNetwork::LinkingType::AVG_POOL ? 0 : a.GetSize();
+
+		for (size_t i = 0; i < biases; ++i)
+			difference = Maths::Max(difference, std::abs(a.GetBiases()[i] - b.GetBiases()[i]));
+	}
+
+	const bool passed = difference <= SHARDING_TOLERANCE;
+	std::cout << "  Sharded against whole batch training: largest difference " << difference << (passed ? "\n" : " (FAILED)\n");
+	return passed;
+}
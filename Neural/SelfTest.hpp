@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+class TaskScheduler;
+
+/*
+	Checks of the numerics that are easy to get subtly wrong, run from the console (see Digits' selftest command)
+
+	CheckKernels runs every entry of every supported SIMD KernelTable against the scalar reference on the same random arguments,
+	with odd sizes so the remainder loops after the last full vector run too. Results must agree to within the rounding the
+	operation allows (and the sigmoid's approximation error), the int8 products exactly
+
+	CheckGradients backpropagates a small graph with every kind of link (CONV, pooling, several inputs, a residual and a
+	layer with only biases) under both costs, and compares each weight and bias PD against central differences of the cost
+
+	CheckParallelTraining splits Digits' default minibatch over as many threads as a big machine has, whatever this one has,
+	checks every thread gets a shard and that the result matches training the batch in one piece
+
+	All of them print what they check and return false on the first failure
+*/
+
+namespace SelfTest
+{
+	bool CheckKernels(uint32_t seed);
+
+	//Layers of the same level run on scheduler if not null
+	bool CheckGradients(uint32_t seed, TaskScheduler* scheduler = nullptr);
+
+	bool CheckParallelTraining(uint32_t seed);
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "Activation.hpp"
+#include "LayeredNetwork.hpp"
+#include <ELCore/ByteReader.hpp>
+#include <ELMaths/Maths.hpp>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+/*
+	Inference only copy of a LayeredNetwork whose shape is fixed at compile time, e.g. StaticNetworkT<float, 784, 30, 10>
+	SIZES are the neuron counts of a plain chain: the input layer, then each mid layer in evaluation order, then the output layer
+
+	Parameters are std::arrays inside the object and every loop bound is a constant, so the compiler can unroll and vectorise
+	the whole evaluation. Evaluate does no allocation, its activations are small arrays on the stack
+	(the object itself holds every weight, keep large ones static rather than on the stack)
+
+	Weights are stored input-major ([inputs x neurons], the transpose of LayeredNetwork) so the inner loop
+	adds one input's contribution to every neuron, which vectorises without reordering any sums
+
+	Loading goes through LayeredNetwork, so it reads the same netfiles and allocates only while loading
+*/
+
+template <typename T, size_t... SIZES>
+class StaticNetworkT
+{
+	static_assert(sizeof...(SIZES) >= 2, "StaticNetwork needs at least an input and an output layer size");
+
+	static constexpr std::array<size_t, sizeof...(SIZES)> _sizes = { SIZES... };
+
+public:
+	static constexpr size_t LAYER_COUNT = sizeof...(SIZES) - 1;		//Weighted layers, excluding the input layer
+	static constexpr size_t INPUT_SIZE = _sizes[0];
+	static constexpr size_t OUTPUT_SIZE = _sizes[LAYER_COUNT];
+
+private:
+	template <size_t INPUTS, size_t NEURONS>
+	struct Layer
+	{
+		std::array<T, INPUTS * NEURONS> weights;		//[INPUTS x NEURONS]
+		std::array<T, NEURONS> biases;
+		Activation activation = Activation::SIGMOID;
+	};
+
+	//Layer L takes the activations of layer L - 1 (or the inputs) and feeds layer L + 1 (or the outputs)
+	template <size_t L>
+	using LayerAt = Layer<_sizes[L], _sizes[L + 1]>;
+
+	template <size_t... L>
+	static std::tuple<LayerAt<L>...> _MakeLayers(std::index_sequence<L...>);
+
+	decltype(_MakeLayers(std::make_index_sequence<LAYER_COUNT>())) _layers;
+	bool _softmaxOutput;
+
+	//The switch is outside the loop so that each case is a plain loop over COUNT values
+	template <size_t COUNT>
+	static void _Activate(Activation activation, const std::array<T, COUNT>& z, T* a)
+	{
+		switch (activation)
+		{
+		case Activation::SIGMOID:
+			for (size_t i = 0; i < COUNT; ++i)
+				a[i] = (T)(1.0 / (1.0 + Maths::Exp(-(double)z[i])));
+			break;
+		case Activation::RELU:
+			for (size_t i = 0; i < COUNT; ++i)
+				a[i] = z[i] > 0 ? z[i] : 0;
+			break;
+		case Activation::LEAKY_RELU:
+			for (size_t i = 0; i < COUNT; ++i)
+				a[i] = z[i] > 0 ? z[i] : (T)LEAKY_RELU_SLOPE * z[i];
+			break;
+		case Activation::TANH:
+			for (size_t i = 0; i < COUNT; ++i)
+				a[i] = (T)std::tanh((double)z[i]);
+			break;
+		}
+	}
+
+	template <size_t COUNT>
+	static void _Softmax(const std::array<T, COUNT>& z, T* a)
+	{
+		T max = z[0];
+		for (size_t i = 1; i < COUNT; ++i)
+			max = Maths::Max(max, z[i]);
+
+		double sum = 0.0;
+		for (size_t i = 0; i < COUNT; ++i)
+			sum += a[i] = (T)Maths::Exp((double)(z[i] - max));
+
+		const T invSum = (T)(1.0 / sum);
+		for (size_t i = 0; i < COUNT; ++i)
+			a[i] *= invSum;
+	}
+
+	template <size_t L>
+	void _Evaluate(const T* x, T* outputs) const
+	{
+		constexpr size_t INPUTS = _sizes[L];
+		constexpr size_t NEURONS = _sizes[L + 1];
+		const LayerAt<L>& layer = std::get<L>(_layers);
+
+		std::array<T, NEURONS> z = layer.biases;
+		for (size_t i = 0; i < INPUTS; ++i)
+		{
+			const T input = x[i];
+			const T* w = layer.weights.data() + i * NEURONS;
+
+			for (size_t n = 0; n < NEURONS; ++n)
+				z[n] += input * w[n];
+		}
+
+		if constexpr (L + 1 == LAYER_COUNT)
+		{
+			if (_softmaxOutput)
+				_Softmax(z, outputs);
+			else
+				_Activate(layer.activation, z, outputs);
+		}
+		else
+		{
+			std::array<T, NEURONS> a;
+			_Activate(layer.activation, z, a.data());
+			_Evaluate<L + 1>(a.data(), outputs);
+		}
+	}
+
+	template <size_t L, typename U>
+	void _AssignLayer(const typename LayeredNetworkT<U>::Layer& source)
+	{
+		constexpr size_t INPUTS = _sizes[L];
+		constexpr size_t NEURONS = _sizes[L + 1];
+		LayerAt<L>& layer = std::get<L>(_layers);
+
+		for (size_t n = 0; n < NEURONS; ++n)
+		{
+			for (size_t i = 0; i < INPUTS; ++i)
+				layer.weights[i * NEURONS + n] = (T)source.GetWeights()[n * INPUTS + i];
+
+			layer.biases[n] = (T)source.GetBiases()[n];
+		}
+
+		layer.activation = source.GetActivation();
+	}
+
+	template <typename U, size_t... L>
+	void _AssignLayers(const LayeredNetworkT<U>& network, const int* chain, std::index_sequence<L...>)
+	{
+		(_AssignLayer<L, U>(network.GetLayer(chain[L])), ...);
+	}
+
+public:
+	StaticNetworkT() : _layers(), _softmaxOutput(false) {}
+
+	//Bytes of weights and biases
+	static constexpr size_t GetParameterBytes()
+	{
+		size_t count = 0;
+		for (size_t l = 0; l < LAYER_COUNT; ++l)
+			count += (_sizes[l] + 1) * _sizes[l + 1];
+
+		return count * sizeof(T);
+	}
+
+	//Replaces the parameters with those of network
+	//Returns false (leaving this network unchanged) unless network's output layer is connected to its input layer
+	//through a chain of single input, non residual, dense fully connected layers of exactly SIZES
+	template <typename U>
+	bool Assign(const LayeredNetworkT<U>& network)
+	{
+		//chain[l] is the network layer evaluated l'th, found by walking back from the output layer
+		int chain[LAYER_COUNT];
+
+		int layer = 1;
+		for (size_t l = LAYER_COUNT; l-- > 0;)
+		{
+			//0 is the input layer, reaching it here means the chain is too short
+			if (layer <= 0)
+				return false;
+
+			const auto& source = network.GetLayer(layer);
+			if (source.GetInputLayerCount() != 1 || source.GetResidualLayer() >= 0 || source.GetInputLinkType() != LayeredNetworkT<U>::LinkingType::ALL || source.IsSparse() ||
+				source.GetSize() != _sizes[l + 1] || source.GetInputCount() != _sizes[l])
+				return false;
+
+			chain[l] = layer;
+			layer = source.GetInputLayer();
+		}
+
+		if (layer != 0)
+			return false;
+
+		_AssignLayers(network, chain, std::make_index_sequence<LAYER_COUNT>());
+		_softmaxOutput = network.GetCost() == LayeredNetworkT<U>::Cost::SOFTMAX_CROSS_ENTROPY;
+		return true;
+	}
+
+	//Reads a netfile written by LayeredNetwork::Write
+	//Returns false if it is not a valid netfile or its shape is not SIZES
+	bool Read(ByteReader& reader)
+	{
+		try
+		{
+			return Assign(LayeredNetworkT<T>(reader));
+		}
+		catch (int)
+		{
+			return false;
+		}
+	}
+
+	//inputs is [INPUT_SIZE], outputs receives [OUTPUT_SIZE]
+	void Evaluate(const T* inputs, T* outputs) const
+	{
+		_Evaluate<0>(inputs, outputs);
+	}
+};
+
+template <size_t... SIZES>
+using StaticNetwork = StaticNetworkT<double, SIZES...>;
+
+template <size_t... SIZES>
+using StaticNetworkF32 = StaticNetworkT<float, SIZES...>;
@@ -0,0 +1,230 @@
+#include "TaskScheduler.hpp"
+
+namespace
+{
+	//Which scheduler the current thread works for, and its index in it
+	thread_local const TaskScheduler* _currentScheduler = nullptr;
+	thread_local int _currentThread = 0;
+
+	//Chunks per thread in ParallelFor, a few extra give stealing something to balance with
+	constexpr size_t CHUNKS_PER_THREAD = 4;
+}
+
+TaskScheduler::TaskScheduler(int threadCount) : _queuedTasks(0), _activity(0), _stopping(false)
+{
+	_Start(threadCount);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	_Stop();
+}
+
+void TaskScheduler::_Start(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+
+	if (threadCount <= 0)
+		threadCount = 1;
+
+	_stopping = false;
+
+	for (int i = 0; i < threadCount; ++i)
+		_queues.push_back(std::make_unique<Queue>());
+
+	for (int i = 1; i < threadCount; ++i)
+		_workers.emplace_back(&TaskScheduler::_WorkerMain, this, i);
+}
+
+void TaskScheduler::_Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_stopping = true;
+	}
+
+	_wake.notify_all();
+
+	for (std::thread& worker : _workers)
+		worker.join();
+
+	_workers.clear();
+	_queues.clear();
+}
+
+void TaskScheduler::SetThreadCount(int threadCount)
+{
+	_Stop();
+	_Start(threadCount);
+}
+
+int TaskScheduler::GetThreadIndex() const
+{
+	return _currentScheduler == this ? _currentThread : 0;
+}
+
+bool TaskScheduler::_IsPoolThread() const
+{
+	return _currentScheduler == this;
+}
+
+void TaskScheduler::_WorkerMain(int thread)
+{
+	_currentScheduler = this;
+	_currentThread = thread;
+
+	while (true)
+	{
+		if (_RunOne()) continue;
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_wake.wait(lock, [this]() { return _stopping || _queuedTasks.load() > 0; });
+
+		if (_stopping) return;
+	}
+}
+
+void TaskScheduler::_Push(Task&& task)
+{
+	Queue& queue = *_queues[GetThreadIndex()];
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	++_queuedTasks;
+
+	//taking the lock orders this against a worker that has just checked _queuedTasks and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+	}
+
+	_wake.notify_one();
+
+	//pool threads blocked in TaskGroup::Wait can help with it
+	_Signal();
+}
+
+void TaskScheduler::_Signal()
+{
+	_activity.fetch_add(1, std::memory_order_release);
+	_activity.notify_all();
+}
+
+bool TaskScheduler::_Pop(int thread, Task& task)
+{
+	//own queue first, newest task
+	{
+		Queue& queue = *_queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			--_queuedTasks;
+			return true;
+		}
+	}
+
+	//then steal the oldest task of the next thread along that has any
+	const int threadCount = GetThreadCount();
+	for (int i = 1; i < threadCount; ++i)
+	{
+		Queue& queue = *_queues[(thread + i) % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			--_queuedTasks;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskScheduler::_PopGroup(const TaskGroup* group, Task& task)
+{
+	Queue& queue = *_queues[0];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	for (auto i = queue.tasks.rbegin(); i != queue.tasks.rend(); ++i)
+	{
+		if (i->group == group)
+		{
+			task = std::move(*i);
+			queue.tasks.erase(std::next(i).base());
+			--_queuedTasks;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TaskScheduler::_RunOne(const TaskGroup* group)
+{
+	if (_queuedTasks.load() <= 0) return false;
+
+	Task task;
+	if (!(group ? _PopGroup(group, task) : _Pop(GetThreadIndex(), task))) return false;
+
+	task.function();
+
+	//the group may be destroyed as soon as this reaches 0, waiters are woken through the scheduler instead
+	task.group->_pending.fetch_sub(1, std::memory_order_release);
+	_Signal();
+	return true;
+}
+
+void TaskScheduler::ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (end <= begin) return;
+
+	const size_t count = end - begin;
+	if (grainSize == 0) grainSize = 1;
+
+	size_t chunks = (count + grainSize - 1) / grainSize;
+	if (chunks > GetThreadCount() * CHUNKS_PER_THREAD)
+		chunks = GetThreadCount() * CHUNKS_PER_THREAD;
+
+	if (chunks <= 1 || GetThreadCount() == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	TaskGroup group(*this);
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+		group.Run([&body, begin, count, chunks, chunk]() { body(begin + count * chunk / chunks, begin + count * (chunk + 1) / chunks); });
+
+	body(begin, begin + count / chunks);
+	group.Wait();
+}
+
+void TaskGroup::Run(std::function<void()> task)
+{
+	_pending.fetch_add(1, std::memory_order_relaxed);
+	_scheduler._Push(TaskScheduler::Task{ std::move(task), this });
+}
+
+void TaskGroup::Wait()
+{
+	const TaskGroup* only = _scheduler._IsPoolThread() ? nullptr : this;
+
+	while (_pending.load(std::memory_order_acquire) > 0)
+	{
+		//read before checking for work, so a task queued or finished after the check ends the wait straight away
+		const uint32_t activity = _scheduler._activity.load(std::memory_order_acquire);
+
+		if (_scheduler._RunOne(only)) continue;
+
+		if (_pending.load(std::memory_order_acquire) > 0)
+			_scheduler._activity.wait(activity, std::memory_order_acquire);
+	}
+}
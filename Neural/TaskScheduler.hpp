@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Work stealing task scheduler, the one set of worker threads used by everything in the project
+
+	Every thread has its own task queue, which it pushes to and pops from at the back (newest first, still hot in cache)
+	Threads that run out of work steal the oldest task from the front of another queue, which tends to be the biggest piece left
+	A pool thread waiting on a TaskGroup keeps running tasks (of any group) instead of blocking, so groups may be waited on from inside tasks
+
+	Any number of threads outside the pool (the main thread, a loader thread) may use it too. They share queue 0, which the pool
+	steals from, but when they wait they only help with their own group's tasks, so no outside thread ever runs another one's work
+	Once there is nothing left to help with, waiting threads block until a task finishes or is queued rather than spinning
+*/
+
+class TaskGroup;
+
+class TaskScheduler
+{
+	friend TaskGroup;
+
+	struct Task
+	{
+		std::function<void()> function;
+		TaskGroup* group;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> _queues;		//[thread count], worker i owns queue i + 1
+	std::vector<std::thread> _workers;
+
+	std::atomic<int> _queuedTasks;
+
+	//Bumped whenever a task is queued or finishes, what waiting threads block on
+	std::atomic<uint32_t> _activity;
+
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	bool _stopping;
+
+	void _Start(int threadCount);
+	void _Stop();
+
+	void _WorkerMain(int thread);
+
+	void _Push(Task&& task);
+	bool _Pop(int thread, Task& task);
+
+	//Newest task of group in queue 0, for threads outside the pool
+	bool _PopGroup(const TaskGroup* group, Task& task);
+
+	//Runs one queued task (of group only, if not null) if there are any, returns false otherwise
+	bool _RunOne(const TaskGroup* group = nullptr);
+
+	void _Signal();
+
+	bool _IsPoolThread() const;
+
+public:
+	//threadCount <= 0 uses one thread per hardware thread
+	TaskScheduler(int threadCount = 0);
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	//Includes the calling thread, which works while it waits
+	int GetThreadCount() const { return (int)_queues.size(); }
+
+	//Restarts the pool with a new number of threads
+	//Must not be called while any task is queued or running
+	void SetThreadCount(int threadCount);
+
+	//Index of the calling thread in [0, thread count), 0 for every thread outside the pool (so it only identifies pool threads)
+	int GetThreadIndex() const;
+
+	//Calls body(chunkBegin, chunkEnd) over [begin, end) split into chunks of at least grainSize, returns once all are done
+	void ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+};
+
+/*
+	Set of tasks that can be waited on together
+	Waits in its destructor, so tasks may safely capture locals of the scope that owns the group
+*/
+
+class TaskGroup
+{
+	friend TaskScheduler;
+
+	TaskScheduler& _scheduler;
+	std::atomic<int> _pending;
+
+public:
+	TaskGroup(TaskScheduler& scheduler) : _scheduler(scheduler), _pending(0) {}
+	~TaskGroup() { Wait(); }
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void Run(std::function<void()> task);
+
+	//Runs queued tasks until every task in this group has finished, blocking if there are none it can run
+	//Pool threads run tasks of any group, threads outside the pool only this group's
+	void Wait();
+};